@@ -0,0 +1,49 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileHash.h"
+#include <QCryptographicHash>
+#include <QFile>
+
+// Files are hashed in reads of this size
+#define HASH_BLOCK_SIZE (4 * 1024 * 1024)
+
+QByteArray pqHashFile(const QString& filename, QString* error, const QAtomicInt* cancel)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        if (error)
+            *error = QString("%1: %2").arg(filename).arg(file.errorString());
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    QByteArray buffer(HASH_BLOCK_SIZE, Qt::Uninitialized);
+    for ( ;; ) {
+        if (cancel && cancel->loadAcquire())
+            return QByteArray();
+        qint64 count = file.read(buffer.data(), buffer.size());
+        if (count < 0) {
+            if (error)
+                *error = QString("%1: %2").arg(filename).arg(file.errorString());
+            return QByteArray();
+        }
+        if (count == 0)
+            break;
+        hash.addData(buffer.constData(), count);
+    }
+    return hash.result();
+}
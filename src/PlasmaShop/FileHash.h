@@ -0,0 +1,35 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FILEHASH_H
+#define _FILEHASH_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QString>
+
+/**
+ * MD5 of a whole file, read in large unbuffered blocks.  Safe to call from
+ * worker threads.
+ * @param filename the file to hash
+ * @param error if not NULL, receives a description of any failure
+ * @param cancel if not NULL, hashing stops as soon as it is set
+ * @return the raw digest, or an empty array on failure or cancellation
+ */
+QByteArray pqHashFile(const QString& filename, QString* error = NULL,
+                      const QAtomicInt* cancel = NULL);
+
+#endif
@@ -36,8 +36,11 @@
 #include "OptionsDialog.h"
 #include "QPlasmaTextDoc.h"
 #include "QPlasmaPakFile.h"
+#include "PycDecompiler.h"
 #include "GameScanner.h"
 #include "NewFile.h"
+#include "PyIndex.h"
+#include "PySearchDialog.h"
 
 PlasmaShopMain::PlasmaShopMain()
 {
@@ -54,6 +57,7 @@ PlasmaShopMain::PlasmaShopMain()
     fActions[kFileRevert] = new QAction(qStdIcon("document-revert"), tr("Re&load"), this);
     fActions[kFileOptions] = new QAction(tr("&Preferences..."), this);
     fActions[kFileShowBrowser] = new QAction(tr("Show File &Browser"), this);
+    fActions[kFileSearchPython] = new QAction(qStdIcon("edit-find"), tr("Searc&h Python Scripts..."), this);
     fActions[kFileExit] = new QAction(qStdIcon("application-exit"), tr("E&xit"), this);
     fActions[kEditUndo] = new QAction(qStdIcon("edit-undo"), tr("&Undo"), this);
     fActions[kEditRedo] = new QAction(qStdIcon("edit-redo"), tr("&Redo"), this);
@@ -94,6 +98,7 @@ PlasmaShopMain::PlasmaShopMain()
     fActions[kFileSave]->setShortcut(Qt::CTRL + Qt::Key_S);
     fActions[kFileSaveAs]->setShortcut(Qt::SHIFT + Qt::CTRL + Qt::Key_S);
     fActions[kFileRevert]->setShortcut(Qt::Key_F5);
+    fActions[kFileSearchPython]->setShortcut(Qt::SHIFT + Qt::CTRL + Qt::Key_F);
     fActions[kFileExit]->setShortcut(Qt::ALT + Qt::Key_F4);
     fActions[kEditUndo]->setShortcut(Qt::CTRL + Qt::Key_Z);
     fActions[kEditRedo]->setShortcut(Qt::SHIFT + Qt::CTRL + Qt::Key_Z);
@@ -135,6 +140,7 @@ PlasmaShopMain::PlasmaShopMain()
     fileMenu->addSeparator();
     fileMenu->addAction(fActions[kFileOptions]);
     fileMenu->addAction(fActions[kFileShowBrowser]);
+    fileMenu->addAction(fActions[kFileSearchPython]);
     fileMenu->addSeparator();
     fileMenu->addAction(fActions[kFileExit]);
 
@@ -223,6 +229,8 @@ PlasmaShopMain::PlasmaShopMain()
     fBrowserTree->setContextMenuPolicy(Qt::CustomContextMenu);
     addDockWidget(Qt::LeftDockWidgetArea, fBrowserDock);
     fScanner = new GameScanner(fBrowserTree);
+    fPyIndex = new PyIndex(this);
+    fPySearch = NULL;
 
     // Load UI Settings
     QSettings settings("PlasmaShop", "PlasmaShop");
@@ -248,6 +256,7 @@ PlasmaShopMain::PlasmaShopMain()
     connect(fActions[kFileRevert], &QAction::triggered, this, &PlasmaShopMain::onRevert);
     connect(fActions[kFileOptions], &QAction::triggered, this, &PlasmaShopMain::onOptions);
     connect(fActions[kFileShowBrowser], &QAction::triggered, fBrowserDock, &QWidget::setVisible);
+    connect(fActions[kFileSearchPython], &QAction::triggered, this, &PlasmaShopMain::onSearchPython);
     connect(fActions[kFileExit], &QAction::triggered, this, &PlasmaShopMain::close);
 
     connect(fActions[kEditCut], &QAction::triggered, this, &PlasmaShopMain::onCut);
@@ -483,6 +492,31 @@ void PlasmaShopMain::dropEvent(QDropEvent* evt)
     }
 }
 
+QPlasmaTextDoc* PlasmaShopMain::openText(const QString& name, const QString& text)
+{
+    // Open generated text (e.g. decompiled source) in a new, unsaved tab
+    QPlasmaTextDoc* textDoc = new QPlasmaTextDoc(this);
+    fEditorPane->addTab(textDoc, QPlasmaDocument::GetDocIcon(name), name);
+    textDoc->setFilename(name);
+    if (name.endsWith(".py", Qt::CaseInsensitive))
+        textDoc->setSyntax(QPlasmaTextDoc::kStxPython);
+    else
+        textDoc->setSyntax(QPlasmaTextDoc::kStxNone);
+    textDoc->setEncoding(QPlasmaTextDoc::kTypeUTF8);
+    textDoc->setText(text);
+    textDoc->makeClean();
+    connect(textDoc, &QPlasmaDocument::statusChanged, this, &PlasmaShopMain::updateMenuStatus);
+    connect(textDoc, &QPlasmaDocument::becameDirty, this, &PlasmaShopMain::onDocDirty);
+    connect(textDoc, &QPlasmaDocument::becameClean, this, &PlasmaShopMain::onDocClean);
+
+    // Update menus
+    onChangeTab(fEditorPane->currentIndex());
+
+    // Select the new tab
+    fEditorPane->setCurrentIndex(fEditorPane->count() - 1);
+    return textDoc;
+}
+
 void PlasmaShopMain::onNewFile()
 {
     NewFileDialog dlg(this);
@@ -816,6 +850,29 @@ void PlasmaShopMain::onOptions()
     }
 }
 
+void PlasmaShopMain::onSearchPython()
+{
+    if (fCurrentGame == 0) {
+        QMessageBox::information(this, tr("Search Python Scripts"),
+                                 tr("Please select a game to search first."),
+                                 QMessageBox::Ok);
+        return;
+    }
+
+    // Only packages which changed since the last search get re-indexed
+    fPyIndex->build(fGames[fCurrentGame-1].fGamePath);
+    if (fPySearch == NULL) {
+        fPySearch = new PySearchDialog(fPyIndex, this);
+        connect(fPySearch, &PySearchDialog::sourceRequested,
+                this, [this](const QString& name, const QString& source, int line) {
+            openText(name, source)->gotoLine(line);
+        });
+    }
+    fPySearch->show();
+    fPySearch->raise();
+    fPySearch->activateWindow();
+}
+
 void PlasmaShopMain::onShowAbout()
 {
     QDialog aboutDialog(this);
@@ -1425,6 +1482,9 @@ void PlasmaShopMain::onDocClean()
 
 int main(int argc, char* argv[])
 {
+    if (PycDecompiler::isWorker(argc, argv))
+        return PycDecompiler::workerMain(argc, argv);
+
     // Redirect libPlasma's debug stuff to PlasmaShop.log
     QString logpath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
     QDir dir;
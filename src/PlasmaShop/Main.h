@@ -28,6 +28,10 @@
 #include "GameBrowser.h"
 #include "GameScanner.h"
 
+class QPlasmaTextDoc;
+class PyIndex;
+class PySearchDialog;
+
 class PlasmaShopMain : public QMainWindow
 {
     Q_OBJECT
@@ -42,7 +46,7 @@ private:
     {
         // Main Menu
         kFileNew, kFileOpen, kFileSave, kFileSaveAs, kFileExit, kFileOptions,
-        kFileRevert, kFileShowBrowser,
+        kFileRevert, kFileShowBrowser, kFileSearchPython,
         kEditUndo, kEditRedo, kEditCut, kEditCopy, kEditPaste, kEditDelete,
         kEditSelectAll,
         kHelpAbout,
@@ -75,10 +79,15 @@ private:
     int fCurrentGame;
     GameScanner* fScanner;
 
+    // Python script search
+    PyIndex* fPyIndex;
+    PySearchDialog* fPySearch;
+
 public:
     PlasmaShopMain();
     ~PlasmaShopMain();
     void loadFile(QString filename);
+    QPlasmaTextDoc* openText(const QString& name, const QString& text);
 
 protected:
     void closeEvent(QCloseEvent* evt) override;
@@ -97,6 +106,7 @@ private slots:
     void onSaveAs();
     void onRevert();
     void onOptions();
+    void onSearchPython();
     void onShowAbout();
 
     void onCut();
@@ -62,6 +62,10 @@ OptionsDialog::OptionsDialog(QWidget* parent)
     fImageEditorPath->setCompleter(new QCompleter(dirModel, fImageEditorPath));
     QToolButton* browseImageEditor = new QToolButton(tabProgs);
     browseImageEditor->setText("...");
+    fPythonPath = new QLineEdit(tabProgs);
+    fPythonPath->setCompleter(new QCompleter(dirModel, fPythonPath));
+    QToolButton* browsePython = new QToolButton(tabProgs);
+    browsePython->setText("...");
 
     QLabel* lblPrpEditor = new QLabel(tr("&PRP Editor:"), tabProgs);
     lblPrpEditor->setBuddy(fPrpEditorPath);
@@ -69,6 +73,8 @@ OptionsDialog::OptionsDialog(QWidget* parent)
     lblVaultEditor->setBuddy(fVaultEditorPath);
     QLabel* lblImgEditor = new QLabel(tr("&Image Editor:"), tabProgs);
     lblImgEditor->setBuddy(fImageEditorPath);
+    QLabel* lblPython = new QLabel(tr("P&ython 2.x Interpreter:"), tabProgs);
+    lblPython->setBuddy(fPythonPath);
 
     QGridLayout* layProgs = new QGridLayout(tabProgs);
     layProgs->setContentsMargins(8, 8, 8, 8);
@@ -84,7 +90,11 @@ OptionsDialog::OptionsDialog(QWidget* parent)
     layProgs->addWidget(lblImgEditor, 6, 0, 1, 3);
     layProgs->addWidget(fImageEditorPath, 7, 1);
     layProgs->addWidget(browseImageEditor, 7, 2);
-    layProgs->addItem(new QSpacerItem(0, 0, QSizePolicy::Minimum, QSizePolicy::MinimumExpanding), 8, 0, 1, 3);
+    layProgs->addItem(new QSpacerItem(0, 8, QSizePolicy::Minimum, QSizePolicy::Minimum), 8, 0, 1, 3);
+    layProgs->addWidget(lblPython, 9, 0, 1, 3);
+    layProgs->addWidget(fPythonPath, 10, 1);
+    layProgs->addWidget(browsePython, 10, 2);
+    layProgs->addItem(new QSpacerItem(0, 0, QSizePolicy::Minimum, QSizePolicy::MinimumExpanding), 11, 0, 1, 3);
     tabs->addTab(tabProgs, tr("&General"));
 
     // Editor tab
@@ -144,6 +154,7 @@ OptionsDialog::OptionsDialog(QWidget* parent)
     fPrpEditorPath->setText(settings.value("PrpEditorPath", DEFAULT_PRP_EDITOR).toString());
     fVaultEditorPath->setText(settings.value("VaultEditorPath", DEFAULT_VAULT_EDITOR).toString());
     fImageEditorPath->setText(settings.value("ImageEditorPath", "").toString());
+    fPythonPath->setText(settings.value("PythonPath", "").toString());
     fSciLineNumbers->setChecked(settings.value("SciLineNumberMargin", true).toBool());
     fSciFolding->setChecked(settings.value("SciFoldMargin", false).toBool());
     fSciUseSpaces->setChecked(settings.value("SciUseSpaces", true).toBool());
@@ -169,6 +180,7 @@ OptionsDialog::OptionsDialog(QWidget* parent)
     connect(browsePrpEditor, &QToolButton::clicked, this, &OptionsDialog::onBrowsePrpEditor);
     connect(browseVaultEditor, &QToolButton::clicked, this, &OptionsDialog::onBrowseVaultEditor);
     connect(browseImageEditor, &QToolButton::clicked, this, &OptionsDialog::onBrowseImageEditor);
+    connect(browsePython, &QToolButton::clicked, this, &OptionsDialog::onBrowsePython);
     connect(fSciLongLineMark, &QCheckBox::clicked, fSciLongLineSize, &QWidget::setEnabled);
     connect(fSciFont, &QPushButton::clicked, this, &OptionsDialog::onSetFont);
 }
@@ -194,12 +206,19 @@ void OptionsDialog::onSave()
         QMessageBox::warning(this, tr("Invalid Path"),
                              tr("You have entered an invalid path to your Image editor."),
                              QMessageBox::Ok);
+    } else if (!fPythonPath->text().isEmpty() &&
+        !QFileInfo(fPythonPath->text()).isFile() &&
+        QStandardPaths::findExecutable(fPythonPath->text()).isEmpty()) {
+        QMessageBox::warning(this, tr("Invalid Path"),
+                             tr("You have entered an invalid path to your Python interpreter."),
+                             QMessageBox::Ok);
     }
 
     QSettings settings("PlasmaShop", "PlasmaShop");
     settings.setValue("PrpEditorPath", fPrpEditorPath->text());
     settings.setValue("VaultEditorPath", fVaultEditorPath->text());
     settings.setValue("ImageEditorPath", fImageEditorPath->text());
+    settings.setValue("PythonPath", fPythonPath->text());
     settings.setValue("SciLineNumberMargin", fSciLineNumbers->isChecked());
     settings.setValue("SciFoldMargin", fSciFolding->isChecked());
     settings.setValue("SciUseSpaces", fSciUseSpaces->isChecked());
@@ -250,6 +269,14 @@ void OptionsDialog::onBrowseImageEditor()
         fImageEditorPath->setText(path);
 }
 
+void OptionsDialog::onBrowsePython()
+{
+    QString path = QFileDialog::getOpenFileName(this, tr("Select Python Interpreter"),
+                                                fPythonPath->text(), EXECFILTER);
+    if (!path.isEmpty())
+        fPythonPath->setText(path);
+}
+
 void OptionsDialog::onSetFont()
 {
     fSciFont->setFont(QFontDialog::getFont(0, fSciFont->font(), this,
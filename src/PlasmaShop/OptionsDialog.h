@@ -41,6 +41,7 @@ private:
     QLineEdit* fPrpEditorPath;
     QLineEdit* fVaultEditorPath;
     QLineEdit* fImageEditorPath;
+    QLineEdit* fPythonPath;
 
     QCheckBox* fSciLineNumbers;
     QCheckBox* fSciFolding;
@@ -58,6 +59,7 @@ private slots:
     void onBrowsePrpEditor();
     void onBrowseVaultEditor();
     void onBrowseImageEditor();
+    void onBrowsePython();
     void onSetFont();
 };
 
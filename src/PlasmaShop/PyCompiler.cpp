@@ -0,0 +1,109 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PyCompiler.h"
+#include <QProcess>
+#include <QFileInfo>
+#include <QDir>
+#include <QObject>
+#include <QtEndian>
+
+// Exit status of the script when the interpreter is the wrong version
+#define PYC_WRONG_VERSION (3)
+
+// Run by the interpreter with the accepted versions and then the sources as
+// arguments.  An interpreter of any other version writes its own version to
+// stderr and exits before compiling anything.  Otherwise, for each source
+// it writes a status byte ('K' or 'E'), a little-endian length, and then
+// the marshalled code object or the error message.  This has to stay valid
+// for Python 2.2, and the version check for anything newer.
+static const char s_compileScript[] = R"(
+import sys, os, struct, marshal
+version = '%d.%d' % tuple(sys.version_info[:2])
+if version not in sys.argv[1].split(','):
+    sys.stderr.write(version)
+    sys.exit(3)
+for path in sys.argv[2:]:
+    try:
+        f = open(path, 'r')
+        src = f.read().replace('\r\n', '\n')
+        f.close()
+        if src and src[-1] != '\n':
+            src = src + '\n'
+        data = marshal.dumps(compile(src, os.path.basename(path), 'exec'))
+        status = 'K'
+    except:
+        data = str(sys.exc_info()[1])
+        status = 'E'
+    sys.stdout.write(status + struct.pack('<I', len(data)) + data)
+)";
+
+void PyCompiler::compileBatch(const QString& interpreter, const QString& version,
+                              QVector<Source>& batch)
+{
+    const QString accepted = version.isEmpty() ? QString("2.2,2.3") : version;
+
+    // -u also puts stdout in binary mode on Windows
+    QStringList args;
+    args << "-u" << "-c" << s_compileScript << accepted;
+    for (const Source& src : batch)
+        args << QDir::toNativeSeparators(src.fFilename);
+
+    QProcess proc;
+    proc.start(interpreter, args, QIODevice::ReadOnly);
+    if (!proc.waitForStarted() || !proc.waitForFinished(-1)) {
+        QString error = QObject::tr("Could not run %1: %2").arg(interpreter).arg(proc.errorString());
+        for (Source& src : batch)
+            src.fError = error;
+        return;
+    }
+
+    const QByteArray output = proc.readAllStandardOutput();
+    const QString details = QString::fromLocal8Bit(proc.readAllStandardError()).trimmed();
+    if (proc.exitStatus() == QProcess::NormalExit && proc.exitCode() == PYC_WRONG_VERSION) {
+        QString error = QObject::tr("%1 is Python %2, but this package needs Python %3.  "
+                                    "Please set a matching interpreter in the PlasmaShop Options.")
+                        .arg(interpreter).arg(details)
+                        .arg(version.isEmpty() ? QObject::tr("2.2 or 2.3") : version);
+        for (Source& src : batch)
+            src.fError = error;
+        return;
+    }
+    int pos = 0;
+    for (Source& src : batch) {
+        QString fileName = QFileInfo(src.fFilename).fileName();
+        quint32 length = 0;
+        if (pos + 5 <= output.size())
+            length = qFromLittleEndian<quint32>((const uchar*)output.constData() + pos + 1);
+        if (pos + 5 > output.size() || length > (quint32)(output.size() - pos - 5)) {
+            // The interpreter died (or is not Python 2.x) before it got to
+            // this file
+            src.fError = QObject::tr("%1: The interpreter did not compile this file").arg(fileName);
+            if (!details.isEmpty())
+                src.fError += '\n' + details;
+            pos = output.size();
+            continue;
+        }
+        char status = output[pos];
+        QByteArray data = output.mid(pos + 5, length);
+        pos += 5 + length;
+        if (status == 'K')
+            src.fBytecode = data;
+        else
+            src.fError = QString("%1: %2").arg(fileName).arg(QString::fromLocal8Bit(data));
+    }
+}
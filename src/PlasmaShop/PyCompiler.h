@@ -0,0 +1,58 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _PYCOMPILER_H
+#define _PYCOMPILER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// Number of sources handed to each interpreter process
+#define PYC_BATCH_SIZE 16
+
+/**
+ * Compiles Python sources to the marshalled code objects stored in
+ * Python.pak, using an external interpreter matching the game's Python
+ * version (2.2 for Uru, 2.3 for Myst V / MOUL).
+ */
+class PyCompiler
+{
+public:
+    struct Source
+    {
+        QString fFilename;
+        QByteArray fBytecode;
+        QString fError;
+    };
+
+    /**
+     * Compile a batch of sources with a single interpreter process.  This
+     * blocks until the interpreter exits, and is safe to run on worker
+     * threads, so several batches can be compiled at once.
+     * @param interpreter the Python executable to run
+     * @param version the major.minor version ("2.2" or "2.3") the bytecode
+     *      must be compiled for, or empty to accept either.  If the
+     *      interpreter is any other version, nothing is compiled.
+     * @param batch the sources; each receives either its bytecode or an
+     *      error message
+     */
+    static void compileBatch(const QString& interpreter, const QString& version,
+                             QVector<Source>& batch);
+};
+
+#endif
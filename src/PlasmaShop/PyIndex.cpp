@@ -0,0 +1,403 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PyIndex.h"
+#include <Stream/plEncryptedStream.h>
+#include <Stream/hsRAMStream.h>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QSet>
+#include <QtConcurrent>
+#include <algorithm>
+#include <memory>
+#include "QPlasmaPakFile.h"
+#include "PycDecompiler.h"
+#include "FileHash.h"
+
+#define PYINDEX_MAGIC   (0x58495950)    // "PYIX"
+#define PYINDEX_VERSION (1)
+
+static QString indexFilename(const QString& gameDir)
+{
+    QByteArray key = QCryptographicHash::hash(QDir(gameDir).absolutePath().toUtf8(),
+                                              QCryptographicHash::Md5).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + "/PlasmaShop/pyindex-" + QString::fromLatin1(key) + ".dat";
+}
+
+// Calls wordFunc with each lowercased identifier / number in text
+template <typename WordFunc>
+static void forEachWord(const QString& text, WordFunc wordFunc)
+{
+    int start = -1;
+    for (int i = 0; i <= text.size(); ++i) {
+        bool wordChar = (i < text.size()) && (text[i].isLetterOrNumber() || text[i] == '_');
+        if (wordChar && start < 0) {
+            start = i;
+        } else if (!wordChar && start >= 0) {
+            wordFunc(text.mid(start, i - start).toLower());
+            start = -1;
+        }
+    }
+}
+
+static void loadIndex(const QString& filename, QVector<PyIndex::PakIndex>& paks)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version, pakCount;
+    in >> magic >> version;
+    if (magic != PYINDEX_MAGIC || version != PYINDEX_VERSION)
+        return;
+
+    in >> pakCount;
+    for (quint32 i = 0; i < pakCount && in.status() == QDataStream::Ok; ++i) {
+        PyIndex::PakIndex pak;
+        quint32 moduleCount;
+        in >> pak.fPath >> pak.fHash >> moduleCount;
+        for (quint32 j = 0; j < moduleCount && in.status() == QDataStream::Ok; ++j) {
+            PyIndex::Module module;
+            in >> module.fName >> module.fSource;
+            pak.fModules.append(module);
+        }
+        in >> pak.fPostings;
+        if (in.status() == QDataStream::Ok)
+            paks.append(pak);
+    }
+}
+
+static void saveIndex(const QString& filename, const QVector<PyIndex::PakIndex>& paks)
+{
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << (quint32)PYINDEX_MAGIC << (quint32)PYINDEX_VERSION << (quint32)paks.size();
+    for (const PyIndex::PakIndex& pak : paks) {
+        out << pak.fPath << pak.fHash << (quint32)pak.fModules.size();
+        for (const PyIndex::Module& module : pak.fModules)
+            out << module.fName << module.fSource;
+        out << pak.fPostings;
+    }
+    file.commit();
+}
+
+
+/* PyIndex */
+PyIndex::PyIndex(QObject* parent)
+    : QObject(parent)
+{
+    connect(&fBuildWatcher, &QFutureWatcher<BuildResult>::finished,
+            this, &PyIndex::buildFinished);
+}
+
+PyIndex::~PyIndex()
+{
+    cancel();
+}
+
+void PyIndex::build(const QString& gameDir)
+{
+    if (isBuilding()) {
+        if (gameDir == fGameDir)
+            return;
+        cancel();
+    }
+    if (gameDir != fGameDir) {
+        // Don't offer results from another game while this one is indexed
+        fPaks.clear();
+        fErrors.clear();
+        fGameDir = gameDir;
+    }
+    fBuildWatcher.setFuture(QtConcurrent::run([this, gameDir] {
+        return buildIndex(gameDir);
+    }));
+}
+
+void PyIndex::cancel()
+{
+    fBuildCancel.storeRelease(1);
+    fBuildWatcher.waitForFinished();
+    fBuildCancel.storeRelease(0);
+}
+
+int PyIndex::moduleCount() const
+{
+    int count = 0;
+    for (const PakIndex& pak : fPaks)
+        count += pak.fModules.size();
+    return count;
+}
+
+void PyIndex::buildFinished()
+{
+    BuildResult result = fBuildWatcher.result();
+    if (!result.fComplete)
+        return;
+    fPaks = result.fPaks;
+    fErrors = result.fErrors;
+    emit finished();
+}
+
+PyIndex::BuildResult PyIndex::buildIndex(const QString& gameDir)
+{
+    BuildResult result;
+    const QString cacheFile = indexFilename(gameDir);
+    QVector<PakIndex> cached;
+    loadIndex(cacheFile, cached);
+
+    QStringList paks;
+    QDirIterator iter(gameDir, QStringList("*.pak"), QDir::Files, QDirIterator::Subdirectories);
+    while (iter.hasNext())
+        paks << iter.next();
+    paks.sort();
+
+    bool changed = (cached.size() != paks.size());
+    for (const QString& filename : paks) {
+        if (fBuildCancel.loadAcquire())
+            return result;
+
+        PakIndex index;
+        index.fPath = QDir(gameDir).relativeFilePath(filename);
+        index.fHash = pqHashFile(filename);
+        auto cachedPak = std::find_if(cached.begin(), cached.end(), [&index](const PakIndex& pak) {
+            return pak.fPath == index.fPath && pak.fHash == index.fHash;
+        });
+        if (cachedPak != cached.end()) {
+            result.fPaks.append(*cachedPak);
+            continue;
+        }
+
+        changed = true;
+        if (indexPackage(filename, index, result.fErrors))
+            result.fPaks.append(index);
+    }
+    if (fBuildCancel.loadAcquire())
+        return result;
+
+    if (changed)
+        saveIndex(cacheFile, result.fPaks);
+    result.fComplete = true;
+    return result;
+}
+
+struct ModuleJob
+{
+    const PlasmaPackage::FileEntry* fEntry;
+    QString fName, fError;
+    QByteArray fSource;
+    QMap<QString, QVector<quint32>> fWords;
+};
+
+bool PyIndex::indexPackage(const QString& filename, PakIndex& index, QStringList& errors)
+{
+    const QString pakName = QFileInfo(filename).fileName();
+    PlasmaPackage package;
+    try {
+        if (plEncryptedStream::IsFileEncrypted(filename.toUtf8().data())) {
+            std::unique_ptr<plEncryptedStream> S(new plEncryptedStream(PlasmaVer::pvPrime));
+            S->open(filename.toUtf8().data(), fmRead, plEncryptedStream::kEncAuto);
+            if (S->getEncType() == plEncryptedStream::kEncDroid) {
+                errors << tr("%1: Packages which need an encryption key cannot be indexed").arg(pakName);
+                return false;
+            } else if (S->getEncType() == plEncryptedStream::kEncAES) {
+                S->setVer(PlasmaVer::pvEoa);
+            }
+            package.readIndex(S.release());
+        } else {
+            std::unique_ptr<hsFileStream> S(new hsFileStream(PlasmaVer::pvMoul));
+            S->open(filename.toUtf8().data(), fmRead);
+            package.readIndex(S.release());
+        }
+    } catch (std::exception& ex) {
+        errors << QString("%1: %2").arg(pakName).arg(ex.what());
+        return false;
+    }
+    if (package.fType != PlasmaPackage::kPythonPak)
+        return false;
+
+    QVector<ModuleJob> jobs;
+    jobs.reserve(package.fEntries.size());
+    for (const PlasmaPackage::FileEntry& entry : package.fEntries) {
+        ModuleJob job;
+        job.fEntry = &entry;
+        job.fName = package.displayName(entry);
+        jobs.append(job);
+    }
+
+    const int total = jobs.size();
+    QAtomicInt done(0);
+    emit progress(pakName, 0, total);
+    QtConcurrent::blockingMap(jobs, [&](ModuleJob& job) {
+        if (fBuildCancel.loadAcquire())
+            return;
+        try {
+            hsRAMStream S;
+            QString warning;
+            package.writeEntry(*job.fEntry, &S, &warning);
+            QByteArray pycData(S.size(), Qt::Uninitialized);
+            S.rewind();
+            S.read(pycData.size(), pycData.data());
+
+            QByteArray source;
+            if (PycDecompiler::decompileData(pycData, job.fName, source, &job.fError,
+                                             &fBuildCancel)) {
+                const QStringList lines = QString::fromUtf8(source).split('\n');
+                for (int i = 0; i < lines.size(); ++i) {
+                    const quint32 line = i + 1;
+                    forEachWord(lines[i], [&job, line](const QString& word) {
+                        QVector<quint32>& hits = job.fWords[word];
+                        if (hits.isEmpty() || hits.last() != line)
+                            hits.append(line);
+                    });
+                }
+                job.fSource = qCompress(source);
+            }
+        } catch (std::exception& ex) {
+            job.fError = QString("%1: %2").arg(job.fName).arg(ex.what());
+        }
+        emit progress(pakName, done.fetchAndAddOrdered(1) + 1, total);
+    });
+    if (fBuildCancel.loadAcquire())
+        return false;
+
+    for (const ModuleJob& job : jobs) {
+        if (!job.fError.isEmpty())
+            errors << job.fError;
+        if (job.fSource.isEmpty())
+            continue;
+
+        const quint64 moduleIdx = index.fModules.size();
+        Module module;
+        module.fName = job.fName;
+        module.fSource = job.fSource;
+        index.fModules.append(module);
+        for (auto word = job.fWords.constBegin(); word != job.fWords.constEnd(); ++word) {
+            QVector<quint64>& postings = index.fPostings[word.key()];
+            for (quint32 line : word.value())
+                postings.append((moduleIdx << 32) | line);
+        }
+    }
+    return true;
+}
+
+QVector<PyIndex::Match> PyIndex::search(const QString& query, int maxResults) const
+{
+    struct Term
+    {
+        QString fWord;
+        bool fPrefix;
+    };
+    QVector<Term> terms;
+#if (QT_VERSION < QT_VERSION_CHECK(5, 14, 0))
+    const QStringList parts = query.split(' ', QString::SkipEmptyParts);
+#else
+    const QStringList parts = query.split(' ', Qt::SkipEmptyParts);
+#endif
+    foreach (QString part, parts) {
+        forEachWord(part, [&terms](const QString& word) {
+            Term term;
+            term.fWord = word;
+            term.fPrefix = false;
+            terms.append(term);
+        });
+        if (part.endsWith('*') && !terms.isEmpty())
+            terms.last().fPrefix = true;
+    }
+
+    QVector<Match> results;
+    if (terms.isEmpty())
+        return results;
+
+    for (int pakIdx = 0; pakIdx < fPaks.size() && results.size() < maxResults; ++pakIdx) {
+        const PakIndex& pak = fPaks[pakIdx];
+
+        // Look up every term, and narrow down to the modules with all of them
+        QVector<QVector<quint64>> termHits;
+        QSet<quint32> modules;
+        for (int t = 0; t < terms.size(); ++t) {
+            QVector<quint64> hits;
+            if (terms[t].fPrefix) {
+                for (auto it = pak.fPostings.lowerBound(terms[t].fWord);
+                     it != pak.fPostings.constEnd() && it.key().startsWith(terms[t].fWord); ++it)
+                    hits += it.value();
+            } else {
+                hits = pak.fPostings.value(terms[t].fWord);
+            }
+
+            QSet<quint32> termModules;
+            for (quint64 hit : hits)
+                termModules.insert(hit >> 32);
+            if (t == 0)
+                modules = termModules;
+            else
+                modules.intersect(termModules);
+            termHits.append(hits);
+        }
+        if (modules.isEmpty())
+            continue;
+
+        QVector<quint64> lines;
+        for (const QVector<quint64>& hits : termHits) {
+            for (quint64 hit : hits) {
+                if (modules.contains(hit >> 32))
+                    lines.append(hit);
+            }
+        }
+        std::sort(lines.begin(), lines.end());
+        lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+        int lastModule = -1;
+        QList<QByteArray> sourceLines;
+        for (quint64 hit : lines) {
+            if (results.size() >= maxResults)
+                break;
+
+            Match match;
+            match.fPak = pakIdx;
+            match.fModule = hit >> 32;
+            match.fLine = hit & 0xFFFFFFFF;
+            match.fModuleName = pak.fModules[match.fModule].fName;
+            if (match.fModule != lastModule) {
+                sourceLines = qUncompress(pak.fModules[match.fModule].fSource).split('\n');
+                lastModule = match.fModule;
+            }
+            if (match.fLine <= sourceLines.size())
+                match.fText = QString::fromUtf8(sourceLines[match.fLine - 1]).trimmed();
+            results.append(match);
+        }
+    }
+    return results;
+}
+
+QString PyIndex::moduleSource(int pak, int module) const
+{
+    if (pak < 0 || pak >= fPaks.size() || module < 0 || module >= fPaks[pak].fModules.size())
+        return QString();
+    return QString::fromUtf8(qUncompress(fPaks[pak].fModules[module].fSource));
+}
@@ -0,0 +1,108 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _PYINDEX_H
+#define _PYINDEX_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QVector>
+#include <QMap>
+
+/**
+ * Full-text index of the decompiled Python modules in a game's .pak files.
+ * The index is built in the background and cached on disk, one section per
+ * package.  A section is only rebuilt when its package's MD5 changes.
+ */
+class PyIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Match
+    {
+        int fPak, fModule, fLine;
+        QString fModuleName, fText;
+    };
+
+    struct Module
+    {
+        QString fName;
+        QByteArray fSource;     // qCompress()ed UTF-8
+    };
+
+    struct PakIndex
+    {
+        QString fPath;
+        QByteArray fHash;
+        QVector<Module> fModules;
+
+        // Lowercased word -> (module << 32 | line) for every line it is on
+        QMap<QString, QVector<quint64>> fPostings;
+    };
+
+    struct BuildResult
+    {
+        QVector<PakIndex> fPaks;
+        QStringList fErrors;
+        bool fComplete;
+
+        BuildResult() : fComplete() { }
+    };
+
+    explicit PyIndex(QObject* parent = Q_NULLPTR);
+    ~PyIndex();
+
+    // Start (re)indexing the game in the background.  Packages that have
+    // not changed since they were last indexed are loaded from the cache.
+    void build(const QString& gameDir);
+    void cancel();
+
+    bool isBuilding() const { return fBuildWatcher.isRunning(); }
+    QString gameDir() const { return fGameDir; }
+    int moduleCount() const;
+    QStringList errors() const { return fErrors; }
+
+    /**
+     * Find every line containing all of the words in the query (matched
+     * case-insensitively; a trailing '*' matches any word with that prefix).
+     * Modules must contain every word, but a line only needs one of them.
+     */
+    QVector<Match> search(const QString& query, int maxResults) const;
+    QString moduleSource(int pak, int module) const;
+
+signals:
+    void progress(const QString& pakName, int done, int total);
+    void finished();
+
+private:
+    QString fGameDir;
+    QVector<PakIndex> fPaks;
+    QStringList fErrors;
+    QFutureWatcher<BuildResult> fBuildWatcher;
+    QAtomicInt fBuildCancel;
+
+    BuildResult buildIndex(const QString& gameDir);
+    bool indexPackage(const QString& filename, PakIndex& index, QStringList& errors);
+
+private slots:
+    void buildFinished();
+};
+
+#endif
@@ -0,0 +1,113 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PySearchDialog.h"
+#include <QGridLayout>
+#include <QElapsedTimer>
+
+#define MAX_SEARCH_RESULTS 2000
+
+enum { kColModule, kColLine, kColText };
+
+PySearchDialog::PySearchDialog(PyIndex* index, QWidget* parent)
+    : QDialog(parent), fIndex(index)
+{
+    setWindowTitle(tr("Search Python Scripts"));
+
+    fQuery = new QLineEdit(this);
+    fQuery->setPlaceholderText(tr("Words to find (use * for prefix matches)"));
+    QLabel* lblQuery = new QLabel(tr("&Find:"), this);
+    lblQuery->setBuddy(fQuery);
+
+    fResults = new QTreeWidget(this);
+    fResults->setUniformRowHeights(true);
+    fResults->setRootIsDecorated(false);
+    fResults->setHeaderLabels(QStringList() << tr("Module") << tr("Line") << tr("Text"));
+    fStatus = new QLabel(this);
+
+    QGridLayout* layout = new QGridLayout(this);
+    layout->setContentsMargins(8, 8, 8, 8);
+    layout->setVerticalSpacing(4);
+    layout->addWidget(lblQuery, 0, 0);
+    layout->addWidget(fQuery, 0, 1);
+    layout->addWidget(fResults, 1, 0, 1, 2);
+    layout->addWidget(fStatus, 2, 0, 1, 2);
+    resize(640, 480);
+
+    connect(fQuery, &QLineEdit::textChanged, this, &PySearchDialog::search);
+    connect(fResults, &QTreeWidget::itemActivated, this, &PySearchDialog::onItemActivated);
+    connect(fIndex, &PyIndex::progress, this, &PySearchDialog::onProgress);
+    connect(fIndex, &PyIndex::finished, this, &PySearchDialog::onIndexReady);
+    onIndexReady();
+}
+
+void PySearchDialog::search()
+{
+    fResults->clear();
+    if (fQuery->text().trimmed().isEmpty())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<PyIndex::Match> matches = fIndex->search(fQuery->text(), MAX_SEARCH_RESULTS);
+    for (const PyIndex::Match& match : matches) {
+        QTreeWidgetItem* item = new QTreeWidgetItem(fResults);
+        item->setText(kColModule, match.fModuleName);
+        item->setText(kColLine, QString::number(match.fLine));
+        item->setText(kColText, match.fText);
+        item->setData(kColModule, Qt::UserRole, match.fPak);
+        item->setData(kColLine, Qt::UserRole, match.fModule);
+    }
+    fResults->resizeColumnToContents(kColModule);
+    fResults->resizeColumnToContents(kColLine);
+
+    QString status = (matches.size() >= MAX_SEARCH_RESULTS)
+                   ? tr("First %1 matching lines (%2 ms)").arg(matches.size()).arg(timer.elapsed())
+                   : tr("%1 matching lines (%2 ms)").arg(matches.size()).arg(timer.elapsed());
+    if (fIndex->isBuilding())
+        status += tr(" -- still indexing");
+    fStatus->setText(status);
+}
+
+void PySearchDialog::onProgress(const QString& pakName, int done, int total)
+{
+    fStatus->setText(tr("Indexing %1: %2 of %3 modules...").arg(pakName).arg(done).arg(total));
+}
+
+void PySearchDialog::onIndexReady()
+{
+    if (fIndex->isBuilding()) {
+        fStatus->setText(tr("Indexing..."));
+        return;
+    }
+
+    QStringList errors = fIndex->errors();
+    fStatus->setText(tr("%1 modules indexed").arg(fIndex->moduleCount())
+                     + (errors.isEmpty() ? QString() : tr(" (%1 could not be indexed)").arg(errors.size())));
+    fStatus->setToolTip(errors.join('\n'));
+    if (!fQuery->text().trimmed().isEmpty())
+        search();
+}
+
+void PySearchDialog::onItemActivated(QTreeWidgetItem* item, int)
+{
+    int pak = item->data(kColModule, Qt::UserRole).toInt();
+    int module = item->data(kColLine, Qt::UserRole).toInt();
+    QString source = fIndex->moduleSource(pak, module);
+    if (!source.isEmpty())
+        emit sourceRequested(item->text(kColModule), source, item->text(kColLine).toInt());
+}
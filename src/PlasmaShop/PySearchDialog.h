@@ -0,0 +1,50 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _PYSEARCHDIALOG_H
+#define _PYSEARCHDIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QTreeWidget>
+#include <QLabel>
+#include "PyIndex.h"
+
+class PySearchDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    PySearchDialog(PyIndex* index, QWidget* parent);
+
+signals:
+    void sourceRequested(const QString& name, const QString& source, int line);
+
+private:
+    PyIndex* fIndex;
+    QLineEdit* fQuery;
+    QTreeWidget* fResults;
+    QLabel* fStatus;
+
+private slots:
+    void search();
+    void onProgress(const QString& pakName, int done, int total);
+    void onIndexReady();
+    void onItemActivated(QTreeWidgetItem* item, int);
+};
+
+#endif
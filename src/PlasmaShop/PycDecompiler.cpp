@@ -0,0 +1,180 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PycDecompiler.h"
+#include <QCoreApplication>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+#ifdef _WIN32
+#include <QTemporaryFile>
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include <ASTree.h>
+#include <data.h>
+
+#define PYCDC_WORKER_ARG "--decompile-pyc"
+
+// How often a waiting call checks for cancellation, and how long a single
+// module may take before its worker is assumed to be stuck
+#define PYCDC_POLL_MSEC     (100)
+#define PYCDC_TIMEOUT_MSEC  (60 * 1000)
+
+/* pycdc writes through the global pyc_output, keeps its indentation state
+ * in globals, and shares singleton objects (None, True, ...) between modules
+ * with non-atomic reference counts, so it can only ever work on one module
+ * per process.  Each module is therefore decompiled by a copy of PlasmaShop
+ * started in worker mode, which reads the bytecode from a pipe and writes
+ * the source to its stdout.  Any number of these can run side by side, and
+ * a module that crashes pycdc only takes its own worker down. */
+static bool runWorker(const QStringList& args, const QByteArray* pycData,
+                      const QString& displayName, QByteArray& source, QString* error,
+                      const QAtomicInt* cancel)
+{
+    QProcess proc;
+    proc.start(QCoreApplication::applicationFilePath(), QStringList(PYCDC_WORKER_ARG) + args);
+    if (!proc.waitForStarted()) {
+        if (error)
+            *error = QObject::tr("Could not start the decompiler for %1: %2")
+                     .arg(displayName).arg(proc.errorString());
+        return false;
+    }
+    if (pycData != NULL)
+        proc.write(*pycData);
+    proc.closeWriteChannel();
+
+    // pycdc can loop forever on some bytecode, so never wait unbounded
+    QElapsedTimer elapsed;
+    elapsed.start();
+    while (proc.state() != QProcess::NotRunning && !proc.waitForFinished(PYCDC_POLL_MSEC)) {
+        const bool cancelled = cancel && cancel->loadAcquire();
+        if (cancelled || elapsed.hasExpired(PYCDC_TIMEOUT_MSEC)) {
+            proc.kill();
+            proc.waitForFinished();
+            if (error) {
+                *error = cancelled ? QObject::tr("Decompiling %1 was cancelled").arg(displayName)
+                                   : QObject::tr("Could not decompile %1: the decompiler "
+                                                 "did not finish within %2 seconds")
+                                     .arg(displayName).arg(PYCDC_TIMEOUT_MSEC / 1000);
+            }
+            return false;
+        }
+    }
+
+    const QByteArray output = proc.readAllStandardOutput();
+    const int headerEnd = output.indexOf('\n');
+    if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0 || headerEnd < 0) {
+        if (error) {
+            QString details = QString::fromLocal8Bit(proc.readAllStandardError()).trimmed();
+            if (details.isEmpty())
+                details = (proc.exitStatus() == QProcess::NormalExit)
+                        ? QObject::tr("Unknown error") : QObject::tr("The decompiler crashed");
+            *error = QObject::tr("Could not decompile %1: %2").arg(displayName).arg(details);
+        }
+        return false;
+    }
+
+    // The worker starts with "<major> <minor> <unicode>"
+    const QList<QByteArray> version = output.left(headerEnd).split(' ');
+    const int majorVer = version.value(0).toInt();
+    const int minorVer = version.value(1).toInt();
+    const bool unicode = version.value(2).toInt() != 0;
+
+    source = QString("# Source generated with PlasmaShop " PLASMASHOP_VERSION "\n"
+                     "# Powered by Decompyle++\n"
+                     "# File: %1 (Python %2.%3%4)\n\n")
+             .arg(displayName).arg(majorVer).arg(minorVer)
+             .arg((majorVer < 3 && unicode) ? " Unicode" : "").toUtf8();
+    source += output.mid(headerEnd + 1);
+    return true;
+}
+
+bool PycDecompiler::decompile(const QString& filename, const QString& displayName,
+                              QByteArray& source, QString* error, const QAtomicInt* cancel)
+{
+    return runWorker(QStringList(filename), NULL, displayName, source, error, cancel);
+}
+
+bool PycDecompiler::decompileData(const QByteArray& pycData, const QString& displayName,
+                                  QByteArray& source, QString* error, const QAtomicInt* cancel)
+{
+    return runWorker(QStringList(), &pycData, displayName, source, error, cancel);
+}
+
+bool PycDecompiler::isWorker(int argc, char* argv[])
+{
+    return argc >= 2 && strcmp(argv[1], PYCDC_WORKER_ARG) == 0;
+}
+
+int PycDecompiler::workerMain(int argc, char* argv[])
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    // pycdc only loads modules by name.  Piped bytecode is read straight
+    // from the pipe, except on Windows, which has no name for it.
+    QByteArray filename;
+    if (argc >= 3) {
+        filename = argv[2];
+    } else {
+#ifdef _WIN32
+        QFile in;
+        QTemporaryFile temp;
+        if (!in.open(stdin, QIODevice::ReadOnly) || !temp.open()
+                || temp.write(in.readAll()) < 0 || !temp.flush()) {
+            fputs("Could not buffer the bytecode\n", stderr);
+            return 1;
+        }
+        temp.setAutoRemove(false);
+        filename = QFile::encodeName(temp.fileName());
+        temp.close();
+#else
+        filename = "/dev/stdin";
+#endif
+    }
+
+    int result = 1;
+    try {
+        PycModule mod;
+        mod.loadFromFile(filename.constData());
+        if (mod.isValid()) {
+            pyc_output = stdout;
+            printf("%d %d %d\n", mod.majorVer(), mod.minorVer(), mod.isUnicode() ? 1 : 0);
+            decompyle(mod.code(), &mod);
+            fflush(stdout);
+            result = 0;
+        } else {
+            fputs("Invalid or unsupported bytecode\n", stderr);
+        }
+    } catch (std::exception& ex) {
+        fprintf(stderr, "%s\n", ex.what());
+    }
+
+#ifdef _WIN32
+    if (argc < 3)
+        QFile::remove(QFile::decodeName(filename));
+#endif
+    return result;
+}
@@ -0,0 +1,64 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _PYCDECOMPILER_H
+#define _PYCDECOMPILER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QAtomicInt>
+
+/**
+ * Wraps Decompyle++ so that each call produces its source in its own
+ * in-memory buffer rather than through the shared pyc_output file.  Each
+ * module is decompiled in a separate worker process, so calls from
+ * several threads run in parallel.
+ */
+class PycDecompiler
+{
+public:
+    /**
+     * Decompile a .pyc file.
+     * @param filename the bytecode file to load
+     * @param displayName the name to record in the generated header comment
+     * @param source receives the generated source (UTF-8)
+     * @param error if not NULL, receives a description of any failure
+     * @param cancel if not NULL, the worker is killed once this is set
+     * @return whether the file was successfully decompiled.  A worker that
+     *         is cancelled or runs for too long counts as a failure.
+     */
+    static bool decompile(const QString& filename, const QString& displayName,
+                          QByteArray& source, QString* error = NULL,
+                          const QAtomicInt* cancel = NULL);
+
+    /**
+     * Decompile the contents of a .pyc file (including its magic header)
+     * which are already in memory.
+     */
+    static bool decompileData(const QByteArray& pycData, const QString& displayName,
+                              QByteArray& source, QString* error = NULL,
+                              const QAtomicInt* cancel = NULL);
+
+    /**
+     * Whether the process was started as a decompiler worker, in which case
+     * main() should return workerMain() without setting up any UI.
+     */
+    static bool isWorker(int argc, char* argv[]);
+    static int workerMain(int argc, char* argv[]);
+};
+
+#endif
@@ -17,25 +17,60 @@
 #include "QPlasmaPakFile.h"
 #include <Debug/plDebug.h>
 #include <Stream/plEncryptedStream.h>
+#include <Stream/hsRAMStream.h>
 #include <QGridLayout>
 #include <QMessageBox>
 #include <QMenu>
 #include <QToolBar>
 #include <QFileDialog>
 #include <QSettings>
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
 #include "QPlasma.h"
-
-#include <ASTree.h>
-#include <data.h>
-#include <cstdio>
+#include "PycDecompiler.h"
+#include "PyCompiler.h"
 #include "Main.h"
 
 #define PYC_MAGIC_22  (0x0A0DED2D)
 #define PYC_MAGIC_23  (0x0A0DF23B)
 
+// Unchanged entries are copied between packages in blocks of this size
+#define COPY_BLOCK_SIZE (64 * 1024)
+
 /* PlasmaPackage */
 void PlasmaPackage::read(hsStream* S)
 {
+    fSource.reset();
+    readEntries(S, true);
+}
+
+void PlasmaPackage::readIndex(hsStream* S)
+{
+    std::unique_ptr<hsStream> stream(S);
+    fSource.reset();
+    readEntries(S, false);
+    setSource(stream.release());
+}
+
+void PlasmaPackage::setSource(hsStream* S)
+{
+    // Fonts are always parsed up front, so there is nothing left to fetch
+    if (fType == kFontsPfp) {
+        delete S;
+        fSource.reset();
+        return;
+    }
+    fSource = std::make_shared<DataSource>();
+    fSource->fStream.reset(S);
+}
+
+void PlasmaPackage::readEntries(hsStream* S, bool loadData)
+{
+    fEntries.clear();
+    fNameIndex.clear();
     uint32_t magic = S->readInt();
     if (magic == kMyst5Arc) {
         // Cursors.dat or Fonts.pfp file
@@ -72,9 +107,14 @@ void PlasmaPackage::read(hsStream* S)
                 fEntries[i].fName = S->readStr(length);
                 fEntries[i].fOffset = S->pos();
                 uint32_t size = S->readInt();
-                uint8_t* data = new uint8_t[size];
-                S->read(size, data);
-                fEntries[i].fData = FileBlob(data, size);
+                fEntries[i].fSize = size;
+                if (loadData) {
+                    uint8_t* data = new uint8_t[size];
+                    S->read(size, data);
+                    fEntries[i].fData = FileBlob(data, size);
+                } else {
+                    S->skip(size);
+                }
             } else {
                 fEntries[i].fOffset = S->pos();
                 fEntries[i].fFontData.readP2F(S);
@@ -97,15 +137,37 @@ void PlasmaPackage::read(hsStream* S)
                 plDebug::Warning("Warning: Pak file: Truncating last entry");
                 size = S->size() - S->pos();
             }
-            uint8_t* data = new uint8_t[size];
-            S->read(size, data);
-            fEntries[i].fData = FileBlob(data, size);
+            fEntries[i].fSize = size;
+            if (loadData) {
+                uint8_t* data = new uint8_t[size];
+                S->read(size, data);
+                fEntries[i].fData = FileBlob(data, size);
+            }
         }
     }
 }
 
+PlasmaPackage::FileBlob PlasmaPackage::entryData(const FileEntry& ent) const
+{
+    if (ent.fData.getData() != NULL || !fSource)
+        return ent.fData;
+
+    // The source stream is shared by all entries (and possibly by several
+    // extraction threads), so only one fetch may seek it at a time
+    QMutexLocker lock(&fSource->fLock);
+    hsStream* S = fSource->fStream.get();
+    S->seek(ent.fOffset + sizeof(uint32_t));
+    uint8_t* data = new uint8_t[ent.fSize];
+    S->read(ent.fSize, data);
+    return FileBlob(data, ent.fSize);
+}
+
 void PlasmaPackage::write(hsStream* S)
 {
+    // Unchanged entries are still read from their old offsets while they
+    // are copied, so the new offsets are only stored once we're done
+    std::vector<uint32_t> offsets(fEntries.size());
+
     if (fType == kPythonPak) {
         S->writeInt(fEntries.size());
 
@@ -117,19 +179,17 @@ void PlasmaPackage::write(hsStream* S)
             off_accum += 6 + fEntries[i].fName.size();
         }
         for (size_t i=0; i<fEntries.size(); i++) {
-            fEntries[i].fOffset = off_accum;
-            off_accum += fEntries[i].fData.getSize() + sizeof(uint32_t);
+            offsets[i] = off_accum;
+            off_accum += fEntries[i].fSize + sizeof(uint32_t);
         }
 
         // Now actually write the data
         for (size_t i=0; i<fEntries.size(); i++) {
             S->writeSafeStr(fEntries[i].fName);
-            S->writeInt(fEntries[i].fOffset);
-        }
-        for (size_t i=0; i<fEntries.size(); i++) {
-            S->writeInt(fEntries[i].fData.getSize());
-            S->write(fEntries[i].fData.getSize(), fEntries[i].fData.getData());
+            S->writeInt(offsets[i]);
         }
+        for (size_t i=0; i<fEntries.size(); i++)
+            copyEntry(fEntries[i], S);
     } else {
         S->writeInt(kMyst5Arc);
         S->writeInt(fUnknown);
@@ -139,13 +199,40 @@ void PlasmaPackage::write(hsStream* S)
             if (fType == kCursorsDat) {
                 S->writeInt(fEntries[i].fName.size());
                 S->writeStr(fEntries[i].fName);
-                S->writeInt(fEntries[i].fData.getSize());
-                S->write(fEntries[i].fData.getSize(), fEntries[i].fData.getData());
+                offsets[i] = S->pos();
+                copyEntry(fEntries[i], S);
             } else {
+                offsets[i] = S->pos();
                 fEntries[i].fFontData.writeP2F(S);
             }
         }
     }
+
+    for (size_t i=0; i<fEntries.size(); i++)
+        fEntries[i].fOffset = offsets[i];
+}
+
+void PlasmaPackage::copyEntry(const FileEntry& ent, hsStream* S) const
+{
+    S->writeInt(ent.fSize);
+    if (ent.fData.getData() != NULL || !fSource) {
+        S->write(ent.fData.getSize(), ent.fData.getData());
+        return;
+    }
+
+    // Stream the entry straight across without loading all of it; any
+    // decryption and re-encryption happens a block at a time
+    QMutexLocker lock(&fSource->fLock);
+    hsStream* src = fSource->fStream.get();
+    src->seek(ent.fOffset + sizeof(uint32_t));
+    std::vector<uint8_t> buffer(std::min<size_t>(ent.fSize, COPY_BLOCK_SIZE));
+    size_t remain = ent.fSize;
+    while (remain > 0) {
+        size_t count = std::min(remain, buffer.size());
+        src->read(count, buffer.data());
+        S->write(count, buffer.data());
+        remain -= count;
+    }
 }
 
 void PlasmaPackage::addFrom(QString filename)
@@ -159,7 +246,8 @@ void PlasmaPackage::addFrom(QString filename)
     if (fType == kFontsPfp) {
         add.fFontData.readP2F(&S);
     } else {
-        if (fType == kPythonPak) // TODO: compile py to pyc
+        // Sources are compiled separately; see QPlasmaPakFile::addSources
+        if (fType == kPythonPak)
             add.fName = qstr2st(finfo.fileName()).replace(".pyc", ".py");
         else
             add.fName = qstr2st(finfo.fileName());
@@ -167,53 +255,115 @@ void PlasmaPackage::addFrom(QString filename)
         uint8_t* data = new uint8_t[S.size()];
         S.read(S.size(), data);
         add.fData = PlasmaPackage::FileBlob(data, S.size());
+        add.fSize = S.size();
     }
     S.close();
+    addEntry(add);
+}
 
-    // Check if the file is already in the package...  If so, delete it first
+void PlasmaPackage::addBytecode(const QString& name, const QByteArray& code)
+{
+    FileEntry add;
+    add.fName = qstr2st(name);
+    uint8_t* data = new uint8_t[code.size()];
+    memcpy(data, code.constData(), code.size());
+    add.fData = PlasmaPackage::FileBlob(data, code.size());
+    add.fSize = code.size();
+    addEntry(add);
+}
+
+void PlasmaPackage::addEntry(const FileEntry& add)
+{
+    // Check if the file is already in the package...  If so, replace it
     // to avoid duplicates
-    std::vector<FileEntry>::iterator iter = fEntries.begin();
-    while (iter != fEntries.end()) {
-        if (displayName(*iter) == displayName(add)) {
-            iter = fEntries.erase(iter);
-            break;
-        } else {
-            ++iter;
-        }
+    QString name = displayName(add);
+    int idx = findEntry(name);
+    if (idx >= 0) {
+        fEntries[idx] = add;
+    } else {
+        fNameIndex.insert(name, fEntries.size());
+        fEntries.push_back(add);
+    }
+}
+
+int PlasmaPackage::findEntry(const QString& name)
+{
+    if (fNameIndex.isEmpty()) {
+        for (size_t i=0; i<fEntries.size(); i++)
+            fNameIndex.insert(displayName(fEntries[i]), i);
     }
-    fEntries.push_back(add);
+    return fNameIndex.contains(name) ? (int)fNameIndex.value(name) : -1;
+}
+
+void PlasmaPackage::removeEntry(size_t idx)
+{
+    fEntries.erase(fEntries.begin() + idx);
+
+    // Indices after the removed entry have shifted; rebuild on next use
+    fNameIndex.clear();
 }
 
-void PlasmaPackage::writeToFile(const FileEntry& ent, QString filename)
+void PlasmaPackage::writeToFile(const FileEntry& ent, QString filename, QString* warning) const
 {
     hsFileStream S;
     S.open(QDir::toNativeSeparators(filename).toUtf8().data(), fmCreate);
+    writeEntry(ent, &S, warning);
+    S.close();
+}
 
+void PlasmaPackage::writeEntry(const FileEntry& ent, hsStream* S, QString* warning) const
+{
     if (fType == kFontsPfp) {
-        ent.fFontData.writeP2F(&S);
+        ent.fFontData.writeP2F(S);
     } else if (fType == kCursorsDat) {
-        S.write(ent.fData.getSize(), ent.fData.getData());
+        FileBlob data = entryData(ent);
+        S->write(data.getSize(), data.getData());
     } else {
-        // Dirty hack which is more likely to be correct than PlasmaShop 2.x:
-        // Examine the header of each bytecode blob -- if the PyCode object
-        // is from Python 2.2, there will be a PyString after 4 uint16s...
-        // if it is from Python 2.3, the PyString will be after 4 uint32s
-        if (ent.fData.getSize() > 9 && ent.fData.getData()[9] == 's') {
-            S.writeInt(PYC_MAGIC_22);
-        } else if (ent.fData.getSize() > 17 && ent.fData.getData()[17] == 's') {
-            S.writeInt(PYC_MAGIC_23);
+        FileBlob data = entryData(ent);
+        const QString version = codeBlobVersion(data);
+        if (version == "2.2") {
+            S->writeInt(PYC_MAGIC_22);
+        } else if (version == "2.3") {
+            S->writeInt(PYC_MAGIC_23);
         } else {
-            QMessageBox::critical(NULL, QObject::tr("Error parsing Python blob"),
-                    QObject::tr("Could not determine Python code blob version.  Assuming 2.3"));
-            S.writeInt(PYC_MAGIC_23);
+            QString message = QObject::tr("Could not determine Python code blob version.  Assuming 2.3");
+            if (warning)
+                *warning = QString("%1: %2").arg(displayName(ent)).arg(message);
+            else
+                QMessageBox::critical(NULL, QObject::tr("Error parsing Python blob"), message);
+            S->writeInt(PYC_MAGIC_23);
         }
 
         // Timestamp...  Not saved, so just set it to zero
-        S.writeInt(0);
+        S->writeInt(0);
 
-        S.write(ent.fData.getSize(), ent.fData.getData());
+        S->write(data.getSize(), data.getData());
     }
-    S.close();
+}
+
+QString PlasmaPackage::codeBlobVersion(const FileBlob& data)
+{
+    // Dirty hack which is more likely to be correct than PlasmaShop 2.x:
+    // Examine the header of each bytecode blob -- if the PyCode object
+    // is from Python 2.2, there will be a PyString after 4 uint16s...
+    // if it is from Python 2.3, the PyString will be after 4 uint32s
+    if (data.getSize() > 9 && data.getData()[9] == 's')
+        return "2.2";
+    else if (data.getSize() > 17 && data.getData()[17] == 's')
+        return "2.3";
+    return QString();
+}
+
+QString PlasmaPackage::pythonVersion() const
+{
+    if (fType != kPythonPak)
+        return QString();
+    for (const FileEntry& ent : fEntries) {
+        QString version = codeBlobVersion(entryData(ent));
+        if (!version.isEmpty())
+            return version;
+    }
+    return QString();
 }
 
 QString PlasmaPackage::displayName(const FileEntry& ent) const
@@ -234,7 +384,7 @@ QString PlasmaPackage::displaySize(const PlasmaPackage::FileEntry& ent) const
                 .arg(ent.fFontData.getHeight() / ent.fFontData.getNumCharacters())
                 .arg(ent.fFontData.getNumCharacters());
     } else {
-        return QString("%L1 bytes").arg(ent.fData.getSize());
+        return QString("%L1 bytes").arg(ent.fSize);
     }
 }
 
@@ -245,7 +395,9 @@ QString PlasmaPackage::getFilter() const
     } else if (fType == kFontsPfp) {
         return "Plasma Fonts (*.p2f)";
     } else {
-        return "Python Bytecode (*.pyc *.pyo)";
+        return "Python Files (*.py *.pyc *.pyo);;"
+               "Python Bytecode (*.pyc *.pyo);;"
+               "Python Sources (*.py)";
     }
 }
 
@@ -275,47 +427,56 @@ QPlasmaPakFile::QPlasmaPakFile(QWidget* parent)
     setLayout(layout);
 
     fActions[kAdd] = new QAction(qStdIcon("list-add"), tr("&Add / Update..."), this);
+    fActions[kCompileDir] = new QAction(qStdIcon("folder-open"), tr("&Compile Directory..."), this);
     fActions[kDel] = new QAction(qStdIcon("list-remove"), tr("&Delete"), this);
     fActions[kExtract] = new QAction(qStdIcon("document-save"), tr("&Extract..."), this);
     fActions[kExtractAll] = new QAction(QIcon(":/img/pak.png"), tr("Ex&tract all..."), this);
+    fActions[kViewSource] = new QAction(qStdIcon("document-open"), tr("&View Source"), this);
 
     toolbar->addAction(fActions[kAdd]);
+    toolbar->addAction(fActions[kCompileDir]);
     toolbar->addAction(fActions[kDel]);
     toolbar->addSeparator();
     toolbar->addAction(fActions[kExtract]);
     toolbar->addAction(fActions[kExtractAll]);
+    toolbar->addAction(fActions[kViewSource]);
 
     connect(fFileList, &QWidget::customContextMenuRequested,
             this, &QPlasmaPakFile::onContextMenu);
     connect(fActions[kAdd], &QAction::triggered, this, &QPlasmaPakFile::onAdd);
+    connect(fActions[kCompileDir], &QAction::triggered, this, &QPlasmaPakFile::onCompileDir);
     connect(fActions[kDel], &QAction::triggered, this, &QPlasmaPakFile::onDel);
     connect(fActions[kExtract], &QAction::triggered, this, &QPlasmaPakFile::onExtract);
     connect(fActions[kExtractAll], &QAction::triggered, this, &QPlasmaPakFile::onExtractAll);
+    connect(fActions[kViewSource], &QAction::triggered, this, &QPlasmaPakFile::onViewSource);
+    connect(fFileList, &QTreeWidget::itemActivated, this, &QPlasmaPakFile::onViewSource);
 }
 
 bool QPlasmaPakFile::loadFile(const QString& filename)
 {
+    // The stream stays open after loading, so entry data can be read (and
+    // decrypted) only when it is actually needed
     if (plEncryptedStream::IsFileEncrypted(filename.toUtf8().data())) {
-        plEncryptedStream S(PlasmaVer::pvPrime);
-        S.open(filename.toUtf8().data(), fmRead, plEncryptedStream::kEncAuto);
-        if (S.getEncType() == plEncryptedStream::kEncDroid) {
+        std::unique_ptr<plEncryptedStream> S(new plEncryptedStream(PlasmaVer::pvPrime));
+        S->open(filename.toUtf8().data(), fmRead, plEncryptedStream::kEncAuto);
+        if (S->getEncType() == plEncryptedStream::kEncDroid) {
             if (!GetEncryptionKeyFromUser(this, fDroidKey))
                 return false;
-            S.setKey(fDroidKey);
+            S->setKey(fDroidKey);
             fEncryption = kEncDroid;
-        } else if (S.getEncType() == plEncryptedStream::kEncXtea) {
+        } else if (S->getEncType() == plEncryptedStream::kEncXtea) {
             fEncryption = kEncXtea;
-        } else if (S.getEncType() == plEncryptedStream::kEncAES) {
+        } else if (S->getEncType() == plEncryptedStream::kEncAES) {
             fEncryption = kEncAes;
-            S.setVer(PlasmaVer::pvEoa);
+            S->setVer(PlasmaVer::pvEoa);
         }
-        if (!loadPakData(&S))
+        if (!loadPakData(S.release()))
             return false;
     } else {
-        hsFileStream S(PlasmaVer::pvMoul);
-        S.open(filename.toUtf8().data(), fmRead);
+        std::unique_ptr<hsFileStream> S(new hsFileStream(PlasmaVer::pvMoul));
+        S->open(filename.toUtf8().data(), fmRead);
         fEncryption = kEncNone;
-        if (!loadPakData(&S))
+        if (!loadPakData(S.release()))
             return false;
     }
     fFileList->resizeColumnToContents(1);
@@ -324,10 +485,35 @@ bool QPlasmaPakFile::loadFile(const QString& filename)
 }
 
 bool QPlasmaPakFile::saveTo(const QString& filename)
+{
+    // Unchanged entries are copied from the file we loaded, which may be
+    // the one being replaced, so the package is written beside it first
+    const QString tempName = filename + ".tmp";
+    if (!writePackage(tempName, filename)) {
+        QFile::remove(tempName);
+        return false;
+    }
+
+    // From now on entries are read from the new file, at their new offsets
+    fPackage.fSource.reset();
+    QString current = filename;
+    bool replaced = (!QFile::exists(filename) || QFile::remove(filename))
+                    && QFile::rename(tempName, filename);
+    if (!replaced) {
+        plDebug::Error("Could not replace {}; the package was saved to {}",
+                       filename.toUtf8().data(), tempName.toUtf8().data());
+        current = tempName;
+    }
+    if (!openSource(current) || !replaced)
+        return false;
+    return QPlasmaDocument::saveTo(filename);
+}
+
+bool QPlasmaPakFile::writePackage(const QString& tempName, const QString& filename)
 {
     if (fEncryption == kEncNone) {
         hsFileStream S(PlasmaVer::pvMoul);
-        S.open(filename.toUtf8().data(), fmCreate);
+        S.open(tempName.toUtf8().data(), fmCreate);
         if (!savePakData(&S))
             return false;
     } else {
@@ -346,11 +532,34 @@ bool QPlasmaPakFile::saveTo(const QString& filename)
         } else if (fEncryption == kEncXtea) {
             type = plEncryptedStream::kEncXtea;
         }
-        S.open(filename.toUtf8().data(), fmCreate, type);
+        S.open(tempName.toUtf8().data(), fmCreate, type);
         if (!savePakData(&S))
             return false;
     }
-    return QPlasmaDocument::saveTo(filename);
+    return true;
+}
+
+bool QPlasmaPakFile::openSource(const QString& filename)
+{
+    try {
+        if (fEncryption == kEncNone) {
+            std::unique_ptr<hsFileStream> S(new hsFileStream(PlasmaVer::pvMoul));
+            S->open(filename.toUtf8().data(), fmRead);
+            fPackage.setSource(S.release());
+        } else {
+            std::unique_ptr<plEncryptedStream> S(new plEncryptedStream(PlasmaVer::pvPrime));
+            S->open(filename.toUtf8().data(), fmRead, plEncryptedStream::kEncAuto);
+            if (fEncryption == kEncDroid)
+                S->setKey(fDroidKey);
+            else if (fEncryption == kEncAes)
+                S->setVer(PlasmaVer::pvEoa);
+            fPackage.setSource(S.release());
+        }
+    } catch (std::exception &e) {
+        plDebug::Error("Error reopening Package file {}: {}", filename.toUtf8().data(), e.what());
+        return false;
+    }
+    return true;
 }
 
 bool QPlasmaPakFile::loadPakData(hsStream* S)
@@ -358,12 +567,14 @@ bool QPlasmaPakFile::loadPakData(hsStream* S)
     fFileList->clear();
     if (S != NULL) {
         try {
-            fPackage.read(S);
+            fPackage.readIndex(S);
         } catch (std::exception &e) {
             plDebug::Error("Error reading Package file {}: {}", fFilename.toUtf8().data(), e.what());
             return false;
         }
     }
+    fActions[kCompileDir]->setVisible(fPackage.fType == PlasmaPackage::kPythonPak);
+    fActions[kViewSource]->setVisible(fPackage.fType == PlasmaPackage::kPythonPak);
 
     for (size_t i=0; i<fPackage.fEntries.size(); i++) {
         QTreeWidgetItem* ent = new QTreeWidgetItem(fFileList);
@@ -396,13 +607,20 @@ void QPlasmaPakFile::onContextMenu(QPoint pos)
     }
     fActions[kDel]->setEnabled(itemSelected);
     fActions[kExtract]->setEnabled(itemSelected);
+    fActions[kViewSource]->setEnabled(itemSelected);
 
     QMenu menu(this);
     menu.addAction(fActions[kAdd]);
+    if (fActions[kCompileDir]->isVisible())
+        menu.addAction(fActions[kCompileDir]);
     menu.addAction(fActions[kDel]);
     menu.addSeparator();
     menu.addAction(fActions[kExtract]);
     menu.addAction(fActions[kExtractAll]);
+    if (fActions[kViewSource]->isVisible()) {
+        menu.addSeparator();
+        menu.addAction(fActions[kViewSource]);
+    }
     menu.exec(fFileList->viewport()->mapToGlobal(pos));
 }
 
@@ -419,20 +637,133 @@ void QPlasmaPakFile::onAdd()
     }
     QStringList files = QFileDialog::getOpenFileNames(this, tr("Add / update files"),
                                                       gameRoot, fPackage.getFilter());
-    foreach (QString f, files)
-        fPackage.addFrom(f);
+    QStringList sources;
+    foreach (QString f, files) {
+        if (fPackage.fType == PlasmaPackage::kPythonPak && f.endsWith(".py", Qt::CaseInsensitive))
+            sources << f;
+        else
+            fPackage.addFrom(f);
+    }
+
+    if (files.size() != sources.size()) {
+        loadPakData(NULL);
+        makeDirty();
+    }
+    if (!sources.isEmpty())
+        addSources(sources);
+}
+
+void QPlasmaPakFile::onCompileDir()
+{
+    QSettings settings("PlasmaShop", "PlasmaShop");
+    QString gameRoot = settings.value("DialogDir", "").toString();
+    QString curGame = settings.value("CurrentGame", QString()).toString();
+    settings.beginGroup("Games");
+    if (!curGame.isEmpty()) {
+        QStringList gmParams = settings.value(curGame).toStringList();
+        if (!gmParams.isEmpty())
+            gameRoot = gmParams[0];
+    }
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Select Python source directory"),
+                                                    gameRoot);
+    if (dir.isEmpty())
+        return;
+
+    QStringList sources;
+    foreach (QFileInfo info, QDir(dir).entryInfoList(QStringList("*.py"), QDir::Files, QDir::Name))
+        sources << info.absoluteFilePath();
+    if (sources.isEmpty()) {
+        QMessageBox::information(this, tr("Compile Directory"),
+                                 tr("There are no Python sources in %1").arg(dir),
+                                 QMessageBox::Ok);
+        return;
+    }
+    addSources(sources);
+}
+
+void QPlasmaPakFile::addSources(const QStringList& sources)
+{
+    QSettings settings("PlasmaShop", "PlasmaShop");
+    QString interpreter = settings.value("PythonPath", "").toString();
+    if (interpreter.isEmpty()) {
+        QMessageBox::critical(this, tr("No Python Interpreter set"),
+                              tr("Compiling Python sources requires an interpreter matching "
+                                 "the game's Python version (2.2 or 2.3).  Please set one in "
+                                 "the PlasmaShop Options."),
+                              QMessageBox::Ok);
+        return;
+    }
+
+    // New bytecode has to match what the game already loads from this
+    // package.  An empty package can't tell us, so either version goes.
+    QString version;
+    try {
+        version = fPackage.pythonVersion();
+    } catch (std::exception& ex) {
+        plDebug::Error("Could not read Python package: {}", ex.what());
+    }
+
+    // Each batch is compiled by its own interpreter process, several at a
+    // time on the worker pool
+    QVector<QVector<PyCompiler::Source>> batches;
+    for (int i = 0; i < sources.size(); i += PYC_BATCH_SIZE) {
+        QVector<PyCompiler::Source> batch;
+        foreach (QString filename, sources.mid(i, PYC_BATCH_SIZE)) {
+            PyCompiler::Source src;
+            src.fFilename = filename;
+            batch.append(src);
+        }
+        batches.append(batch);
+    }
 
-    if (files.size() != 0) {
+    QProgressDialog progress(tr("Compiling Python sources..."), tr("Cancel"), 0, batches.size(), this);
+    progress.setWindowModality(Qt::WindowModal);
+    QFutureWatcher<void> watcher;
+    connect(&watcher, &QFutureWatcher<void>::progressValueChanged,
+            &progress, &QProgressDialog::setValue);
+    connect(&watcher, &QFutureWatcher<void>::finished, &progress, &QProgressDialog::reset);
+    connect(&progress, &QProgressDialog::canceled, &watcher, &QFutureWatcher<void>::cancel);
+    watcher.setFuture(QtConcurrent::map(batches, [interpreter, version](QVector<PyCompiler::Source>& batch) {
+        PyCompiler::compileBatch(interpreter, version, batch);
+    }));
+    progress.exec();
+    watcher.waitForFinished();
+
+    // Add everything that compiled in a single update.  Batches skipped
+    // by cancelling have neither bytecode nor an error.
+    QStringList errors;
+    int added = 0;
+    for (const QVector<PyCompiler::Source>& batch : batches) {
+        for (const PyCompiler::Source& src : batch) {
+            if (!src.fError.isEmpty()) {
+                errors << src.fError;
+            } else if (!src.fBytecode.isEmpty()) {
+                fPackage.addBytecode(QFileInfo(src.fFilename).fileName(), src.fBytecode);
+                ++added;
+            }
+        }
+    }
+    if (added > 0) {
         loadPakData(NULL);
         makeDirty();
     }
+    if (!errors.isEmpty()) {
+        // A wrong interpreter gives every file the same error
+        const int failed = errors.size();
+        errors.removeDuplicates();
+        QMessageBox msgBox(QMessageBox::Warning, tr("Compile Python sources"),
+                           tr("%1 file(s) could not be compiled").arg(failed),
+                           QMessageBox::Ok, this);
+        msgBox.setDetailedText(errors.join('\n'));
+        msgBox.exec();
+    }
 }
 
 void QPlasmaPakFile::onDel()
 {
     foreach (QTreeWidgetItem* item, fFileList->selectedItems()) {
         int idx = fFileList->indexOfTopLevelItem(item);
-        fPackage.fEntries.erase(fPackage.fEntries.begin() + idx);
+        fPackage.removeEntry(idx);
         delete item;
     }
 
@@ -462,6 +793,14 @@ void QPlasmaPakFile::onExtract()
     }
 }
 
+struct ExtractJob
+{
+    const PlasmaPackage::FileEntry* fEntry;
+    QString fPath;
+    bool fWriteData, fDecompile;
+    QString fError;
+};
+
 void QPlasmaPakFile::onExtractAll()
 {
     QSettings settings("PlasmaShop", "PlasmaShop");
@@ -475,22 +814,134 @@ void QPlasmaPakFile::onExtractAll()
     }
     QString dir = QFileDialog::getExistingDirectory(this, tr("Select Extract location"),
                                                     gameRoot);
-    if (!dir.isEmpty()) {
-        std::vector<PlasmaPackage::FileEntry>::iterator iter;
-        OverwritingConfirmation confirmation = Ask;
-        for (iter = fPackage.fEntries.begin(); iter != fPackage.fEntries.end(); ++iter) {
-             extract(*iter, dir, &confirmation);
+    if (dir.isEmpty())
+        return;
+
+    // Decide what to do about existing files before starting, so the
+    // workers never need to ask
+    const bool isPython = (fPackage.fType == PlasmaPackage::kPythonPak);
+    QVector<ExtractJob> jobs;
+    jobs.reserve(fPackage.fEntries.size());
+    int existing = 0;
+    for (const PlasmaPackage::FileEntry& entry : fPackage.fEntries) {
+        ExtractJob job;
+        job.fEntry = &entry;
+        job.fPath = extractPath(entry, dir);
+        job.fWriteData = !QFileInfo::exists(job.fPath);
+        job.fDecompile = isPython && !QFileInfo::exists(QString(job.fPath).replace(".pyc", ".py"));
+        if (!job.fWriteData || (isPython && !job.fDecompile))
+            ++existing;
+        jobs.append(job);
+    }
+    if (existing > 0) {
+        int result = QMessageBox::question(this, tr("Replace files"),
+                            tr("%1 of the files to extract already exist.  Would you like to replace them?")
+                            .arg(existing),
+                            QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+        if (result == QMessageBox::Cancel)
+            return;
+        if (result == QMessageBox::Yes) {
+            for (ExtractJob& job : jobs) {
+                job.fWriteData = true;
+                job.fDecompile = isPython;
+            }
+        }
+    }
+
+    // Each decompile runs in its own worker process (see PycDecompiler),
+    // so the pool keeps one going per thread alongside the plain writes
+    QProgressDialog progress(isPython ? tr("Extracting and decompiling files...")
+                                      : tr("Extracting files..."),
+                             tr("Cancel"), 0, jobs.size(), this);
+    progress.setWindowModality(Qt::WindowModal);
+    QFutureWatcher<void> watcher;
+    QAtomicInt cancel;
+    connect(&watcher, &QFutureWatcher<void>::progressValueChanged,
+            &progress, &QProgressDialog::setValue);
+    connect(&watcher, &QFutureWatcher<void>::finished, &progress, &QProgressDialog::reset);
+    connect(&progress, &QProgressDialog::canceled, &watcher, [&watcher, &cancel] {
+        // Also stops any decompiler workers that are already running
+        cancel.storeRelease(1);
+        watcher.cancel();
+    });
+    watcher.setFuture(QtConcurrent::map(jobs, [this, &cancel](ExtractJob& job) {
+        try {
+            if (job.fWriteData)
+                fPackage.writeToFile(*job.fEntry, job.fPath, &job.fError);
+            QString error;
+            if (job.fDecompile && !decompyleToFile(job.fPath, QString(job.fPath).replace(".pyc", ".py"),
+                                                   &error, &cancel))
+                job.fError = job.fError.isEmpty() ? error : job.fError + '\n' + error;
+        } catch (std::exception& ex) {
+            job.fError = QString("%1: %2").arg(job.fPath).arg(ex.what());
         }
+    }));
+    progress.exec();
+    watcher.waitForFinished();
+
+    QStringList errors;
+    for (const ExtractJob& job : jobs) {
+        if (!job.fError.isEmpty())
+            errors << job.fError;
+    }
+    if (!errors.isEmpty()) {
+        QMessageBox msgBox(QMessageBox::Warning, tr("Extract all"),
+                           tr("%1 file(s) could not be extracted cleanly").arg(errors.size()),
+                           QMessageBox::Ok, this);
+        msgBox.setDetailedText(errors.join('\n'));
+        msgBox.exec();
     }
 }
 
-void QPlasmaPakFile::extract(const PlasmaPackage::FileEntry& entry, QString dir, OverwritingConfirmation *confirmation)
+void QPlasmaPakFile::onViewSource()
+{
+    if (fPackage.fType != PlasmaPackage::kPythonPak)
+        return;
+
+    PlasmaShopMain* mainWnd = qobject_cast<PlasmaShopMain*>(window());
+    if (mainWnd == NULL)
+        return;
+
+    foreach (QTreeWidgetItem* item, fFileList->selectedItems()) {
+        const PlasmaPackage::FileEntry& entry = fPackage.fEntries[fFileList->indexOfTopLevelItem(item)];
+        QString name = fPackage.displayName(entry);
+
+        // Decompile straight from the package data; nothing is written
+        // next to the .pak
+        QByteArray source;
+        QString error;
+        bool decompiled = false;
+        try {
+            hsRAMStream S;
+            fPackage.writeEntry(entry, &S);
+            QByteArray pycData(S.size(), Qt::Uninitialized);
+            S.rewind();
+            S.read(pycData.size(), pycData.data());
+
+            decompiled = PycDecompiler::decompileData(pycData, name, source, &error);
+        } catch (std::exception& ex) {
+            error = QString("%1: %2").arg(name).arg(ex.what());
+        }
+        if (!decompiled) {
+            QMessageBox::critical(this, tr("Decompyle Error"), error, QMessageBox::Ok);
+            continue;
+        }
+        mainWnd->openText(name, QString::fromUtf8(source));
+    }
+}
+
+QString QPlasmaPakFile::extractPath(const PlasmaPackage::FileEntry& entry, const QString& dir) const
 {
     QString dispName = fPackage.displayName(entry);
     if (fPackage.fType == PlasmaPackage::kPythonPak)
         dispName.replace(".py", ".pyc");
+    return dir + QDir::separator() + dispName;
+}
 
-    QString path = dir + QDir::separator() + dispName;
+void QPlasmaPakFile::extract(const PlasmaPackage::FileEntry& entry, QString dir, OverwritingConfirmation *confirmation)
+{
+    QString path = extractPath(entry, dir);
+    QString dispName = QFileInfo(path).fileName();
     if (QFileInfo(path).exists()) {
         int result;
         if (*confirmation == YesToAll) {
@@ -543,20 +994,27 @@ bool QPlasmaPakFile::decompylePyc(QWidget *parent, QString filename, Overwriting
             return true;
     }
 
-    PycModule mod;
-    mod.loadFromFile(filename.toUtf8().data());
-    if (!mod.isValid()) {
-        QMessageBox::critical(parent, QObject::tr("Decompyle Error"),
-                              QObject::tr("Could not load file %1").arg(filename));
+    QString error;
+    if (!decompyleToFile(filename, output, &error)) {
+        QMessageBox::critical(parent, QObject::tr("Decompyle Error"), error);
         return false;
     }
+    return true;
+}
 
-    pyc_output = fopen(output.toUtf8().data(), "w");
-    fprintf(pyc_output, "# Source generated with PlasmaShop " PLASMASHOP_VERSION "\n");
-    fprintf(pyc_output, "# Powered by Decompyle++\n");
-    fprintf(pyc_output, "# File: %s (Python %d.%d%s)\n\n", QFileInfo(output).fileName().toUtf8().data(),
-            mod.majorVer(), mod.minorVer(), (mod.majorVer() < 3 && mod.isUnicode()) ? " Unicode" : "");
-    decompyle(mod.code(), &mod);
-    fclose(pyc_output);
+bool QPlasmaPakFile::decompyleToFile(const QString& filename, const QString& output, QString* error,
+                                     const QAtomicInt* cancel)
+{
+    QByteArray source;
+    if (!PycDecompiler::decompile(filename, QFileInfo(output).fileName(), source, error, cancel))
+        return false;
+
+    QFile outFile(output);
+    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || outFile.write(source) != source.size()) {
+        if (error)
+            *error = QObject::tr("Could not open %1 for writing").arg(output);
+        return false;
+    }
     return true;
 }
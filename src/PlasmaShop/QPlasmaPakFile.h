@@ -21,7 +21,11 @@
 #include <PRP/Surface/plFont.h>
 #include <QTreeWidget>
 #include <QAction>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QHash>
 #include <vector>
+#include <memory>
 
 struct PlasmaPackage
 {
@@ -32,6 +36,8 @@ struct PlasmaPackage
             const uint8_t* fData;
             size_t fSize;
             unsigned int fRefs;
+
+            ~_data() { delete[] fData; }
         } *fData;
 
         FileBlob() : fData() { }
@@ -73,11 +79,11 @@ struct PlasmaPackage
     struct FileEntry
     {
         ST::string fName;
-        uint32_t fOffset;
+        uint32_t fOffset, fSize;
         FileBlob fData;
         plFont fFontData;
 
-        FileEntry() { }
+        FileEntry() : fOffset(), fSize() { }
     };
 
     enum PackageType
@@ -86,21 +92,66 @@ struct PlasmaPackage
         kMyst5Arc = 0xCBBCF00D,
     };
 
+    // The stream an index-only package was read from.  Entries without
+    // resident data are fetched from here when needed.
+    struct DataSource
+    {
+        std::unique_ptr<hsStream> fStream;
+        QMutex fLock;
+    };
+
     PackageType fType;
     uint32_t fUnknown;
     std::vector<FileEntry> fEntries;
+    std::shared_ptr<DataSource> fSource;
+    QHash<QString, size_t> fNameIndex;
 
     PlasmaPackage() : fType(kPythonPak), fUnknown(1) { }
 
     void read(hsStream* S);
     void write(hsStream* S);
 
+    // Read only the names and offsets of the entries, taking ownership of S
+    // so that the data can be fetched on demand by entryData()
+    void readIndex(hsStream* S);
+
+    // Returns the entry's data, reading it from the source stream if it is
+    // not already in memory.  Safe to call from several threads at once.
+    FileBlob entryData(const FileEntry& ent) const;
+
+    // Replace the source stream (e.g. with a freshly saved copy of the
+    // package), taking ownership of S
+    void setSource(hsStream* S);
+
+    // Adds or replaces the entry with the file's name
     void addFrom(QString filename);
-    void writeToFile(const FileEntry& ent, QString filename);
+    void addBytecode(const QString& name, const QByteArray& code);
+    void addEntry(const FileEntry& add);
+    void removeEntry(size_t idx);
+
+    // Returns the index of the entry with this display name, or -1
+    int findEntry(const QString& name);
+
+    // If warning is NULL, problems with the data are reported in a message
+    // box; otherwise they are stored there, so this can run off the GUI thread
+    void writeToFile(const FileEntry& ent, QString filename, QString* warning = NULL) const;
+    void writeEntry(const FileEntry& ent, hsStream* S, QString* warning = NULL) const;
+
+    // Returns the Python version ("2.2" or "2.3") that compiled a bytecode
+    // blob, or an empty string if it can't be determined
+    static QString codeBlobVersion(const FileBlob& data);
+
+    // Returns the Python version of the first entry whose version can be
+    // determined, or an empty string if there is none
+    QString pythonVersion() const;
 
     QString displayName(const FileEntry& ent) const;
     QString displaySize(const FileEntry& ent) const;
     QString getFilter() const;
+
+private:
+    void readEntries(hsStream* S, bool loadData);
+    void copyEntry(const FileEntry& ent, hsStream* S) const;
 };
 
 class QPlasmaPakFile : public QPlasmaDocument
@@ -118,6 +169,8 @@ public:
     void setPackageType(PlasmaPackage::PackageType type)
     {
         fPackage.fType = type;
+        fActions[kCompileDir]->setVisible(type == PlasmaPackage::kPythonPak);
+        fActions[kViewSource]->setVisible(type == PlasmaPackage::kPythonPak);
     }
     PlasmaPackage::PackageType packageType() const { return fPackage.fType; }
     
@@ -131,26 +184,45 @@ public:
      */
     static bool decompylePyc(QWidget *parent, QString filename, OverwritingConfirmation *confirmation = NULL);
 
+    /**
+     * Decompile a pyc file without any user interaction.  This is safe to
+     * call from worker threads.
+     * @param filename the file to decompyle
+     * @param output the file to write the source to
+     * @param error if not NULL, receives a description of any failure
+     * @param cancel if not NULL, the decompiler is stopped once this is set
+     * @return whether the file was successfully decompiled
+     */
+    static bool decompyleToFile(const QString& filename, const QString& output, QString* error = NULL,
+                                const QAtomicInt* cancel = NULL);
+
 private:
     QTreeWidget* fFileList;
     PlasmaPackage fPackage;
 
     enum
     {
-        kAdd, kDel, kExtract, kExtractAll, kANumActions
+        kAdd, kCompileDir, kDel, kExtract, kExtractAll, kViewSource, kANumActions
     };
     QAction* fActions[kANumActions];
 
+    // Takes ownership of S; pass NULL to just refresh the file list
     bool loadPakData(hsStream* S);
     bool savePakData(hsStream* S);
+    bool writePackage(const QString& tempName, const QString& filename);
+    bool openSource(const QString& filename);
+    void addSources(const QStringList& sources);
     void extract(const PlasmaPackage::FileEntry &entry, QString dir, OverwritingConfirmation *confirmation);
+    QString extractPath(const PlasmaPackage::FileEntry &entry, const QString& dir) const;
 
 private slots:
     void onContextMenu(QPoint pos);
     void onAdd();
+    void onCompileDir();
     void onDel();
     void onExtract();
     void onExtractAll();
+    void onViewSource();
 };
 
 #endif
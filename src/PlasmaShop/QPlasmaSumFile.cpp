@@ -17,6 +17,7 @@
 #include "QPlasmaSumFile.h"
 #include <Debug/plDebug.h>
 #include <Stream/plEncryptedStream.h>
+#include <Stream/hsRAMStream.h>
 #include <QDateTime>
 #include <QGridLayout>
 #include <QMessageBox>
@@ -24,15 +25,136 @@
 #include <QToolBar>
 #include <QFileDialog>
 #include <QSettings>
-#include <QCryptographicHash>
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QSaveFile>
+#include <algorithm>
 #include "QPlasma.h"
+#include "FileHash.h"
 
-void QPlasmaSumFile::addToSumFile(const QString& filename)
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
+#define HASHCACHE_MAGIC     (0x484D5553)    // "SUMH"
+#define HASHCACHE_VERSION   (1)
+
+struct HashJob
+{
+    QString fFilename;
+    ST::string fSumPath;
+    uint32_t fTimestamp;
+    qint64 fSize, fModified;
+    quint64 fInode;
+    QByteArray fHash;
+    QString fError;
+};
+
+// MD5 of a file as of the given size, mtime and inode.  If any of those
+// have changed since, the file is hashed again.
+struct CachedHash
+{
+    qint64 fSize, fModified;
+    quint64 fInode;
+    QByteArray fHash;
+};
+
+static QDataStream& operator<<(QDataStream& out, const CachedHash& entry)
 {
-    QFileInfo finfo(filename);
+    return out << entry.fSize << entry.fModified << entry.fInode << entry.fHash;
+}
+
+static QDataStream& operator>>(QDataStream& in, CachedHash& entry)
+{
+    return in >> entry.fSize >> entry.fModified >> entry.fInode >> entry.fHash;
+}
+
+static QString hashCacheFilename()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + "/PlasmaShop/sumhashes.dat";
+}
 
+static QHash<QString, CachedHash> loadHashCache()
+{
+    QHash<QString, CachedHash> cache;
+    QFile file(hashCacheFilename());
+    if (!file.open(QIODevice::ReadOnly))
+        return cache;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version;
+    in >> magic >> version;
+    if (magic != HASHCACHE_MAGIC || version != HASHCACHE_VERSION)
+        return cache;
+
+    in >> cache;
+    if (in.status() != QDataStream::Ok)
+        cache.clear();
+    return cache;
+}
+
+static void saveHashCache(QHash<QString, CachedHash>& cache)
+{
+    // Drop files that have since been removed, so the cache doesn't
+    // grow without bound
+    for (auto it = cache.begin(); it != cache.end(); ) {
+        if (QFileInfo::exists(it.key()))
+            ++it;
+        else
+            it = cache.erase(it);
+    }
+
+    QString filename = hashCacheFilename();
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << (quint32)HASHCACHE_MAGIC << (quint32)HASHCACHE_VERSION << cache;
+    file.commit();
+}
+
+static quint64 fileInode(const QString& filename)
+{
+#ifdef Q_OS_WIN
+    // Not exposed cheaply on Windows; size and mtime are used alone
+    Q_UNUSED(filename);
+    return 0;
+#else
+    struct stat st;
+    if (stat(QFile::encodeName(filename).constData(), &st) != 0)
+        return 0;
+    return (quint64)st.st_ino;
+#endif
+}
+
+// Finds the entry for path (manifest paths are case-insensitive), or adds
+// one.  New entries go through updateFile() so hsSumFile sets them up; it is
+// given an empty stream because the real hash is already known.
+static hsSumFile::FileInfo& sumEntry(hsSumFile& sumData, const ST::string& path)
+{
+    auto file = std::find_if(sumData.getFiles().begin(), sumData.getFiles().end(),
+                             [&path](const hsSumFile::FileInfo& info) {
+        return info.fPath.compare_i(path) == 0;
+    });
+    if (file != sumData.getFiles().end())
+        return *file;
+
+    hsRAMStream empty;
+    sumData.updateFile(path, &empty, 0);
+    return sumData.getFiles().back();
+}
+
+static ST::string sumPathFor(const QFileInfo& finfo)
+{
     ST::string sumPath;
-    uint32_t timestamp = finfo.lastModified().toTime_t();
 
     // Construct a default path based on the file extension
     if (finfo.suffix() == "prp" || finfo.suffix() == "fni" || finfo.suffix() == "age" ||
@@ -48,11 +170,90 @@ void QPlasmaSumFile::addToSumFile(const QString& filename)
         sumPath = ST::format("SDL\\{}", finfo.fileName());
     else
         sumPath = qstr2st(finfo.fileName());
+    return sumPath;
+}
+
+bool QPlasmaSumFile::addToSumFile(const QStringList& filenames)
+{
+    // Files that haven't changed since they were last hashed are taken
+    // from the cache and not read again
+    QHash<QString, CachedHash> cache = loadHashCache();
+
+    QVector<HashJob> jobs;
+    jobs.reserve(filenames.size());
+    for (const QString& filename : filenames) {
+        QFileInfo finfo(filename);
+        HashJob job;
+        job.fFilename = finfo.absoluteFilePath();
+        job.fSumPath = sumPathFor(finfo);
+        job.fTimestamp = finfo.lastModified().toTime_t();
+        job.fSize = finfo.size();
+        job.fModified = finfo.lastModified().toMSecsSinceEpoch();
+        job.fInode = fileInode(job.fFilename);
+
+        auto cached = cache.constFind(job.fFilename);
+        if (cached != cache.constEnd() && cached->fSize == job.fSize
+                && cached->fModified == job.fModified && cached->fInode == job.fInode)
+            job.fHash = cached->fHash;
+        jobs.append(job);
+    }
+
+    // Calculate updated MD5 hashes on the worker pool
+    QAtomicInt cancel;
+    QProgressDialog progress(tr("Hashing files..."), tr("Cancel"), 0, jobs.size(), this);
+    progress.setWindowModality(Qt::WindowModal);
+    QFutureWatcher<void> watcher;
+    connect(&watcher, &QFutureWatcher<void>::progressValueChanged,
+            &progress, &QProgressDialog::setValue);
+    connect(&watcher, &QFutureWatcher<void>::finished, &progress, &QProgressDialog::reset);
+    connect(&progress, &QProgressDialog::canceled, &watcher, [&watcher, &cancel] {
+        cancel.storeRelease(1);
+        watcher.cancel();
+    });
+    watcher.setFuture(QtConcurrent::map(jobs, [&cancel](HashJob& job) {
+        if (job.fHash.isEmpty())
+            job.fHash = pqHashFile(job.fFilename, &job.fError, &cancel);
+    }));
+    progress.exec();
+    watcher.waitForFinished();
+
+    // Keep whatever was hashed, even if the update itself was cancelled
+    for (const HashJob& job : jobs) {
+        if (!job.fHash.isEmpty()) {
+            CachedHash entry;
+            entry.fSize = job.fSize;
+            entry.fModified = job.fModified;
+            entry.fInode = job.fInode;
+            entry.fHash = job.fHash;
+            cache[job.fFilename] = entry;
+        }
+    }
+    saveHashCache(cache);
+
+    if (cancel.loadAcquire())
+        return false;
 
-    // Calculate updated MD5 hash
-    hsFileStream FS;
-    FS.open(qstr2st(filename), fmRead);
-    fSumData.updateFile(sumPath, &FS, timestamp);
+    // Apply everything at once, so a cancelled update leaves the manifest
+    // untouched
+    QStringList errors;
+    for (const HashJob& job : jobs) {
+        if (job.fHash.isEmpty()) {
+            errors << job.fError;
+            continue;
+        }
+
+        hsSumFile::FileInfo& file = sumEntry(fSumData, job.fSumPath);
+        file.fHash.fromHex(job.fHash.toHex().constData());
+        file.fTimestamp = job.fTimestamp;
+    }
+    if (!errors.isEmpty()) {
+        QMessageBox msgBox(QMessageBox::Warning, tr("Update manifest"),
+                           tr("%1 file(s) could not be hashed").arg(errors.size()),
+                           QMessageBox::Ok, this);
+        msgBox.setDetailedText(errors.join('\n'));
+        msgBox.exec();
+    }
+    return true;
 }
 
 
@@ -293,18 +494,19 @@ void QPlasmaSumFile::onUpdate()
     QString dir = QFileDialog::getExistingDirectory(this, tr("Select Game directory"),
                                                     gameRoot);
     if (!dir.isEmpty()) {
-        // Need a copy since addToSumFile() can invalidate iterators
-        const std::vector<hsSumFile::FileInfo> curFiles = fSumData.getFiles();
-        for (const hsSumFile::FileInfo& file : curFiles) {
+        QStringList paths;
+        for (const hsSumFile::FileInfo& file : fSumData.getFiles()) {
             QString path = st2qstr(file.fPath);
             path.replace('\\', QDir::separator()).replace('/', QDir::separator());
             path = dir + QDir::separator() + QFileInfo(path).fileName();
             if (QFileInfo(path).exists())
-                addToSumFile(path);
+                paths << path;
         }
 
-        loadSumData(nullptr);
-        makeDirty();
+        if (addToSumFile(paths)) {
+            loadSumData(nullptr);
+            makeDirty();
+        }
     }
 }
 
@@ -321,10 +523,7 @@ void QPlasmaSumFile::onAdd()
     }
     QStringList files = QFileDialog::getOpenFileNames(this, tr("Add / update files"),
                                                       gameRoot, QString("All Files (*)"));
-    for (const QString& f : files)
-        addToSumFile(f);
-
-    if (files.size() != 0) {
+    if (files.size() != 0 && addToSumFile(files)) {
         loadSumData(nullptr);
         makeDirty();
     }
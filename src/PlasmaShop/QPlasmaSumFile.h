@@ -46,7 +46,9 @@ private:
 
     bool loadSumData(hsStream* S);
     bool saveSumData(hsStream* S);
-    void addToSumFile(const QString& filename);
+    // Hashes the files on the worker pool and adds or updates their
+    // entries.  Returns false if the user cancelled.
+    bool addToSumFile(const QStringList& filenames);
 
 private slots:
     void onContextMenu(QPoint pos);
@@ -481,6 +481,21 @@ bool QPlasmaTextDoc::loadFile(const QString& filename)
     return QPlasmaDocument::loadFile(filename);
 }
 
+void QPlasmaTextDoc::setText(const QString& text)
+{
+    fEditor->setPlainText(text);
+    fEditor->document()->clearUndoRedoStacks();
+}
+
+void QPlasmaTextDoc::gotoLine(int line)
+{
+    QTextBlock block = fEditor->document()->findBlockByNumber(line - 1);
+    if (!block.isValid())
+        return;
+    fEditor->setTextCursor(QTextCursor(block));
+    fEditor->centerCursor();
+}
+
 static QString unixToWindowsText(QString &&text)
 {
     return text.replace("\n", "\r\n").replace("\r\r\n", "\r\n");
@@ -58,6 +58,10 @@ public:
     void setSyntax(SyntaxMode syn);
     void setEncoding(EncodingMode type);
 
+    // Replace the document's contents with text that did not come from a file
+    void setText(const QString& text);
+    void gotoLine(int line);
+
     SyntaxMode syntax() const { return fSyntax; }
     EncodingMode encoding() const { return fEncoding; }
 
@@ -22,6 +22,7 @@
 #include <QVBoxLayout>
 #include <QGridLayout>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QProgressDialog>
 #include <QDialogButtonBox>
@@ -32,6 +33,7 @@
 #include <QMimeData>
 #include <QStandardPaths>
 #include <Debug/plDebug.h>
+#include <Stream/hsRAMStream.h>
 #include <ResManager/plFactory.h>
 #include <PRP/Surface/plMipmap.h>
 
@@ -42,6 +44,11 @@
 #include "PRP/QCreatable.h"
 #include "QPrcEditor.h"
 #include "QHexViewer.h"
+#include "QHexDiffViewer.h"
+#include "QPrcPage.h"
+#include "QTextureAudit.h"
+#include "QTextureDedup.h"
+#include "QTextureCache.h"
 
 PrpShopMain* PrpShopMain::sInstance = NULL;
 PrpShopMain* PrpShopMain::Instance() { return sInstance; }
@@ -68,6 +75,9 @@ PrpShopMain::PrpShopMain()
     fActions[kToolsProperties] = new QAction(tr("Show &Properties Pane"), this);
     fActions[kToolsShowTypeIDs] = new QAction(tr("Show Type &IDs"), this);
     fActions[kToolsNewObject] = new QAction(tr("&New Object..."), this);
+    fActions[kToolsTextureAudit] = new QAction(tr("&Texture Audit..."), this);
+    fActions[kToolsTextureDedup] = new QAction(tr("Find &Duplicate Textures..."), this);
+    fActions[kToolsCompareFiles] = new QAction(tr("&Compare Files..."), this);
     fActions[kWindowPrev] = new QAction(tr("&Previous"), this);
     fActions[kWindowNext] = new QAction(tr("&Next"), this);
     fActions[kWindowTile] = new QAction(tr("&Tile"), this);
@@ -79,11 +89,15 @@ PrpShopMain::PrpShopMain()
     fActions[kTreeEdit] = new QAction(tr("&Edit"), this);
     fActions[kTreeEditPRC] = new QAction(tr("Edit P&RC"), this);
     fActions[kTreeEditHex] = new QAction(tr("View He&x"), this);
+    fActions[kTreeDiffSaved] = new QAction(tr("Compare with &Saved Copy"), this);
+    fActions[kTreeDiffPage] = new QAction(tr("Compare with &Other Page..."), this);
     fActions[kTreeViewTargets] = new QAction(tr("Show &Targets"), this);
     fActions[kTreePreview] = new QAction(tr("&Preview"), this);
     fActions[kTreeDelete] = new QAction(tr("&Delete"), this);
     fActions[kTreeImport] = new QAction(tr("&Import..."), this);
     fActions[kTreeExport] = new QAction(tr("E&xport..."), this);
+    fActions[kTreeImportPRC] = new QAction(tr("Import Page P&RC..."), this);
+    fActions[kTreeExportPRC] = new QAction(tr("Export Page as PR&C..."), this);
 
     fActions[kFileOpen]->setShortcut(Qt::CTRL + Qt::Key_O);
     fActions[kFileSave]->setShortcut(Qt::CTRL + Qt::Key_S);
@@ -111,6 +125,9 @@ PrpShopMain::PrpShopMain()
     viewMenu->addAction(fActions[kToolsShowTypeIDs]);
     viewMenu->addSeparator();
     viewMenu->addAction(fActions[kToolsNewObject]);
+    viewMenu->addAction(fActions[kToolsTextureAudit]);
+    viewMenu->addAction(fActions[kToolsTextureDedup]);
+    viewMenu->addAction(fActions[kToolsCompareFiles]);
 
     QMenu* wndMenu = menuBar()->addMenu(tr("&Window"));
     wndMenu->addAction(fActions[kWindowPrev]);
@@ -180,6 +197,12 @@ PrpShopMain::PrpShopMain()
             this, &PrpShopMain::showTypeIDs);
     connect(fActions[kToolsNewObject], &QAction::triggered,
             this, &PrpShopMain::createNewObject);
+    connect(fActions[kToolsTextureAudit], &QAction::triggered,
+            this, &PrpShopMain::textureAudit);
+    connect(fActions[kToolsTextureDedup], &QAction::triggered,
+            this, &PrpShopMain::textureDedup);
+    connect(fActions[kToolsCompareFiles], &QAction::triggered,
+            this, &PrpShopMain::compareFiles);
 
     connect(fActions[kWindowPrev], &QAction::triggered,
             fMdiArea, &QMdiArea::activatePreviousSubWindow);
@@ -198,11 +221,15 @@ PrpShopMain::PrpShopMain()
     connect(fActions[kTreeEdit], &QAction::triggered, this, &PrpShopMain::treeEdit);
     connect(fActions[kTreeEditPRC], &QAction::triggered, this, &PrpShopMain::treeEditPRC);
     connect(fActions[kTreeEditHex], &QAction::triggered, this, &PrpShopMain::treeEditHex);
+    connect(fActions[kTreeDiffSaved], &QAction::triggered, this, &PrpShopMain::treeDiffSaved);
+    connect(fActions[kTreeDiffPage], &QAction::triggered, this, &PrpShopMain::treeDiffPage);
     connect(fActions[kTreeViewTargets], &QAction::triggered, this, &PrpShopMain::treeShowTargets);
     connect(fActions[kTreePreview], &QAction::triggered, this, &PrpShopMain::treePreview);
     connect(fActions[kTreeDelete], &QAction::triggered, this, &PrpShopMain::treeDelete);
     connect(fActions[kTreeImport], &QAction::triggered, this, &PrpShopMain::treeImport);
     connect(fActions[kTreeExport], &QAction::triggered, this, &PrpShopMain::treeExport);
+    connect(fActions[kTreeImportPRC], &QAction::triggered, this, &PrpShopMain::treeImportPRC);
+    connect(fActions[kTreeExportPRC], &QAction::triggered, this, &PrpShopMain::treeExportPRC);
 
     connect(fBrowserTree, &QTreeWidget::currentItemChanged,
             this, &PrpShopMain::treeItemChanged);
@@ -431,10 +458,16 @@ void PrpShopMain::treeContextMenu(const QPoint& pos)
     } else if (item->type() == QPlasmaTreeItem::kTypePage) {
         menu.addAction(fActions[kTreeClose]);
         menu.addAction(fActions[kTreeImport]);
+        menu.addSeparator();
+        menu.addAction(fActions[kTreeImportPRC]);
+        menu.addAction(fActions[kTreeExportPRC]);
     } else if (item->type() == QPlasmaTreeItem::kTypeKO) {
         menu.addAction(fActions[kTreeEdit]);
         menu.addAction(fActions[kTreeEditPRC]);
         menu.addAction(fActions[kTreeEditHex]);
+        QMenu* diffMenu = menu.addMenu(tr("Compare He&x"));
+        diffMenu->addAction(fActions[kTreeDiffSaved]);
+        diffMenu->addAction(fActions[kTreeDiffPage]);
         menu.addAction(fActions[kTreePreview]);
         menu.addAction(fActions[kTreeViewTargets]);
         menu.addSeparator();
@@ -464,6 +497,7 @@ void PrpShopMain::treeClose()
             if (st2qstr((*it)->page()->getAge()) == item->age()) {
                 const plLocation& loc = (*it)->page()->getLocation();
                 closeWindows(loc);
+                QTextureCache::clear();
                 fResMgr.UnloadPage(loc);
                 it = fLoadedLocations.erase(it);
             } else {
@@ -478,6 +512,7 @@ void PrpShopMain::treeClose()
         delete item;
         QHash<plLocation, QPlasmaTreeItem*>::Iterator it = fLoadedLocations.find(loc);
         fLoadedLocations.erase(it);
+        QTextureCache::clear();
         fResMgr.UnloadPage(loc);
         if (age->childCount() == 0)
             delete age;
@@ -517,6 +552,102 @@ void PrpShopMain::treeEditHex()
     }
 }
 
+void PrpShopMain::treeDiffSaved()
+{
+    QPlasmaTreeItem* item = (QPlasmaTreeItem*)fBrowserTree->currentItem();
+    if (item == NULL || item->obj() == NULL)
+        return;
+
+    // Left is what's in the file, right is what would be written now
+    QPlasmaTreeItem* parent = (QPlasmaTreeItem*)item->parent()->parent();
+    plKey key = item->obj()->getKey();
+    QSharedPointer<QHexFileSource> saved(new QHexFileSource(parent->filename(),
+                                         key->getFileOff(), key->getObjSize()));
+    if (!saved->isOpen()) {
+        QMessageBox::critical(this, tr("Error"),
+                tr("Error: Could not open file %1 for reading").arg(parent->filename()),
+                QMessageBox::Ok);
+        return;
+    }
+
+    QByteArray current;
+    try {
+        hsRAMStream S;
+        S.setVer(fResMgr.getVer());
+        fResMgr.WriteCreatable(&S, item->obj());
+        current.resize(S.size());
+        S.rewind();
+        S.read(current.size(), current.data());
+    } catch (std::exception& ex) {
+        QMessageBox::critical(this, tr("Error"),
+                tr("Error writing %1:\n%2").arg(st2qstr(key->getName())).arg(ex.what()),
+                QMessageBox::Ok);
+        return;
+    }
+
+    QHexDiffViewer* diff = new QHexDiffViewer(saved, tr("%1 (saved)").arg(st2qstr(key->getName())),
+            QSharedPointer<QHexDataSource>(new QHexByteArraySource(current)),
+            tr("%1 (current)").arg(st2qstr(key->getName())), this);
+    diff->show();
+}
+
+void PrpShopMain::treeDiffPage()
+{
+    QPlasmaTreeItem* item = (QPlasmaTreeItem*)fBrowserTree->currentItem();
+    if (item == NULL || item->obj() == NULL)
+        return;
+
+    QString filename = QFileDialog::getOpenFileName(this,
+                            tr("Compare with Page"), fDialogDir,
+                            "Page Files (*.prp)");
+    if (filename.isEmpty())
+        return;
+
+    QPlasmaTreeItem* parent = (QPlasmaTreeItem*)item->parent()->parent();
+    plKey key = item->obj()->getKey();
+    uint32_t otherOffset = 0, otherSize = 0;
+    try {
+        // Only the key index of the other page is needed, and it
+        // mustn't be mixed up with the pages we have loaded
+        plResManager otherMgr;
+        plPageInfo* otherPage = otherMgr.ReadPage(qstr2st(filename), true);
+        plKey otherKey;
+        for (const plKey& k : otherMgr.getKeys(otherPage->getLocation(), key->getType())) {
+            if (k->getName() == key->getName()) {
+                otherKey = k;
+                break;
+            }
+        }
+        if (!otherKey.Exists()) {
+            QMessageBox::critical(this, tr("Error"),
+                    tr("%1 has no %2 named %3").arg(filename)
+                      .arg(pqGetFriendlyClassName(key->getType()))
+                      .arg(st2qstr(key->getName())),
+                    QMessageBox::Ok);
+            return;
+        }
+        otherOffset = otherKey->getFileOff();
+        otherSize = otherKey->getObjSize();
+    } catch (std::exception& ex) {
+        QMessageBox::critical(this, tr("Error"),
+                tr("Error Loading File %1:\n%2").arg(filename).arg(ex.what()),
+                QMessageBox::Ok);
+        return;
+    }
+
+    QDir dir = QDir(filename);
+    dir.cdUp();
+    fDialogDir = dir.absolutePath();
+
+    QHexDiffViewer* diff = new QHexDiffViewer(
+            QSharedPointer<QHexDataSource>(new QHexFileSource(parent->filename(),
+                    key->getFileOff(), key->getObjSize())),
+            parent->filename(),
+            QSharedPointer<QHexDataSource>(new QHexFileSource(filename, otherOffset, otherSize)),
+            filename, this);
+    diff->show();
+}
+
 void PrpShopMain::treePreview()
 {
     QPlasmaTreeItem* item = (QPlasmaTreeItem*)fBrowserTree->currentItem();
@@ -537,6 +668,7 @@ void PrpShopMain::treeDelete()
     QPlasmaTreeItem* item = (QPlasmaTreeItem*)fBrowserTree->currentItem();
     if (item == NULL || item->obj() == NULL)
         return;
+    QTextureCache::invalidateObject(item->obj());
     fResMgr.DelObject(item->obj()->getKey());
     QPlasmaTreeItem* folder = (QPlasmaTreeItem*)item->parent();
     delete item;
@@ -595,6 +727,20 @@ void PrpShopMain::closeWindows(const plLocation& loc)
     }
 }
 
+void PrpShopMain::closeWindows(plCreatable* pCre, QWidget* except)
+{
+    // Used when pCre is about to be deleted, so nothing gets a chance to
+    // save damage back into it
+    QList<QMdiSubWindow*> windows = fMdiArea->subWindowList();
+    for (auto it = windows.begin(); it != windows.end(); it++) {
+        QCreatable* creWin = qobject_cast<QCreatable*>((*it)->widget());
+        if (creWin && creWin != except && creWin->compareObject(pCre)) {
+            fMdiArea->removeSubWindow(*it);
+            delete *it;
+        }
+    }
+}
+
 void PrpShopMain::treeImport()
 {
     QPlasmaTreeItem* pageItem = findCurrentPageItem();
@@ -666,6 +812,84 @@ void PrpShopMain::treeExport()
     }
 }
 
+void PrpShopMain::treeImportPRC()
+{
+    QPlasmaTreeItem* item = (QPlasmaTreeItem*)fBrowserTree->currentItem();
+    if (item == NULL || item->type() != QPlasmaTreeItem::kTypePage)
+        return;
+
+    QString filename = QFileDialog::getOpenFileName(this,
+                            tr("Import Page PRC"), fDialogDir,
+                            "PRC Documents (*.prc)");
+    if (filename.isEmpty())
+        return;
+    fDialogDir = QFileInfo(filename).absolutePath();
+
+    // Open editors would hold on to the old state of the objects
+    closeWindows(item->page()->getLocation());
+
+    QProgressDialog progress(tr("Compiling %1...").arg(QFileInfo(filename).fileName()),
+                             tr("Cancel"), 0, 0, this);
+    progress.setWindowModality(Qt::WindowModal);
+    QStringList errors;
+    try {
+        errors = pqImportPagePrc(&fResMgr, item->page(), filename,
+                                 [&progress](size_t done, size_t total) {
+            progress.setMaximum(total);
+            progress.setValue(done);
+            return !progress.wasCanceled();
+        });
+    } catch (std::exception& ex) {
+        progress.close();
+        QMessageBox::critical(this, tr("Error"),
+                tr("Error Importing File %1:\n%2").arg(filename).arg(ex.what()),
+                QMessageBox::Ok);
+        return;
+    }
+    progress.close();
+
+    if (!errors.isEmpty()) {
+        QMessageBox msgBox(QMessageBox::Warning, tr("Import Page PRC"),
+                           tr("%1 object(s) could not be compiled").arg(errors.size()),
+                           QMessageBox::Ok, this);
+        msgBox.setDetailedText(errors.join('\n'));
+        msgBox.exec();
+    }
+}
+
+void PrpShopMain::treeExportPRC()
+{
+    QPlasmaTreeItem* item = (QPlasmaTreeItem*)fBrowserTree->currentItem();
+    if (item == NULL || item->type() != QPlasmaTreeItem::kTypePage)
+        return;
+
+    QString fnfix = st2qstr(item->page()->getPage()).replace(QRegExp("[?:/\\*\"<>|]"), "_");
+    QString filename = QFileDialog::getSaveFileName(this,
+                            tr("Export Page as PRC"),
+                            tr("%1/%2.prc").arg(fDialogDir).arg(fnfix),
+                            "PRC Documents (*.prc)");
+    if (filename.isEmpty())
+        return;
+    fDialogDir = QFileInfo(filename).absolutePath();
+
+    QProgressDialog progress(tr("Writing %1...").arg(QFileInfo(filename).fileName()),
+                             tr("Cancel"), 0, 0, this);
+    progress.setWindowModality(Qt::WindowModal);
+    try {
+        pqExportPagePrc(&fResMgr, item->page(), filename,
+                        [&progress](size_t done, size_t total) {
+            progress.setMaximum(total);
+            progress.setValue(done);
+            return !progress.wasCanceled();
+        });
+    } catch (std::exception& ex) {
+        progress.close();
+        QMessageBox::critical(this, tr("Error"),
+                tr("Error Exporting File %1:\n%2").arg(filename).arg(ex.what()),
+                QMessageBox::Ok);
+    }
+}
+
 QCreatable* PrpShopMain::editCreatable(plCreatable* pCre, int forceType)
 {
     if (pCre == Q_NULLPTR) {
@@ -788,6 +1012,7 @@ void PrpShopMain::loadFile(QString filename)
 
     PageUnloadCallback prevCallback = fResMgr.SetPageUnloadFunc([this, &prevCallback](const plLocation& loc) {
         closeWindows(loc);
+        QTextureCache::clear();
         if (prevCallback != NULL)
             prevCallback(loc);
     });
@@ -1155,6 +1380,61 @@ void PrpShopMain::createNewObject()
     }
 }
 
+void PrpShopMain::textureAudit()
+{
+    if (fResMgr.getLocations().size() < 1) {
+        QMessageBox msgBox(QMessageBox::Critical, tr("Error"),
+                           tr("You must have at least one page loaded to audit textures"),
+                           QMessageBox::Ok, this);
+        msgBox.exec();
+        return;
+    }
+
+    QTextureAudit dlg(&fResMgr, this);
+    dlg.exec();
+}
+
+void PrpShopMain::compareFiles()
+{
+    QString left = QFileDialog::getOpenFileName(this, tr("Compare Files: Original"),
+                                                fDialogDir, "All Files (*)");
+    if (left.isEmpty())
+        return;
+    QString right = QFileDialog::getOpenFileName(this, tr("Compare Files: Modified"),
+                                                 QFileInfo(left).absolutePath(),
+                                                 "All Files (*)");
+    if (right.isEmpty())
+        return;
+
+    QSharedPointer<QHexFileSource> leftData(new QHexFileSource(left));
+    QSharedPointer<QHexFileSource> rightData(new QHexFileSource(right));
+    if (!leftData->isOpen() || !rightData->isOpen()) {
+        QMessageBox::critical(this, tr("Error"),
+                tr("Error: Could not open file %1 for reading")
+                  .arg(leftData->isOpen() ? right : left),
+                QMessageBox::Ok);
+        return;
+    }
+    fDialogDir = QFileInfo(right).absolutePath();
+
+    QHexDiffViewer* diff = new QHexDiffViewer(leftData, left, rightData, right, this);
+    diff->show();
+}
+
+void PrpShopMain::textureDedup()
+{
+    if (fResMgr.getLocations().size() < 1) {
+        QMessageBox msgBox(QMessageBox::Critical, tr("Error"),
+                           tr("You must have at least one page loaded to find duplicate textures"),
+                           QMessageBox::Ok, this);
+        msgBox.exec();
+        return;
+    }
+
+    QTextureDedup dlg(&fResMgr, this);
+    dlg.exec();
+}
+
 void PrpShopMain::showTypeIDs(bool show)
 {
     s_showTypeIDs = show;
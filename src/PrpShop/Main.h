@@ -73,12 +73,14 @@ private:
     {
         // Main Menu
         kFileNewPage, kFileOpen, kFileSave, kFileSaveAs, kFileExit,
-        kToolsProperties, kToolsShowTypeIDs, kToolsNewObject, kWindowPrev,
+        kToolsProperties, kToolsShowTypeIDs, kToolsNewObject,
+        kToolsTextureAudit, kToolsTextureDedup, kToolsCompareFiles, kWindowPrev,
         kWindowNext, kWindowTile, kWindowCascade, kWindowClose, kWindowCloseAll,
 
         // Tree Context Menu
-        kTreeClose, kTreeEdit, kTreeEditPRC, kTreeEditHex, kTreePreview,
-        kTreeViewTargets, kTreeDelete, kTreeImport, kTreeExport,
+        kTreeClose, kTreeEdit, kTreeEditPRC, kTreeEditHex, kTreeDiffSaved,
+        kTreeDiffPage, kTreePreview, kTreeViewTargets, kTreeDelete, kTreeImport, kTreeExport,
+        kTreeImportPRC, kTreeExportPRC,
 
         kNumActions
     };
@@ -119,18 +121,26 @@ public slots:
     void treeItemActivated(QTreeWidgetItem* item, int column);
     void treeContextMenu(const QPoint& pos);
     void createNewObject();
+    void textureAudit();
+    void textureDedup();
+    void compareFiles();
     void showTypeIDs(bool show);
     void closeWindows(const plLocation& loc);
+    void closeWindows(plCreatable* pCre, QWidget* except = NULL);
 
     void treeClose();
     void treeEdit();
     void treeEditPRC();
     void treeEditHex();
+    void treeDiffSaved();
+    void treeDiffPage();
     void treePreview();
     void treeShowTargets();
     void treeDelete();
     void treeImport();
     void treeExport();
+    void treeImportPRC();
+    void treeExportPRC();
 };
 
 #endif
@@ -285,6 +285,8 @@ QCreatable* pqMakeCreatableForm(plCreatable* pCre, QWidget* parent, int forceTyp
     // Preview meta-types
     case kPreviewMipmap:
         return new QMipmap_Preview(pCre, parent);
+    case kPreviewCubicEnvironmap:
+        return new QCubicEnvironmap_Preview(pCre, parent);
     case kPreviewSceneObject:
         return new QSceneObj_Preview(pCre, parent);
 
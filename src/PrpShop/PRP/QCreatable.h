@@ -33,6 +33,7 @@ public:
     QCreatable(plCreatable* pCre, int type, QWidget* parent = NULL);
     bool isMatch(plCreatable* pCre, int type);
     bool compareLocation(const plLocation& loc);
+    bool compareObject(plCreatable* pCre) const { return fCreatable == pCre; }
     virtual void saveDamage() { }
 
 protected:
@@ -29,8 +29,10 @@
 #include <QGLFormat>
 #include <QMessageBox>
 #include <QMouseEvent>
+#include <QtConcurrent>
 #include <cmath>
 #include "QPlasmaUtils.h"
+#include "QTextureCache.h"
 
 PFNGLCOMPRESSEDTEXIMAGE2DARBPROC glCompressedTexImage2DARB = NULL;
 
@@ -398,23 +400,19 @@ bool QPlasmaRender::buildMipmap(plMipmap* map, GLuint id, GLuint target)
             return false;
         }
     } else if (map->getCompressionType() == plBitmap::kJPEGCompression) {
-        size_t imgsize = map->getTotalSize();
-        unsigned char* imgbuf = new unsigned char[imgsize];
-        try {
-            map->DecompressImage(0, imgbuf, imgsize);
-            glTexImage2D(target, 0, GL_RGBA, map->getLevelWidth(0),
-                         map->getLevelHeight(0), 0, GL_RGBA,
-                         GL_UNSIGNED_BYTE, imgbuf);
-        } catch (hsException& e) {
+        QImage img = QTextureCache::decode(map, 0);
+        if (img.isNull()) {
             QMessageBox msgBox(QMessageBox::Critical, tr("Error"),
-                               tr("Error decompressing %1: %2")
-                               .arg(st2qstr(map->getKey()->getName())).arg(e.what()),
+                               tr("Error decompressing %1")
+                               .arg(map->getKey().Exists() ? st2qstr(map->getKey()->getName())
+                                                           : tr("cube map face")),
                                QMessageBox::Ok, this);
             msgBox.exec();
-            delete[] imgbuf;
             return false;
         }
-        delete[] imgbuf;
+        // The cached image is ARGB32, which is BGRA in memory
+        glTexImage2D(target, 0, GL_RGBA, img.width(), img.height(), 0, GL_BGRA,
+                     GL_UNSIGNED_BYTE, img.constBits());
     } else {
         for (size_t i=0; i<map->getNumLevels(); i++) {
             glTexImage2D(target, i, GL_RGBA, map->getLevelWidth(i),
@@ -458,18 +456,27 @@ void QPlasmaRender::compileTexture(plKey lay, size_t id)
         glDisable(GL_TEXTURE_2D);
         glEnable(GL_TEXTURE_CUBE_MAP);
         fLayers[lay].fTexTarget = GL_TEXTURE_CUBE_MAP;
-        if (!buildMipmap(envMap->getFace(0), fTexList[id], GL_TEXTURE_CUBE_MAP_POSITIVE_X))
-            fLayers[lay].fTexNameId = 0;
-        if (!buildMipmap(envMap->getFace(1), fTexList[id], GL_TEXTURE_CUBE_MAP_NEGATIVE_X))
-            fLayers[lay].fTexNameId = 0;
-        if (!buildMipmap(envMap->getFace(2), fTexList[id], GL_TEXTURE_CUBE_MAP_POSITIVE_Y))
-            fLayers[lay].fTexNameId = 0;
-        if (!buildMipmap(envMap->getFace(3), fTexList[id], GL_TEXTURE_CUBE_MAP_NEGATIVE_Y))
-            fLayers[lay].fTexNameId = 0;
-        if (!buildMipmap(envMap->getFace(4), fTexList[id], GL_TEXTURE_CUBE_MAP_POSITIVE_Z))
-            fLayers[lay].fTexNameId = 0;
-        if (!buildMipmap(envMap->getFace(5), fTexList[id], GL_TEXTURE_CUBE_MAP_NEGATIVE_Z))
-            fLayers[lay].fTexNameId = 0;
+
+        // Only the uploads need the GL context, so decode any JPEG faces
+        // into the texture cache in parallel first
+        QVector<plMipmap*> faces;
+        for (size_t i=0; i<plCubicEnvironmap::kNumFaces; i++) {
+            if (envMap->getFace(i)->getCompressionType() == plBitmap::kJPEGCompression)
+                faces << envMap->getFace(i);
+        }
+        QtConcurrent::blockingMap(faces, [](plMipmap* face) {
+            QTextureCache::decode(face, 0);
+        });
+
+        static const GLuint faceTargets[] = {
+            GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
+            GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
+            GL_TEXTURE_CUBE_MAP_POSITIVE_Z, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
+        };
+        for (size_t i=0; i<plCubicEnvironmap::kNumFaces; i++) {
+            if (!buildMipmap(envMap->getFace(i), fTexList[id], faceTargets[i]))
+                fLayers[lay].fTexNameId = 0;
+        }
     } else if (layTex.Exists()) {
         plDebug::Debug("Got unrecognized texture type for {}",
                        layTex.toString());
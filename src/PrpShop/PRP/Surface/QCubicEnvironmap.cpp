@@ -19,7 +19,20 @@
 #include <QLabel>
 #include <QGroupBox>
 #include <QGridLayout>
+#include <QComboBox>
+#include <QScrollArea>
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QtConcurrent>
+#include <Util/plDDSurface.h>
+#include <cmath>
+#include <vector>
+#include "QLinkLabel.h"
 #include "QPlasmaUtils.h"
+#include "QTextureCache.h"
 
 /* QCubicEnvironmap */
 QCubicEnvironmap::QCubicEnvironmap(plCreatable* pCre, QWidget* parent)
@@ -123,3 +136,260 @@ QCubicEnvironmap::QCubicEnvironmap(plCreatable* pCre, QWidget* parent)
     layout->addWidget(grpFaces, 1, 0, 1, 3);
     layout->addWidget(fPreviewLink, 3, 0, 1, 3);
 }
+
+
+/* QCubeSkyView */
+enum { kSkyDownsample = 2 };
+
+QCubeSkyView::QCubeSkyView(QWidget* parent)
+    : QWidget(parent), fYaw(), fPitch(), fFov(75.0)
+{
+    setCursor(Qt::OpenHandCursor);
+}
+
+void QCubeSkyView::setFaces(const QVector<QImage>& faces)
+{
+    fFaces = faces;
+    update();
+}
+
+void QCubeSkyView::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+    if (fFaces.size() != plCubicEnvironmap::kNumFaces) {
+        painter.fillRect(rect(), Qt::black);
+        return;
+    }
+
+    // Cast a ray through every (downsampled) pixel and look up the face
+    // it lands on; cheap enough to redo on every drag
+    QImage frame(std::max(1, width() / kSkyDownsample),
+                 std::max(1, height() / kSkyDownsample), QImage::Format_RGB32);
+    const double tanHalf = std::tan(fFov * M_PI / 360.0);
+    const double aspect = (double)frame.width() / frame.height();
+    const double cy = std::cos(fYaw * M_PI / 180.0), sy = std::sin(fYaw * M_PI / 180.0);
+    const double cp = std::cos(fPitch * M_PI / 180.0), sp = std::sin(fPitch * M_PI / 180.0);
+    for (int py = 0; py < frame.height(); ++py) {
+        QRgb* line = (QRgb*)frame.scanLine(py);
+        double y = (1.0 - 2.0 * (py + 0.5) / frame.height()) * tanHalf;
+        for (int px = 0; px < frame.width(); ++px) {
+            double x = (2.0 * (px + 0.5) / frame.width() - 1.0) * tanHalf * aspect;
+            double ry = y * cp + sp;
+            double rz = -y * sp + cp;
+            line[px] = sample(x * cy + rz * sy, ry, -x * sy + rz * cy);
+        }
+    }
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage(rect(), frame);
+}
+
+void QCubeSkyView::mousePressEvent(QMouseEvent* evt)
+{
+    fDragPos = evt->pos();
+}
+
+void QCubeSkyView::mouseMoveEvent(QMouseEvent* evt)
+{
+    if ((evt->buttons() & Qt::LeftButton) == 0)
+        return;
+
+    double degPerPixel = fFov / std::max(1, height());
+    QPoint delta = evt->pos() - fDragPos;
+    fDragPos = evt->pos();
+    fYaw = std::fmod(fYaw - delta.x() * degPerPixel, 360.0);
+    fPitch = qBound(-89.0, fPitch + delta.y() * degPerPixel, 89.0);
+    update();
+}
+
+void QCubeSkyView::wheelEvent(QWheelEvent* evt)
+{
+    fFov = qBound(20.0, fFov - evt->angleDelta().y() / 24.0, 120.0);
+    update();
+}
+
+QRgb QCubeSkyView::sample(double x, double y, double z) const
+{
+    double ax = std::fabs(x), ay = std::fabs(y), az = std::fabs(z);
+    size_t face;
+    double u, v;
+    if (ax >= ay && ax >= az) {
+        face = (x > 0) ? plCubicEnvironmap::kRightFace : plCubicEnvironmap::kLeftFace;
+        u = ((x > 0 ? -z : z) / ax + 1.0) / 2.0;
+        v = (1.0 - y / ax) / 2.0;
+    } else if (ay >= az) {
+        face = (y > 0) ? plCubicEnvironmap::kTopFace : plCubicEnvironmap::kBottomFace;
+        u = (x / ay + 1.0) / 2.0;
+        v = (1.0 + (y > 0 ? z : -z) / ay) / 2.0;
+    } else {
+        face = (z > 0) ? plCubicEnvironmap::kFrontFace : plCubicEnvironmap::kBackFace;
+        u = ((z > 0 ? x : -x) / az + 1.0) / 2.0;
+        v = (1.0 - y / az) / 2.0;
+    }
+
+    const QImage& img = fFaces[face];
+    if (img.isNull())
+        return qRgb(0x80, 0x80, 0x80);
+    int tx = qBound(0, (int)(u * img.width()), img.width() - 1);
+    int ty = qBound(0, (int)(v * img.height()), img.height() - 1);
+    return ((const QRgb*)img.constScanLine(ty))[tx] | 0xFF000000;
+}
+
+
+/* QCubicEnvironmap_Preview */
+static QImage decodeFace(plMipmap* face)
+{
+    return QTextureCache::decode(face, 0);
+}
+
+QCubicEnvironmap_Preview::QCubicEnvironmap_Preview(plCreatable* pCre, QWidget* parent)
+    : QCreatable(pCre, kPreviewCubicEnvironmap, parent)
+{
+    plCubicEnvironmap* tex = plCubicEnvironmap::Convert(fCreatable);
+
+    // Decode all six faces at once, rather than one after the other
+    QVector<plMipmap*> faces;
+    for (size_t i=0; i<plCubicEnvironmap::kNumFaces; i++)
+        faces << tex->getFace(i);
+    fFaces = QtConcurrent::blockingMapped<QVector<QImage>>(faces, decodeFace);
+
+    // Lay the faces out as a horizontal cross:
+    //        Top
+    //   Left Front Right Back
+    //        Bottom
+    static const struct { size_t face; int x, y; } crossLayout[] = {
+        { plCubicEnvironmap::kTopFace, 1, 0 },
+        { plCubicEnvironmap::kLeftFace, 0, 1 },
+        { plCubicEnvironmap::kFrontFace, 1, 1 },
+        { plCubicEnvironmap::kRightFace, 2, 1 },
+        { plCubicEnvironmap::kBackFace, 3, 1 },
+        { plCubicEnvironmap::kBottomFace, 1, 2 },
+    };
+    QSize faceSize(tex->getFace(plCubicEnvironmap::kFrontFace)->getWidth(),
+                   tex->getFace(plCubicEnvironmap::kFrontFace)->getHeight());
+    fCross = QImage(faceSize.width() * 4, faceSize.height() * 3, QImage::Format_ARGB32);
+    fCross.fill(Qt::transparent);
+    QPainter crossPainter(&fCross);
+    for (const auto& cell : crossLayout) {
+        QRect target(QPoint(cell.x * faceSize.width(), cell.y * faceSize.height()), faceSize);
+        if (fFaces[cell.face].isNull())
+            crossPainter.fillRect(target, Qt::gray);
+        else
+            crossPainter.drawImage(target, fFaces[cell.face]);
+    }
+    crossPainter.end();
+
+    QWidget* ctlWidget = new QWidget(this);
+    QGridLayout* ctlLayout = new QGridLayout(ctlWidget);
+    ctlLayout->setContentsMargins(4, 4, 4, 4);
+    ctlLayout->setHorizontalSpacing(8);
+    QComboBox* viewSel = new QComboBox(ctlWidget);
+    viewSel->addItems(QStringList{tr("Cross"), tr("Skybox")});
+    viewSel->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Minimum);
+    QLinkLabel* xCrossLink = new QLinkLabel(tr("Export Cross Image..."), ctlWidget);
+    QLinkLabel* xDDSLink = new QLinkLabel(tr("Export DDS Cubemap..."), ctlWidget);
+    xDDSLink->setEnabled(tex->getFace(0)->getCompressionType() != plBitmap::kJPEGCompression);
+    ctlLayout->addWidget(new QLabel(tr("View:"), ctlWidget), 0, 0);
+    ctlLayout->addWidget(viewSel, 0, 1);
+    ctlLayout->addWidget(xCrossLink, 1, 0, 1, 2);
+    ctlLayout->addWidget(xDDSLink, 2, 0, 1, 2);
+
+    QScrollArea* crossView = new QScrollArea(this);
+    QLabel* crossLabel = new QLabel(crossView);
+    crossLabel->setPixmap(QPixmap::fromImage(fCross));
+    crossView->setWidget(crossLabel);
+    QCubeSkyView* skyView = new QCubeSkyView(this);
+    skyView->setFaces(fFaces);
+    fViews = new QStackedWidget(this);
+    fViews->addWidget(crossView);
+    fViews->addWidget(skyView);
+
+    connect(viewSel, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            fViews, &QStackedWidget::setCurrentIndex);
+    connect(xCrossLink, &QLinkLabel::activated, this, &QCubicEnvironmap_Preview::onExportCross);
+    connect(xDDSLink, &QLinkLabel::activated, this, &QCubicEnvironmap_Preview::onExportDDS);
+
+    QGridLayout* layout = new QGridLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setVerticalSpacing(0);
+    layout->addWidget(ctlWidget, 0, 0);
+    layout->addWidget(fViews, 1, 0);
+}
+
+void QCubicEnvironmap_Preview::onExportCross()
+{
+    plCubicEnvironmap* tex = plCubicEnvironmap::Convert(fCreatable);
+    QString filename = st2qstr(tex->getKey()->getName()).replace(QRegExp("[?:/\\*\"<>|]"), "_");
+    filename = QFileDialog::getSaveFileName(this, tr("Export Cross Image"),
+                                            getExportDir() + "/" + filename,
+                                            "Images (*.bmp *.jpg *.png *.tiff)");
+    if (filename.isEmpty())
+        return;
+
+    if (!fCross.save(filename)) {
+        QMessageBox::critical(this, tr("Error exporting image"),
+                              tr("Error: Could not open file %1 for writing").arg(filename),
+                              QMessageBox::Ok);
+        return;
+    }
+    setExportDir(filename);
+}
+
+void QCubicEnvironmap_Preview::onExportDDS()
+{
+    plCubicEnvironmap* tex = plCubicEnvironmap::Convert(fCreatable);
+    plMipmap* first = tex->getFace(0);
+    for (size_t i=1; i<plCubicEnvironmap::kNumFaces; i++) {
+        plMipmap* face = tex->getFace(i);
+        if (face->getWidth() != first->getWidth() || face->getHeight() != first->getHeight()
+                || face->getNumLevels() != first->getNumLevels()
+                || face->getCompressionType() != first->getCompressionType()
+                || face->getDXCompression() != first->getDXCompression()) {
+            QMessageBox::critical(this, tr("Error exporting DDS"),
+                                  tr("All faces must have the same size and format"),
+                                  QMessageBox::Ok);
+            return;
+        }
+    }
+
+    QString filename = st2qstr(tex->getKey()->getName()).replace(QRegExp("[?:/\\*\"<>|]"), "_");
+    filename = QFileDialog::getSaveFileName(this, tr("Export DDS Cubemap"),
+                                            getExportDir() + "/" + filename,
+                                            "DDS Files (*.dds)");
+    if (filename.isEmpty())
+        return;
+
+    hsFileStream S;
+    if (!S.open(qstr2st(filename), fmCreate)) {
+        QMessageBox::critical(this, tr("Error exporting DDS"),
+                              tr("Error: Could not open file %1 for writing").arg(filename),
+                              QMessageBox::Ok);
+        return;
+    }
+    try {
+        // The header describes a single face, and the faces follow it in the
+        // same +X, -X, +Y, -Y, +Z, -Z order that QPlasmaRender uploads them in
+        plDDSurface dds;
+        dds.setFromMipmap(first);
+        dds.fCaps |= plDDSurface::DDSCAPS_COMPLEX;
+        dds.fCaps2 = plDDSurface::DDSCAPS2_CUBEMAP | plDDSurface::DDSCAPS2_CUBEMAP_ALLFACES;
+        std::vector<unsigned char> data;
+        data.reserve(first->getTotalSize() * plCubicEnvironmap::kNumFaces);
+        for (size_t i=0; i<plCubicEnvironmap::kNumFaces; i++) {
+            plMipmap* face = tex->getFace(i);
+            const unsigned char* faceData = (const unsigned char*)face->getImageData();
+            data.insert(data.end(), faceData, faceData + face->getTotalSize());
+        }
+        dds.setData(data.size(), data.data());
+        dds.write(&S);
+    } catch (hsException& ex) {
+        // Don't leave a truncated cube map behind
+        S.close();
+        QFile::remove(filename);
+        QMessageBox::critical(this, tr("Error exporting DDS"),
+                              QString::fromUtf8(ex.what()), QMessageBox::Ok);
+        return;
+    }
+    S.close();
+
+    setExportDir(filename);
+}
@@ -19,6 +19,8 @@
 
 #include "QMipmap.h"
 #include <PRP/Surface/plCubicEnvironmap.h>
+#include <QStackedWidget>
+#include <QVector>
 #include "QBitmaskCheckBox.h"
 
 class QCubicEnvironmap : public QCreatable
@@ -41,4 +43,44 @@ public:
     QCubicEnvironmap(plCreatable* pCre, QWidget* parent = NULL);
 };
 
+class QCubeSkyView : public QWidget
+{
+    Q_OBJECT
+
+protected:
+    QVector<QImage> fFaces;
+    double fYaw, fPitch, fFov;
+    QPoint fDragPos;
+
+public:
+    QCubeSkyView(QWidget* parent = NULL);
+    void setFaces(const QVector<QImage>& faces);
+
+protected:
+    void paintEvent(QPaintEvent*) override;
+    void mousePressEvent(QMouseEvent*) override;
+    void mouseMoveEvent(QMouseEvent*) override;
+    void wheelEvent(QWheelEvent*) override;
+
+private:
+    QRgb sample(double x, double y, double z) const;
+};
+
+class QCubicEnvironmap_Preview : public QCreatable
+{
+    Q_OBJECT
+
+protected:
+    QVector<QImage> fFaces;
+    QImage fCross;
+    QStackedWidget* fViews;
+
+public:
+    QCubicEnvironmap_Preview(plCreatable* pCre, QWidget* parent = NULL);
+
+private slots:
+    void onExportCross();
+    void onExportDDS();
+};
+
 #endif
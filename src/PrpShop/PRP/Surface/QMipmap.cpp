@@ -16,8 +16,11 @@
 
 #include "QMipmap.h"
 
-#include <QScrollArea>
 #include <QLabel>
+#include <QComboBox>
+#include <QScrollBar>
+#include <QPaintEvent>
+#include <QWheelEvent>
 #include <QGroupBox>
 #include <QGridLayout>
 #include <QPainter>
@@ -25,11 +28,14 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <Util/plDDSurface.h>
+#include <cmath>
+#include <memory>
 #include "QLinkLabel.h"
 #include "QPlasmaUtils.h"
+#include "QTextureCache.h"
 
 /* Helpers */
-static QString getExportDir()
+QString getExportDir()
 {
     QSettings settings("PlasmaShop", "PrpShop");
     QString exportDir = settings.value("ExportDir").toString();
@@ -38,7 +44,7 @@ static QString getExportDir()
     return exportDir;
 }
 
-static void setExportDir(const QString& filename)
+void setExportDir(const QString& filename)
 {
     QDir dir = QDir(filename);
     dir.cdUp();
@@ -47,44 +53,62 @@ static void setExportDir(const QString& filename)
 }
 
 /* QTextureBox */
-QTextureBox::~QTextureBox()
+enum
 {
-    delete fImage;
-    delete[] fImageData;
-}
+    kTileSize = 256,
+    kTileCacheKB = 32 * 1024,
+};
 
-void QTextureBox::setTexture(plMipmap* tex, int level)
-{
-    delete fImage;
-    delete[] fImageData;
+static const double kMinZoom = 1.0 / 64.0;
+static const double kMaxZoom = 32.0;
 
-    if (tex == NULL) {
-        fImage = NULL;
-        fImageData = NULL;
-        update();
-        emit textureChanged(false);
+static void applyChannels(QImage& img, int channels)
+{
+    if (channels == QTextureBox::kChannelRGBA)
         return;
-    }
 
-    if (level >= (int)tex->getNumLevels())
-        level = tex->getNumLevels() - 1;
-    if (level < 0) {
-        fImage = NULL;
-        fImageData = NULL;
-        update();
-        emit textureChanged(false);
-        return;
+    for (int y = 0; y < img.height(); ++y) {
+        QRgb* line = (QRgb*)img.scanLine(y);
+        for (int x = 0; x < img.width(); ++x) {
+            QRgb px = line[x];
+            switch (channels) {
+            case QTextureBox::kChannelRGB:
+                line[x] = px | 0xFF000000;
+                break;
+            case QTextureBox::kChannelRed:
+                line[x] = qRgb(qRed(px), qRed(px), qRed(px));
+                break;
+            case QTextureBox::kChannelGreen:
+                line[x] = qRgb(qGreen(px), qGreen(px), qGreen(px));
+                break;
+            case QTextureBox::kChannelBlue:
+                line[x] = qRgb(qBlue(px), qBlue(px), qBlue(px));
+                break;
+            case QTextureBox::kChannelAlpha:
+                line[x] = qRgb(qAlpha(px), qAlpha(px), qAlpha(px));
+                break;
+            }
+        }
     }
+}
+
+QImage decodeMipmapLevel(plMipmap* tex, int level)
+{
+    QMutexLocker lock((tex->getCompressionType() == plBitmap::kJPEGCompression)
+                      ? &pqJPEGDecoderMutex() : Q_NULLPTR);
 
     size_t size = tex->GetUncompressedSize(level);
-    fImageData = new unsigned char[size];
-    tex->DecompressImage(level, fImageData, size);
+    std::unique_ptr<unsigned char[]> imageData(new unsigned char[size]);
+    try {
+        tex->DecompressImage(level, imageData.get(), size);
+    } catch (hsException&) {
+        return QImage();
+    }
 
     if (tex->getCompressionType() != plMipmap::kUncompressed) {
         // Manipulate the data from RGBA to BGRA
-        unsigned int* dp = (unsigned int*)fImageData;
+        unsigned int* dp = (unsigned int*)imageData.get();
         for (size_t i=0; i<size; i += 4) {
-            //unsigned int alpha = doAlpha ? (*dp & 0xFF000000) : 0xFF000000;
             *dp = (*dp & 0xFF000000)
                 | (*dp & 0x00FF0000) >> 16
                 | (*dp & 0x0000FF00)
@@ -92,46 +116,292 @@ void QTextureBox::setTexture(plMipmap* tex, int level)
             dp++;
         }
     }
-    fImage = new QImage(fImageData, tex->getLevelWidth(level),
-                        tex->getLevelHeight(level), QImage::Format_ARGB32);
-    resize(tex->getLevelWidth(level), tex->getLevelHeight(level));
-    update();
+    return QImage(imageData.get(), tex->getLevelWidth(level), tex->getLevelHeight(level),
+                  QImage::Format_ARGB32).copy();
+}
+
+QTextureBox::QTextureBox(QWidget* parent)
+    : QAbstractScrollArea(parent), fTexture(), fLevel(-1),
+      fChannels(kChannelRGBA), fZoom(1.0), fTiles(kTileCacheKB), fLevelImageLevel(-1)
+{
+    horizontalScrollBar()->setSingleStep(16);
+    verticalScrollBar()->setSingleStep(16);
+    viewport()->setCursor(Qt::OpenHandCursor);
+}
+
+void QTextureBox::setTexture(plMipmap* tex, int level)
+{
+    fTexture = tex;
+    fLevel = level;
+    invalidate();
+
+    if (tex == NULL || tex->getNumLevels() == 0) {
+        fTexture = NULL;
+        updateScrollBars();
+        emit textureChanged(false);
+        return;
+    }
+
+    fZoom = 1.0;
+    updateScrollBars();
     emit textureChanged(true);
+    emit zoomChanged(fZoom);
+}
+
+int QTextureBox::displayLevel() const
+{
+    if (fTexture == NULL)
+        return -1;
+
+    // JPEG mipmaps only ever store the top level
+    int maxLevel = (fTexture->getCompressionType() == plBitmap::kJPEGCompression)
+                 ? 0 : (int)fTexture->getNumLevels() - 1;
+    if (fLevel >= 0)
+        return std::min(fLevel, maxLevel);
+
+    int level = 0;
+    for (double scale = fZoom; scale <= 0.5 && level < maxLevel; scale *= 2.0)
+        ++level;
+    return level;
+}
+
+void QTextureBox::setLevel(int level)
+{
+    fLevel = level;
+    viewport()->update();
+}
+
+void QTextureBox::setChannels(int channels)
+{
+    fChannels = channels;
+    fTiles.clear();
+    viewport()->update();
+}
+
+void QTextureBox::setZoom(double zoom)
+{
+    zoomAt(zoom, viewport()->rect().center());
+}
+
+void QTextureBox::zoomToFit()
+{
+    if (fTexture == NULL)
+        return;
+    QSize view = viewport()->size();
+    setZoom(std::min((double)view.width() / fTexture->getWidth(),
+                     (double)view.height() / fTexture->getHeight()));
 }
 
 void QTextureBox::saveAs()
 {
-    if (!fImage)
+    int level = displayLevel();
+    if (level < 0)
         return;
     QString filename = QFileDialog::getSaveFileName(this, tr("Save As..."),
         getExportDir(), "Images (*.bmp *.jpg *.png *.tiff)");
     if (filename.isEmpty())
         return;
-    fImage->save(filename);
+    QTextureCache::decode(fTexture, level).save(filename);
     setExportDir(filename);
 }
 
 void QTextureBox::paintEvent(QPaintEvent* evt)
 {
-    if (fImage == NULL) {
-        QWidget::paintEvent(evt);
-    } else {
-        QPainter painter(this);
-        painter.drawImage(QPoint(0, 0), *fImage);
-        painter.end();
+    int level = displayLevel();
+    if (level < 0) {
+        QAbstractScrollArea::paintEvent(evt);
+        return;
+    }
+
+    QPainter painter(viewport());
+    QPoint origin = contentOrigin();
+    QRect content(origin, contentSize());
+    QRect exposed = evt->rect() & content;
+    if (exposed.isEmpty())
+        return;
+
+    if (fChannels == kChannelRGBA) {
+        QPixmap checker(16, 16);
+        checker.fill(Qt::white);
+        QPainter checkPainter(&checker);
+        checkPainter.fillRect(0, 0, 8, 8, Qt::lightGray);
+        checkPainter.fillRect(8, 8, 8, 8, Qt::lightGray);
+        checkPainter.end();
+        painter.fillRect(exposed, QBrush(checker));
+    }
+
+    // Scale from texels of the displayed level to view pixels
+    int levelWidth = fTexture->getLevelWidth(level);
+    int levelHeight = fTexture->getLevelHeight(level);
+    double sx = (double)content.width() / levelWidth;
+    double sy = (double)content.height() / levelHeight;
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, sx < 1.0 || sy < 1.0);
+
+    int firstX = std::max(0, (int)((exposed.left() - origin.x()) / sx) / kTileSize);
+    int firstY = std::max(0, (int)((exposed.top() - origin.y()) / sy) / kTileSize);
+    int lastX = std::min((levelWidth - 1) / kTileSize,
+                         (int)((exposed.right() - origin.x()) / sx) / kTileSize);
+    int lastY = std::min((levelHeight - 1) / kTileSize,
+                         (int)((exposed.bottom() - origin.y()) / sy) / kTileSize);
+    for (int ty = firstY; ty <= lastY; ++ty) {
+        for (int tx = firstX; tx <= lastX; ++tx) {
+            const QImage* img = tile(level, tx, ty);
+            if (img == NULL)
+                continue;
+            QRectF target(origin.x() + tx * kTileSize * sx, origin.y() + ty * kTileSize * sy,
+                          img->width() * sx, img->height() * sy);
+            painter.drawImage(target, *img);
+        }
+    }
+}
+
+void QTextureBox::resizeEvent(QResizeEvent* evt)
+{
+    QAbstractScrollArea::resizeEvent(evt);
+    updateScrollBars();
+}
+
+void QTextureBox::wheelEvent(QWheelEvent* evt)
+{
+    if ((evt->modifiers() & Qt::ControlModifier) == 0 || fTexture == NULL) {
+        QAbstractScrollArea::wheelEvent(evt);
+        return;
+    }
+
+    // Scale continuously with the wheel delta, so high-resolution wheels
+    // and touchpads zoom smoothly rather than in fixed steps
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    QPoint anchor = evt->position().toPoint();
+#else
+    QPoint anchor = evt->pos();
+#endif
+    zoomAt(fZoom * std::pow(1.0015, evt->angleDelta().y()), anchor);
+    evt->accept();
+}
+
+void QTextureBox::mousePressEvent(QMouseEvent* evt)
+{
+    if (evt->button() == Qt::LeftButton) {
+        fDragPos = evt->pos();
+        viewport()->setCursor(Qt::ClosedHandCursor);
+    }
+    QAbstractScrollArea::mousePressEvent(evt);
+}
+
+void QTextureBox::mouseMoveEvent(QMouseEvent* evt)
+{
+    if (evt->buttons() & Qt::LeftButton) {
+        QPoint delta = evt->pos() - fDragPos;
+        fDragPos = evt->pos();
+        horizontalScrollBar()->setValue(horizontalScrollBar()->value() - delta.x());
+        verticalScrollBar()->setValue(verticalScrollBar()->value() - delta.y());
+    }
+    QAbstractScrollArea::mouseMoveEvent(evt);
+}
+
+void QTextureBox::mouseReleaseEvent(QMouseEvent* evt)
+{
+    if (evt->button() == Qt::LeftButton)
+        viewport()->setCursor(Qt::OpenHandCursor);
+    QAbstractScrollArea::mouseReleaseEvent(evt);
+}
+
+QSize QTextureBox::contentSize() const
+{
+    if (fTexture == NULL)
+        return QSize(0, 0);
+    return QSize(std::max(1, (int)std::ceil(fTexture->getWidth() * fZoom)),
+                 std::max(1, (int)std::ceil(fTexture->getHeight() * fZoom)));
+}
+
+QPoint QTextureBox::contentOrigin() const
+{
+    QSize content = contentSize();
+    QSize view = viewport()->size();
+    int x = (content.width() < view.width()) ? (view.width() - content.width()) / 2
+                                             : -horizontalScrollBar()->value();
+    int y = (content.height() < view.height()) ? (view.height() - content.height()) / 2
+                                               : -verticalScrollBar()->value();
+    return QPoint(x, y);
+}
+
+void QTextureBox::updateScrollBars()
+{
+    QSize content = contentSize();
+    QSize view = viewport()->size();
+    horizontalScrollBar()->setRange(0, std::max(0, content.width() - view.width()));
+    horizontalScrollBar()->setPageStep(view.width());
+    verticalScrollBar()->setRange(0, std::max(0, content.height() - view.height()));
+    verticalScrollBar()->setPageStep(view.height());
+    viewport()->update();
+}
+
+void QTextureBox::zoomAt(double zoom, const QPoint& anchor)
+{
+    zoom = qBound(kMinZoom, zoom, kMaxZoom);
+    if (fTexture == NULL || zoom == fZoom)
+        return;
+
+    // Keep the texel under the anchor point in place
+    QPointF texel = QPointF(anchor - contentOrigin()) / fZoom;
+    fZoom = zoom;
+    updateScrollBars();
+    horizontalScrollBar()->setValue(qRound(texel.x() * fZoom - anchor.x()));
+    verticalScrollBar()->setValue(qRound(texel.y() * fZoom - anchor.y()));
+    emit zoomChanged(fZoom);
+}
+
+void QTextureBox::invalidate()
+{
+    fTiles.clear();
+    fLevelImage = QImage();
+    fLevelImageLevel = -1;
+    viewport()->update();
+}
+
+const QImage* QTextureBox::tile(int level, int tx, int ty)
+{
+    quint64 tileKey = ((quint64)level << 48) | ((quint64)ty << 24) | (quint64)tx;
+    QImage* img = fTiles.object(tileKey);
+    if (img != NULL)
+        return img;
+
+    int levelWidth = fTexture->getLevelWidth(level);
+    int levelHeight = fTexture->getLevelHeight(level);
+    QRect rect(tx * kTileSize, ty * kTileSize,
+               std::min((int)kTileSize, levelWidth - tx * kTileSize),
+               std::min((int)kTileSize, levelHeight - ty * kTileSize));
+    QImage decoded = decodeRegion(level, rect);
+    if (decoded.isNull())
+        return NULL;
+    applyChannels(decoded, fChannels);
+
+    img = new QImage(decoded);
+    int cost = std::max(1, img->bytesPerLine() * img->height() / 1024);
+    if (!fTiles.insert(tileKey, img, cost))
+        return NULL;
+    return img;
+}
+
+QImage QTextureBox::decodeRegion(int level, const QRect& rect)
+{
+    // The library only decodes whole levels, so the displayed level is
+    // decoded once and every tile is cut from it
+    if (fLevelImageLevel != level) {
+        fLevelImage = QTextureCache::decode(fTexture, level);
+        fLevelImageLevel = level;
     }
+    return fLevelImage.isNull() ? QImage() : fLevelImage.copy(rect);
 }
 
 
 /* QMipmap_Preview */
 QMipmap_Preview::QMipmap_Preview(plCreatable* pCre, QWidget* parent)
-    : QCreatable(pCre, kPreviewMipmap, parent), fLevel()
+    : QCreatable(pCre, kPreviewMipmap, parent), fLevel(-1)
 {
     plMipmap* tex = plMipmap::Convert(fCreatable);
 
-    QScrollArea* scroll = new QScrollArea(this);
-    fTexture = new QTextureBox(scroll);
-    scroll->setWidget(fTexture);
+    fTexture = new QTextureBox(this);
 
     QWidget* levelWidget = new QWidget(this);
     QGridLayout* levelLayout = new QGridLayout(levelWidget);
@@ -139,31 +409,64 @@ QMipmap_Preview::QMipmap_Preview(plCreatable* pCre, QWidget* parent)
     levelLayout->setHorizontalSpacing(8);
     QSpinBox* levelSel = new QSpinBox(levelWidget);
     if (tex->getCompressionType() == plBitmap::kJPEGCompression)
-        levelSel->setRange(0, 0);
+        levelSel->setRange(-1, 0);
     else
-        levelSel->setRange(0, tex->getNumLevels() - 1);
+        levelSel->setRange(-1, tex->getNumLevels() - 1);
+    levelSel->setSpecialValueText(tr("Auto"));
+    levelSel->setValue(-1);
     connect(levelSel, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &QMipmap_Preview::setLevel);
+    QComboBox* channelSel = new QComboBox(levelWidget);
+    channelSel->addItems(QStringList{tr("RGBA"), tr("RGB"), tr("Red"), tr("Green"),
+                                     tr("Blue"), tr("Alpha")});
+    connect(channelSel, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            fTexture, &QTextureBox::setChannels);
+    fZoomLabel = new QLabel(levelWidget);
+    QLinkLabel* fitLink = new QLinkLabel(tr("Fit"), levelWidget);
+    QLinkLabel* actualLink = new QLinkLabel(tr("1:1"), levelWidget);
+    connect(fitLink, &QLinkLabel::activated, fTexture, &QTextureBox::zoomToFit);
+    connect(actualLink, &QLinkLabel::activated, this, [this] { fTexture->setZoom(1.0); });
+    connect(fTexture, &QTextureBox::zoomChanged, this, &QMipmap_Preview::updateZoomLabel);
+
     levelLayout->addWidget(new QLabel(tr("Level:"), levelWidget), 0, 0);
-    levelLayout->addWidget(levelSel, 0, 1);
+    levelLayout->addWidget(levelSel, 0, 1, 1, 3);
+    levelLayout->addWidget(new QLabel(tr("Channels:"), levelWidget), 1, 0);
+    levelLayout->addWidget(channelSel, 1, 1, 1, 3);
+    levelLayout->addWidget(new QLabel(tr("Zoom:"), levelWidget), 2, 0);
+    levelLayout->addWidget(fZoomLabel, 2, 1);
+    levelLayout->addWidget(fitLink, 2, 2);
+    levelLayout->addWidget(actualLink, 2, 3);
     levelSel->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Minimum);
+    channelSel->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Minimum);
+    fZoomLabel->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Minimum);
     QLinkLabel* saveAsLink = new QLinkLabel(tr("Save As..."), levelWidget);
-    levelLayout->addWidget(saveAsLink, 1, 0, 1, 2);
+    levelLayout->addWidget(saveAsLink, 3, 0, 1, 4);
     connect(fTexture, &QTextureBox::textureChanged, saveAsLink, &QWidget::setEnabled);
     connect(saveAsLink, &QLinkLabel::activated, fTexture, &QTextureBox::saveAs);
-    fTexture->setTexture(tex);
 
     QGridLayout* layout = new QGridLayout(this);
     layout->setContentsMargins(0, 0, 0, 0);
     layout->setVerticalSpacing(0);
     layout->addWidget(levelWidget, 0, 0);
-    layout->addWidget(scroll, 1, 0);
+    layout->addWidget(fTexture, 1, 0);
+
+    fTexture->setTexture(tex);
 }
 
 void QMipmap_Preview::setLevel(int level)
 {
     fLevel = level;
-    fTexture->setTexture(plMipmap::Convert(fCreatable), fLevel);
+    fTexture->setLevel(fLevel);
+    updateZoomLabel(fTexture->zoom());
+}
+
+void QMipmap_Preview::updateZoomLabel(double zoom)
+{
+    int level = fTexture->displayLevel();
+    if (level > 0)
+        fZoomLabel->setText(tr("%1% (level %2)").arg(qRound(zoom * 100.0)).arg(level));
+    else
+        fZoomLabel->setText(tr("%1%").arg(qRound(zoom * 100.0)));
 }
 
 
@@ -540,6 +843,7 @@ void QMipmap::onImportDDS()
         plMipmap* newTex = dds.createMipmap();
         tex->CopyFrom(newTex);
         delete newTex;
+        QTextureCache::invalidate(tex);
     } catch (hsException& ex) {
         QMessageBox::critical(this, tr("Error importing DDS"),
                               QString::fromUtf8(ex.what()), QMessageBox::Ok);
@@ -619,8 +923,10 @@ void QMipmap::onImportJPEG()
     }
     S.close();
 
-    if (valid)
+    if (valid) {
         tex->CopyFrom(&newTex);
+        QTextureCache::invalidate(tex);
+    }
 
     setExportDir(filename);
 }
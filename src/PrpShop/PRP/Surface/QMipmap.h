@@ -21,33 +21,71 @@
 
 #include <PRP/Surface/plMipmap.h>
 #include <QImage>
+#include <QCache>
+#include <QLabel>
 #include <QSpinBox>
+#include <QAbstractScrollArea>
 #include "PRP/QObjLink.h"
 #include "QBitmaskCheckBox.h"
 
-class QTextureBox : public QWidget
+class QTextureBox : public QAbstractScrollArea
 {
     Q_OBJECT
 
+public:
+    enum Channels
+    {
+        kChannelRGBA, kChannelRGB, kChannelRed, kChannelGreen, kChannelBlue,
+        kChannelAlpha
+    };
+
 protected:
-    QImage* fImage;
-    unsigned char* fImageData;
+    plMipmap* fTexture;
+    int fLevel;
+    int fChannels;
+    double fZoom;
+    QPoint fDragPos;
+
+    // Tiles of the displayed level(s) with the channel filter applied, so
+    // only the visible part of a large texture is converted and painted
+    QCache<quint64, QImage> fTiles;
+    QImage fLevelImage;
+    int fLevelImageLevel;
 
 public:
-    QTextureBox(QWidget* parent = NULL)
-        : QWidget(parent), fImage(), fImageData() { }
+    QTextureBox(QWidget* parent = NULL);
 
-    ~QTextureBox();
-    void setTexture(plMipmap* tex, int level = 0);
+    void setTexture(plMipmap* tex, int level = -1);
+    int displayLevel() const;
+    double zoom() const { return fZoom; }
 
 public slots:
+    void setLevel(int level);
+    void setChannels(int channels);
+    void setZoom(double zoom);
+    void zoomToFit();
     void saveAs();
 
 protected:
     void paintEvent(QPaintEvent*) override;
+    void resizeEvent(QResizeEvent*) override;
+    void wheelEvent(QWheelEvent*) override;
+    void mousePressEvent(QMouseEvent*) override;
+    void mouseMoveEvent(QMouseEvent*) override;
+    void mouseReleaseEvent(QMouseEvent*) override;
 
 signals:
     void textureChanged(bool success);
+    void zoomChanged(double zoom);
+
+private:
+    QSize contentSize() const;
+    QPoint contentOrigin() const;
+    void updateScrollBars();
+    void zoomAt(double zoom, const QPoint& anchor);
+    void invalidate();
+    const QImage* tile(int level, int tx, int ty);
+    QImage decodeRegion(int level, const QRect& rect);
 };
 
 class QMipmap_Preview : public QCreatable
@@ -56,6 +94,7 @@ class QMipmap_Preview : public QCreatable
 
 protected:
     QTextureBox* fTexture;
+    QLabel* fZoomLabel;
     int fLevel;
 
 public:
@@ -65,6 +104,9 @@ public:
 
 public slots:
     void setLevel(int level);
+
+private slots:
+    void updateZoomLabel(double zoom);
 };
 
 class QMipmap : public QCreatable
@@ -93,5 +135,11 @@ private slots:
 };
 
 QString getCompressionText(plBitmap* tex);
+QString getExportDir();
+void setExportDir(const QString& filename);
+
+// Decode a single mip level to an ARGB32 image, or a null image on failure.
+// Safe to call from worker threads; JPEG levels are decoded one at a time.
+QImage decodeMipmapLevel(plMipmap* tex, int level);
 
 #endif
@@ -0,0 +1,247 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "QHexDecoders.h"
+#include <QDateTime>
+#include <QStringList>
+#include <cstring>
+#include <Stream/hsRAMStream.h>
+#include <PRP/KeyedObject/plUoid.h>
+#include <ResManager/plFactory.h>
+#include "QPlasma.h"
+
+template <typename T>
+static T readLE(const uchar* data)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        value |= ((T)data[i]) << (i * 8);
+    return value;
+}
+
+static float readFloat(const uchar* data)
+{
+    uint32_t bits = readLE<uint32_t>(data);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static QString floatList(const uchar* data, int count)
+{
+    QStringList values;
+    for (int i = 0; i < count; ++i)
+        values << QString::number(readFloat(data + (i * 4)));
+    return values.join(", ");
+}
+
+// Strings are only shown when they look like text, and on a single line
+static QString quoteText(const QString& text)
+{
+    if (text.isEmpty())
+        return QString();
+    for (QChar ch : text) {
+        if (!ch.isPrint() && ch != '\t' && ch != '\n' && ch != '\r')
+            return QString();
+    }
+    QString escaped = text;
+    escaped.replace('\n', "\\n").replace('\r', "\\r").replace('\t', "\\t");
+    return QString("\"%1\"").arg(escaped);
+}
+
+// Read a libHSPlasma structure from the span, using the stream
+// encoding of the loaded game version
+static QString readStream(const uchar* data, int size,
+                          const QHexDecoder::Context& context,
+                          const std::function<QString(hsStream*)>& read)
+{
+    hsRAMStream S;
+    S.setVer(context.fVer);
+    S.write(size, data);
+    S.rewind();
+    try {
+        return read(&S);
+    } catch (std::exception&) {
+        return QString();
+    }
+}
+
+static QString formatTime(qint64 msecs)
+{
+    QDateTime time = QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC);
+    if (!time.isValid())
+        return QString();
+    return time.toString("yyyy-MM-dd hh:mm:ss.zzz 'UTC'");
+}
+
+static QVector<QHexDecoder> builtinDecoders()
+{
+    QVector<QHexDecoder> decoders;
+    auto add = [&decoders](const QString& name, int minSize, int maxSize,
+                           QHexDecoder::DecodeFunc decode) {
+        decoders.append(QHexDecoder { name, minSize, maxSize, decode });
+    };
+
+    add(QHexDecoders::tr("8-bit int"), 1, 1,
+        [](const uchar* data, int, const QHexDecoder::Context& context) {
+            return context.fSigned ? QString::number((int)(signed char)data[0])
+                                   : QString::number((unsigned int)data[0]);
+        });
+    add(QHexDecoders::tr("16-bit int"), 2, 2,
+        [](const uchar* data, int, const QHexDecoder::Context& context) {
+            uint16_t value = readLE<uint16_t>(data);
+            return context.fSigned ? QString::number((int)(int16_t)value)
+                                   : QString::number((unsigned int)value);
+        });
+    add(QHexDecoders::tr("32-bit int"), 4, 4,
+        [](const uchar* data, int, const QHexDecoder::Context& context) {
+            uint32_t value = readLE<uint32_t>(data);
+            return context.fSigned ? QString::number((int32_t)value)
+                                   : QString::number(value);
+        });
+    add(QHexDecoders::tr("64-bit int"), 8, 8,
+        [](const uchar* data, int, const QHexDecoder::Context& context) {
+            uint64_t value = readLE<uint64_t>(data);
+            return context.fSigned ? QString::number((qint64)value)
+                                   : QString::number((quint64)value);
+        });
+    add(QHexDecoders::tr("float"), 4, 4,
+        [](const uchar* data, int, const QHexDecoder::Context&) {
+            return QString::number(readFloat(data));
+        });
+    add(QHexDecoders::tr("double"), 8, 8,
+        [](const uchar* data, int, const QHexDecoder::Context&) {
+            uint64_t bits = readLE<uint64_t>(data);
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return QString::number(value);
+        });
+    add(QHexDecoders::tr("Varint (LEB128)"), 1, 10,
+        [](const uchar* data, int size, const QHexDecoder::Context& context) {
+            quint64 value = 0;
+            for (int i = 0; i < size && i < 10; ++i) {
+                value |= ((quint64)(data[i] & 0x7F)) << (i * 7);
+                if ((data[i] & 0x80) == 0) {
+                    // Zigzag encoding for signed values
+                    QString text = context.fSigned
+                            ? QString::number((qint64)(value >> 1) ^ -(qint64)(value & 1))
+                            : QString::number(value);
+                    return QHexDecoders::tr("%1 (%2 bytes)").arg(text).arg(i + 1);
+                }
+            }
+            return QString();
+        });
+    add(QHexDecoders::tr("hsVector3"), 12, 12,
+        [](const uchar* data, int, const QHexDecoder::Context&) {
+            return QString("(%1)").arg(floatList(data, 3));
+        });
+    add(QHexDecoders::tr("hsQuat"), 16, 16,
+        [](const uchar* data, int, const QHexDecoder::Context&) {
+            return QString("(%1)").arg(floatList(data, 4));
+        });
+    add(QHexDecoders::tr("hsMatrix44"), 1, 65,
+        [](const uchar* data, int size, const QHexDecoder::Context&) {
+            // Matrices are stored with a leading flag; identity matrices
+            // are written without any data
+            if (data[0] == 0)
+                return QHexDecoders::tr("Identity");
+            if (data[0] != 1 || size < 65)
+                return QString();
+            QStringList rows;
+            for (int i = 0; i < 4; ++i)
+                rows << QString("[%1]").arg(floatList(data + 1 + (i * 16), 4));
+            return rows.join(' ');
+        });
+    add(QHexDecoders::tr("Key reference"), 1, 1024,
+        [](const uchar* data, int size, const QHexDecoder::Context& context) {
+            if (data[0] == 0)
+                return QHexDecoders::tr("(null)");
+            if (data[0] != 1)
+                return QString();
+            return readStream(data + 1, size - 1, context, [](hsStream* S) {
+                plUoid uoid;
+                uoid.read(S);
+                const char* typeName = plFactory::ClassName(uoid.getType());
+                QString name = quoteText(st2qstr(uoid.getName()));
+                if (typeName == NULL || name.isEmpty())
+                    return QString();
+                return QString("%1 %2 [%3;%4]").arg(typeName).arg(name)
+                               .arg(uoid.getLocation().getSeqPrefix())
+                               .arg(uoid.getLocation().getPageNum());
+            });
+        });
+    add(QHexDecoders::tr("SafeString"), 2, 4 + 0x0FFF,
+        [](const uchar* data, int size, const QHexDecoder::Context& context) {
+            return readStream(data, size, context, [](hsStream* S) {
+                return quoteText(st2qstr(S->readSafeStr()));
+            });
+        });
+    add(QHexDecoders::tr("SafeWString"), 2, 4 + (0x0FFF * 2),
+        [](const uchar* data, int size, const QHexDecoder::Context& context) {
+            return readStream(data, size, context, [](hsStream* S) {
+                return quoteText(st2qstr(S->readSafeWStr()));
+            });
+        });
+    add(QHexDecoders::tr("ST::string (32-bit length)"), 4, 4 + 4096,
+        [](const uchar* data, int size, const QHexDecoder::Context&) {
+            uint32_t length = readLE<uint32_t>(data);
+            if (length > (uint32_t)(size - 4))
+                return QString();
+            return quoteText(QString::fromUtf8((const char*)data + 4, length));
+        });
+    add(QHexDecoders::tr("plUnifiedTime"), 8, 8,
+        [](const uchar* data, int, const QHexDecoder::Context&) {
+            uint32_t secs = readLE<uint32_t>(data);
+            uint32_t micros = readLE<uint32_t>(data + 4);
+            if (micros >= 1000000)
+                return QString();
+            return formatTime(((qint64)secs * 1000) + (micros / 1000));
+        });
+    add(QHexDecoders::tr("Windows FILETIME"), 8, 8,
+        [](const uchar* data, int, const QHexDecoder::Context&) {
+            // 100ns intervals since 1601-01-01
+            quint64 ticks = readLE<uint64_t>(data);
+            return formatTime((qint64)(ticks / 10000) - Q_INT64_C(11644473600000));
+        });
+
+    return decoders;
+}
+
+static QVector<QHexDecoder>& decoderList()
+{
+    static QVector<QHexDecoder> s_decoders = builtinDecoders();
+    return s_decoders;
+}
+
+void QHexDecoders::add(const QString& name, int minSize, int maxSize,
+                       QHexDecoder::DecodeFunc decode)
+{
+    decoderList().append(QHexDecoder { name, minSize, maxSize, decode });
+}
+
+const QVector<QHexDecoder>& QHexDecoders::all()
+{
+    return decoderList();
+}
+
+int QHexDecoders::maxSpan()
+{
+    int span = 0;
+    for (const QHexDecoder& decoder : decoderList())
+        span = qMax(span, decoder.fMaxSize);
+    return span;
+}
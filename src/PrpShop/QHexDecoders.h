@@ -0,0 +1,61 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _QHEXDECODERS_H
+#define _QHEXDECODERS_H
+
+#include <QString>
+#include <QVector>
+#include <QCoreApplication>
+#include <Util/PlasmaVersions.h>
+#include <functional>
+
+/* A typed view of the bytes under the hex viewer's cursor.  Every decoder is
+ * handed the same span, read once per cursor move, and returns an empty
+ * string when the bytes there can't be what it decodes. */
+struct QHexDecoder
+{
+    struct Context
+    {
+        bool fSigned;
+        PlasmaVer fVer;
+    };
+
+    typedef std::function<QString(const uchar* data, int size,
+                                  const Context& context)> DecodeFunc;
+
+    QString fName;
+    int fMinSize;   // Shorter spans (at the end of the data) are skipped
+    int fMaxSize;   // The most this decoder will ever look at
+    DecodeFunc fDecode;
+};
+
+class QHexDecoders
+{
+    Q_DECLARE_TR_FUNCTIONS(QHexDecoders)
+
+public:
+    // Decoders appear in the viewer in the order they were added
+    static void add(const QString& name, int minSize, int maxSize,
+                    QHexDecoder::DecodeFunc decode);
+    static const QVector<QHexDecoder>& all();
+
+    // Size of the span to read so that every decoder has enough data
+    static int maxSpan();
+};
+
+#endif
@@ -0,0 +1,221 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QHexDiffViewer.h"
+
+#include <QLabel>
+#include <QPushButton>
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QStatusBar>
+#include <QScrollBar>
+#include <QAction>
+#include <QtConcurrent>
+#include <climits>
+#include <algorithm>
+#include "QHexWidget.h"
+
+static QHexWidget::Annotation hunkAnnotation(const QHexDiffHunk& hunk, bool left)
+{
+    QHexWidget::Annotation ann;
+    ann.fStart = left ? hunk.fLeftStart : hunk.fRightStart;
+    ann.fLength = left ? hunk.fLeftLength : hunk.fRightLength;
+    if (hunk.fLeftLength == 0)
+        ann.fLabel = QObject::tr("Inserted %1 bytes").arg(hunk.fRightLength);
+    else if (hunk.fRightLength == 0)
+        ann.fLabel = QObject::tr("Deleted %1 bytes").arg(hunk.fLeftLength);
+    else
+        ann.fLabel = QObject::tr("Changed %1 bytes to %2 bytes")
+                     .arg(hunk.fLeftLength).arg(hunk.fRightLength);
+    ann.fColor = left ? QColor(255, 210, 210) : QColor(205, 240, 205);
+    return ann;
+}
+
+QHexDiffViewer::QHexDiffViewer(const QSharedPointer<QHexDataSource>& left,
+                               const QString& leftTitle,
+                               const QSharedPointer<QHexDataSource>& right,
+                               const QString& rightTitle, QWidget* parent)
+    : QWidget(parent, Qt::Window), fCurrentHunk(-1), fSyncing()
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(tr("Compare: %1 - %2").arg(leftTitle).arg(rightTitle));
+
+    fLeft = new QHexWidget(this);
+    fLeft->setDataSource(left);
+    fRight = new QHexWidget(this);
+    fRight->setDataSource(right);
+    QLabel* leftLabel = new QLabel(leftTitle, this);
+    leftLabel->setToolTip(leftTitle);
+    QLabel* rightLabel = new QLabel(rightTitle, this);
+    rightLabel->setToolTip(rightTitle);
+
+    QWidget* hunkBar = new QWidget(this);
+    fPrevButton = new QPushButton(tr("&Previous Change"), hunkBar);
+    fNextButton = new QPushButton(tr("&Next Change"), hunkBar);
+    fPrevButton->setEnabled(false);
+    fNextButton->setEnabled(false);
+    QHBoxLayout* hunkLayout = new QHBoxLayout(hunkBar);
+    hunkLayout->setContentsMargins(4, 0, 4, 0);
+    hunkLayout->addStretch(1);
+    hunkLayout->addWidget(fPrevButton);
+    hunkLayout->addWidget(fNextButton);
+
+    fStatusBar = new QStatusBar(this);
+    fStatusBar->setSizeGripEnabled(true);
+    fStatusBar->showMessage(tr("Comparing..."));
+
+    QAction* prevAction = new QAction(this);
+    prevAction->setShortcuts(QList<QKeySequence>{ Qt::SHIFT + Qt::Key_F7, Qt::ALT + Qt::Key_Up });
+    addAction(prevAction);
+    QAction* nextAction = new QAction(this);
+    nextAction->setShortcuts(QList<QKeySequence>{ Qt::Key_F7, Qt::ALT + Qt::Key_Down });
+    addAction(nextAction);
+    connect(prevAction, &QAction::triggered, this, &QHexDiffViewer::prevHunk);
+    connect(nextAction, &QAction::triggered, this, &QHexDiffViewer::nextHunk);
+    connect(fPrevButton, &QPushButton::clicked, this, &QHexDiffViewer::prevHunk);
+    connect(fNextButton, &QPushButton::clicked, this, &QHexDiffViewer::nextHunk);
+
+    // Keep the two sides lined up through the changes
+    connect(fLeft->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, [this](int) { syncScroll(fLeft, fRight); });
+    connect(fRight->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, [this](int) { syncScroll(fRight, fLeft); });
+    connect(fLeft, &QHexWidget::currentAddressChanged,
+            this, [this](qint64) { syncCursor(fLeft, fRight); });
+    connect(fRight, &QHexWidget::currentAddressChanged,
+            this, [this](qint64) { syncCursor(fRight, fLeft); });
+
+    QGridLayout* layout = new QGridLayout(this);
+    layout->setContentsMargins(0, 4, 0, 0);
+    layout->setSpacing(4);
+    layout->addWidget(leftLabel, 0, 0);
+    layout->addWidget(rightLabel, 0, 1);
+    layout->addWidget(fLeft, 1, 0);
+    layout->addWidget(fRight, 1, 1);
+    layout->addWidget(hunkBar, 2, 0, 1, 2);
+    layout->addWidget(fStatusBar, 3, 0, 1, 2);
+    setLayout(layout);
+
+    connect(&fDiffWatcher, &QFutureWatcher<QVector<QHexDiffHunk>>::finished,
+            this, &QHexDiffViewer::diffFinished);
+    const QAtomicInt* cancel = &fDiffCancel;
+    fDiffWatcher.setFuture(QtConcurrent::run([left, right, cancel] {
+        return QHexDiff::compare(left.data(), right.data(), cancel);
+    }));
+}
+
+QHexDiffViewer::~QHexDiffViewer()
+{
+    fDiffCancel.storeRelease(1);
+    fDiffWatcher.waitForFinished();
+}
+
+void QHexDiffViewer::diffFinished()
+{
+    fHunks = fDiffWatcher.result();
+
+    QVector<QHexWidget::Annotation> leftAnns, rightAnns;
+    for (const QHexDiffHunk& hunk : fHunks) {
+        if (hunk.fLeftLength)
+            leftAnns.append(hunkAnnotation(hunk, true));
+        if (hunk.fRightLength)
+            rightAnns.append(hunkAnnotation(hunk, false));
+    }
+    fLeft->setAnnotations(leftAnns);
+    fRight->setAnnotations(rightAnns);
+
+    fPrevButton->setEnabled(!fHunks.isEmpty());
+    fNextButton->setEnabled(!fHunks.isEmpty());
+    if (fHunks.isEmpty())
+        fStatusBar->showMessage(tr("No differences"));
+    else
+        showHunk(0);
+}
+
+void QHexDiffViewer::nextHunk()
+{
+    if (!fHunks.isEmpty())
+        showHunk((fCurrentHunk + 1) % fHunks.size());
+}
+
+void QHexDiffViewer::prevHunk()
+{
+    if (!fHunks.isEmpty())
+        showHunk((fCurrentHunk + fHunks.size() - 1) % fHunks.size());
+}
+
+void QHexDiffViewer::showHunk(int index)
+{
+    fCurrentHunk = index;
+    const QHexDiffHunk& hunk = fHunks[index];
+
+    fSyncing = true;
+    fLeft->setSelection(hunk.fLeftStart,
+                        hunk.fLeftStart + qMax<qint64>(hunk.fLeftLength - 1, 0));
+    fRight->setSelection(hunk.fRightStart,
+                         hunk.fRightStart + qMax<qint64>(hunk.fRightLength - 1, 0));
+    fSyncing = false;
+    syncScroll(fLeft, fRight);
+    updateStatus();
+}
+
+void QHexDiffViewer::syncScroll(QHexWidget* from, QHexWidget* to)
+{
+    if (fSyncing)
+        return;
+
+    // Scrolling works in whole lines, so sides can be off by part of a
+    // line where the changes shift them by other than a multiple of 16
+    fSyncing = true;
+    qint64 address = QHexDiff::mapAddress(fHunks, from->firstVisibleAddress(), from == fLeft);
+    to->verticalScrollBar()->setValue((int)qMin<qint64>(address / 16, INT_MAX));
+    fSyncing = false;
+}
+
+void QHexDiffViewer::syncCursor(QHexWidget* from, QHexWidget* to)
+{
+    if (fSyncing)
+        return;
+
+    fSyncing = true;
+    to->setCurrentAddress(QHexDiff::mapAddress(fHunks, from->currentAddress(), from == fLeft));
+    fSyncing = false;
+
+    // Follow the cursor through the list of changes
+    const bool fromLeft = (from == fLeft);
+    auto it = std::upper_bound(fHunks.constBegin(), fHunks.constEnd(), from->currentAddress(),
+            [fromLeft](qint64 address, const QHexDiffHunk& hunk) {
+                return address < (fromLeft ? hunk.fLeftStart : hunk.fRightStart);
+            });
+    fCurrentHunk = (int)(it - fHunks.constBegin()) - 1;
+    updateStatus();
+}
+
+void QHexDiffViewer::updateStatus()
+{
+    if (fHunks.isEmpty())
+        return;
+
+    const QHexWidget::Annotation* ann = fLeft->annotationAt(fLeft->currentAddress());
+    if (!ann)
+        ann = fRight->annotationAt(fRight->currentAddress());
+    QString message = tr("%1 changes").arg(fHunks.size());
+    if (fCurrentHunk >= 0)
+        message = tr("Change %1 of %2").arg(fCurrentHunk + 1).arg(fHunks.size());
+    if (ann)
+        message += QString("    ") + ann->fLabel;
+    fStatusBar->showMessage(message);
+}
@@ -0,0 +1,65 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QHEXDIFFVIEWER_H
+#define _QHEXDIFFVIEWER_H
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include "QHexDiff.h"
+
+class QHexWidget;
+class QLabel;
+class QPushButton;
+class QStatusBar;
+
+class QHexDiffViewer : public QWidget
+{
+    Q_OBJECT
+
+protected:
+    QHexWidget* fLeft;
+    QHexWidget* fRight;
+    QPushButton* fPrevButton;
+    QPushButton* fNextButton;
+    QStatusBar* fStatusBar;
+
+    QVector<QHexDiffHunk> fHunks;
+    int fCurrentHunk;
+    bool fSyncing;
+    QFutureWatcher<QVector<QHexDiffHunk>> fDiffWatcher;
+    QAtomicInt fDiffCancel;
+
+public:
+    QHexDiffViewer(const QSharedPointer<QHexDataSource>& left, const QString& leftTitle,
+                   const QSharedPointer<QHexDataSource>& right, const QString& rightTitle,
+                   QWidget* parent = Q_NULLPTR);
+    ~QHexDiffViewer();
+
+private slots:
+    void diffFinished();
+    void nextHunk();
+    void prevHunk();
+
+private:
+    void showHunk(int index);
+    void syncScroll(QHexWidget* from, QHexWidget* to);
+    void syncCursor(QHexWidget* from, QHexWidget* to);
+    void updateStatus();
+};
+
+#endif
@@ -18,11 +18,113 @@
 #include <QLabel>
 #include <QCheckBox>
 #include <QVBoxLayout>
+#include <QHBoxLayout>
 #include <QGridLayout>
+#include <QSplitter>
+#include <QTreeWidget>
 #include <QStatusBar>
-#include <QFile>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QPushButton>
+#include <QToolBar>
+#include <QMessageBox>
+#include <QCloseEvent>
+#include <QtConcurrent>
+#include <cstring>
+#include <memory>
 #include <Stream/hsRAMStream.h>
+#include <ResManager/plFactory.h>
+#include <PRP/KeyedObject/hsKeyedObject.h>
+#include "QPlasma.h"
 #include "QHexWidget.h"
+#include "QHexSearch.h"
+#include "QHexMinimap.h"
+#include "QHexDecoders.h"
+#include "QTextureCache.h"
+#include "Main.h"
+
+// Find All stops after this many hits, to keep the highlight list sane
+#define MAX_SEARCH_HITS  (100000)
+
+/* Records where each primitive value comes from while an object is read.
+ * libHSPlasma doesn't tell us field names, so fields are labeled by
+ * their width, plus a guess at length-prefixed strings and buffers. */
+class FieldRecorder : public hsRAMStream
+{
+public:
+    QVector<QHexWidget::Annotation> fFields;
+
+    size_t read(size_t size, void* buf) override
+    {
+        qint64 start = pos();
+        size_t got = hsRAMStream::read(size, buf);
+        if (size == 0)
+            return got;
+
+        QHexWidget::Annotation field;
+        field.fStart = start;
+        field.fLength = size;
+        if (fFields.isEmpty() && size == 2) {
+            field.fLabel = QObject::tr("Class index");
+        } else if (!fFields.isEmpty() && size > 4 && isLengthOf(fFields.last(), start, size)) {
+            fFields.last().fLabel = QObject::tr("Length");
+            field.fLabel = QObject::tr("String / buffer (%1 bytes)").arg(size);
+        } else {
+            field.fLabel = widthLabel(size);
+        }
+        fLastValue = 0;
+        if (size <= 4)
+            memcpy(&fLastValue, buf, size);
+        fFields.append(field);
+        return got;
+    }
+
+private:
+    uint32_t fLastValue = 0;
+
+    bool isLengthOf(const QHexWidget::Annotation& prev, qint64 start, size_t size) const
+    {
+        if (prev.fStart + prev.fLength != start)
+            return false;
+        // SafeStrings keep flags in the top nibble of their length
+        if (prev.fLength == 2)
+            return (fLastValue & 0x0FFF) == size;
+        return prev.fLength == 4 && fLastValue == size;
+    }
+
+    static QString widthLabel(size_t size)
+    {
+        switch (size) {
+        case 1:
+            return QObject::tr("8-bit value");
+        case 2:
+            return QObject::tr("16-bit value");
+        case 4:
+            return QObject::tr("32-bit value (int / float)");
+        case 8:
+            return QObject::tr("64-bit value (int / double)");
+        default:
+            return QObject::tr("%1 bytes").arg(size);
+        }
+    }
+};
+
+// Read a copy of the object back from data to find its field layout.  The
+// copy is read into a scratch manager, so its key never replaces the live
+// object's.  If reading fails, the fields up to that point are kept.
+static QVector<QHexWidget::Annotation> readFieldLayout(const QByteArray& data,
+                                                       PlasmaVer ver)
+{
+    FieldRecorder S;
+    S.setVer(ver);
+    S.write(data.size(), data.data());
+    S.rewind();
+    try {
+        plResManager scratch(ver);
+        std::unique_ptr<plCreatable> parsed(scratch.ReadCreatable(&S));
+    } catch (std::exception&) { }
+    return S.fFields;
+}
 
 class SelectableLabel : public QLabel
 {
@@ -36,131 +138,314 @@ public:
 };
 
 QHexViewer::QHexViewer(plCreatable* pCre, QWidget* parent)
-    : QCreatable(pCre, kHex_Type | pCre->ClassIndex(), parent)
+    : QCreatable(pCre, kHex_Type | pCre->ClassIndex(), parent),
+      fFileOffset(), fFileSize(), fLayoutSize(), fSearchPending(), fSearchAll(),
+      fSearchLength()
 {
     fViewer = new QHexWidget(this);
     connect(fViewer, &QHexWidget::currentAddressChanged,
             this, &QHexViewer::cursorChanged);
+    connect(fViewer, &QHexWidget::dataEdited, this, &QHexViewer::dataEdited);
+
+    QToolBar* tbar = new QToolBar(this);
+    tbar->setToolButtonStyle(Qt::ToolButtonTextBesideIcon);
+    fEditAction = tbar->addAction(tr("&Edit Bytes"));
+    fEditAction->setCheckable(true);
+    fApplyAction = tbar->addAction(qStdIcon("document-save"),
+            tr("&Apply to Object"), this, &QHexViewer::applyEdits);
+    tbar->addSeparator();
+    fUndoAction = tbar->addAction(qStdIcon("edit-undo"), tr("&Undo"),
+                                  fViewer, &QHexWidget::undo);
+    fRedoAction = tbar->addAction(qStdIcon("edit-redo"), tr("&Redo"),
+                                  fViewer, &QHexWidget::redo);
+    connect(fEditAction, &QAction::toggled, this, &QHexViewer::editToggled);
 
-    QLabel* i32Label = new QLabel(tr("32-bit int: "), this);
-    fI32Val = new SelectableLabel(this);
-    QLabel* i16Label = new QLabel(tr("16-bit int: "), this);
-    fI16Val = new SelectableLabel(this);
-    QLabel* i8Label = new QLabel(tr("byte: "), this);
-    fI8Val = new SelectableLabel(this);
+    fDecoderList = new QTreeWidget(this);
+    fDecoderList->setRootIsDecorated(false);
+    fDecoderList->setUniformRowHeights(true);
+    fDecoderList->setHeaderLabels(QStringList() << tr("Type") << tr("Value"));
+    for (const QHexDecoder& decoder : QHexDecoders::all())
+        new QTreeWidgetItem(fDecoderList, QStringList() << decoder.fName);
+    fDecoderList->resizeColumnToContents(0);
     fSigned = new QCheckBox(tr("Signed Ints"), this);
     fSigned->setChecked(true);
-    QLabel* f32Label = new QLabel(tr("float: "), this);
-    fFloatVal = new SelectableLabel(this);
-    QLabel* f64Label = new QLabel(tr("double: "), this);
-    fDoubleVal = new SelectableLabel(this);
     connect(fSigned, &QCheckBox::toggled, this, &QHexViewer::signedChanged);
     QLabel* stringLabel = new QLabel(tr("Encoded string:"), this);
     fStringVal = new SelectableLabel(this);
 
-    QFrame *decoder = new QFrame(this);
-    decoder->setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
+    QWidget* decoder = new QWidget(this);
     QGridLayout* decoderLayout = new QGridLayout(decoder);
-    decoderLayout->setContentsMargins(4, 4, 4, 4);
+    decoderLayout->setContentsMargins(0, 0, 0, 0);
     decoderLayout->setSpacing(4);
-    decoderLayout->addWidget(i32Label, 0, 0, Qt::AlignRight);
-    decoderLayout->addWidget(fI32Val, 0, 1);
-    decoderLayout->addWidget(i16Label, 0, 2, Qt::AlignRight);
-    decoderLayout->addWidget(fI16Val, 0, 3);
-    decoderLayout->addWidget(i8Label, 0, 4, Qt::AlignRight);
-    decoderLayout->addWidget(fI8Val, 0, 5);
-    decoderLayout->addWidget(fSigned, 1, 0, 1, 2, Qt::AlignHCenter);
-    decoderLayout->addWidget(f32Label, 1, 2, Qt::AlignRight);
-    decoderLayout->addWidget(fFloatVal, 1, 3);
-    decoderLayout->addWidget(f64Label, 1, 4, Qt::AlignRight);
-    decoderLayout->addWidget(fDoubleVal, 1, 5);
-    decoderLayout->addWidget(stringLabel, 2, 0, Qt::AlignRight);
-    decoderLayout->addWidget(fStringVal, 2, 1, 1, 5);
+    decoderLayout->addWidget(fDecoderList, 0, 0, 1, 3);
+    decoderLayout->addWidget(fSigned, 1, 0);
+    decoderLayout->addWidget(stringLabel, 1, 1, Qt::AlignRight);
+    decoderLayout->addWidget(fStringVal, 1, 2);
+    decoderLayout->setColumnStretch(2, 1);
 
     fStatusBar = new QStatusBar(this);
     fStatusBar->setSizeGripEnabled(true);
+    fModeLabel = new QLabel(fStatusBar);
+    fStatusBar->addPermanentWidget(fModeLabel);
+    connect(fViewer, &QHexWidget::overwriteModeChanged, this, [this](bool overwrite) {
+        fModeLabel->setText(overwrite ? tr("Overwrite") : tr("Insert"));
+    });
+
+    QWidget* searchBar = new QWidget(this);
+    fSearchText = new QLineEdit(searchBar);
+    fSearchText->setPlaceholderText(tr("Search"));
+    fSearchMode = new QComboBox(searchBar);
+    fSearchMode->addItem(tr("Hex Bytes"), QHexSearch::kHexBytes);
+    fSearchMode->addItem(tr("ASCII"), QHexSearch::kAscii);
+    fSearchMode->addItem(tr("Encoded String"), QHexSearch::kInvertedString);
+    fSearchMode->addItem(tr("32-bit int"), QHexSearch::kInt32);
+    fSearchMode->addItem(tr("float"), QHexSearch::kFloat);
+    QPushButton* findNextButton = new QPushButton(tr("Find &Next"), searchBar);
+    QPushButton* findAllButton = new QPushButton(tr("Find &All"), searchBar);
+    QHBoxLayout* searchLayout = new QHBoxLayout(searchBar);
+    searchLayout->setContentsMargins(4, 0, 4, 0);
+    searchLayout->addWidget(fSearchText, 1);
+    searchLayout->addWidget(fSearchMode);
+    searchLayout->addWidget(findNextButton);
+    searchLayout->addWidget(findAllButton);
+
+    QAction* findAction = new QAction(this);
+    findAction->setShortcut(QKeySequence::Find);
+    findAction->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(findAction);
+    connect(findAction, &QAction::triggered, this, [this] {
+        fSearchText->setFocus();
+        fSearchText->selectAll();
+    });
+    QAction* findNextAction = new QAction(this);
+    findNextAction->setShortcut(QKeySequence::FindNext);
+    findNextAction->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(findNextAction);
+    connect(findNextAction, &QAction::triggered, this, &QHexViewer::findNext);
+    connect(fSearchText, &QLineEdit::returnPressed, this, &QHexViewer::findNext);
+    connect(findNextButton, &QPushButton::clicked, this, &QHexViewer::findNext);
+    connect(findAllButton, &QPushButton::clicked, this, &QHexViewer::findAll);
+    connect(&fSearchWatcher, &QFutureWatcher<QVector<qint64>>::finished,
+            this, &QHexViewer::searchFinished);
 
     QVBoxLayout* layout = new QVBoxLayout(this);
     layout->setContentsMargins(0, 0, 0, 0);
     layout->setSpacing(4);
-    layout->addWidget(fViewer);
-    layout->addWidget(decoder);
+    layout->addWidget(tbar);
+    layout->addWidget(searchBar);
+    QWidget* viewArea = new QWidget(this);
+    QHBoxLayout* viewLayout = new QHBoxLayout(viewArea);
+    viewLayout->setContentsMargins(0, 0, 0, 0);
+    viewLayout->setSpacing(2);
+    viewLayout->addWidget(fViewer);
+    viewLayout->addWidget(new QHexMinimap(fViewer, viewArea));
+    QSplitter* splitter = new QSplitter(Qt::Vertical, this);
+    splitter->addWidget(viewArea);
+    splitter->addWidget(decoder);
+    splitter->setStretchFactor(0, 3);
+    splitter->setStretchFactor(1, 1);
+    splitter->setCollapsible(0, false);
+    layout->addWidget(splitter, 1);
     layout->addWidget(fStatusBar);
     setLayout(layout);
+    updateEditActions();
+}
+
+QHexViewer::~QHexViewer()
+{
+    cancelSearch();
 }
 
 void QHexViewer::loadObject(const QString& filename, uint32_t offset, uint32_t size)
 {
-    QFile fin(filename);
-    if (fin.open(QIODevice::ReadOnly)) {
-        fin.seek(offset);
-        QByteArray data = fin.read(size);
-        fViewer->loadFromData(data);
-    }
-    fin.close();
+    fFilename = filename;
+    fFileOffset = offset;
+    fFileSize = size;
+    reload();
 }
 
-void QHexViewer::cursorChanged(int address)
+void QHexViewer::reload()
 {
-    if (address < fViewer->dataSize()) {
-        uchar byte = fViewer->byteAt(address);
-        if (fSigned->isChecked())
-            fI8Val->setText(QString::number((int)(signed char)byte));
-        else
-            fI8Val->setText(QString::number((unsigned int)byte));
-    } else {
-        fI8Val->setText(tr("N/A"));
-    }
-    if (address + 1 < fViewer->dataSize()) {
-        uint16_t u16val = fViewer->byteAt(address);
-        u16val |= ((uint16_t)fViewer->byteAt(address + 1)) << 8;
-        if (fSigned->isChecked())
-            fI16Val->setText(QString::number((int)(int16_t)u16val));
-        else
-            fI16Val->setText(QString::number((unsigned int)u16val));
-    } else {
-        fI16Val->setText(tr("N/A"));
-    }
-    if (address + 3 < fViewer->dataSize()) {
-        uint32_t u32val = fViewer->byteAt(address);
-        u32val |= ((uint32_t)fViewer->byteAt(address + 1)) << 8;
-        u32val |= ((uint32_t)fViewer->byteAt(address + 2)) << 16;
-        u32val |= ((uint32_t)fViewer->byteAt(address + 3)) << 24;
-        if (fSigned->isChecked())
-            fI32Val->setText(QString::number((int)u32val));
-        else
-            fI32Val->setText(QString::number(u32val));
-
-        float fval;
-        memcpy(&fval, &u32val, sizeof(fval));
-        fFloatVal->setText(QString::number(fval));
-    } else {
-        fI32Val->setText(tr("N/A"));
-        fFloatVal->setText(tr("N/A"));
-    }
-    if (address + 7 < fViewer->dataSize()) {
-        uint64_t u64val = fViewer->byteAt(address);
-        u64val |= ((uint64_t)fViewer->byteAt(address + 1)) << 8;
-        u64val |= ((uint64_t)fViewer->byteAt(address + 2)) << 16;
-        u64val |= ((uint64_t)fViewer->byteAt(address + 3)) << 24;
-        u64val |= ((uint64_t)fViewer->byteAt(address + 4)) << 32;
-        u64val |= ((uint64_t)fViewer->byteAt(address + 5)) << 40;
-        u64val |= ((uint64_t)fViewer->byteAt(address + 6)) << 48;
-        u64val |= ((uint64_t)fViewer->byteAt(address + 7)) << 56;
-
-        double fval;
-        memcpy(&fval, &u64val, sizeof(fval));
-        fDoubleVal->setText(QString::number(fval));
+    cancelSearch();
+
+    // Show the object as it is in memory, which may have unsaved changes
+    // from other editors
+    hsRAMStream S;
+    S.setVer(PrpShopMain::ResManager()->getVer());
+    try {
+        PrpShopMain::ResManager()->WriteCreatable(&S, fCreatable);
+    } catch (std::exception& ex) {
+        fViewer->loadFromFile(fFilename, fFileOffset, fFileSize);
+        fLayoutSize = -1;
+        updateEditActions();
+        fStatusBar->showMessage(tr("Could not write the object, showing the saved copy: %1")
+                                .arg(ex.what()));
+        return;
+    }
+
+    QByteArray written(S.size(), Qt::Uninitialized);
+    S.rewind();
+    S.read(written.size(), written.data());
+
+    // If nothing has changed, map the saved copy rather than holding
+    // onto another one
+    QSharedPointer<QHexFileSource> saved(new QHexFileSource(fFilename, fFileOffset, fFileSize));
+    if (saved->isOpen() && saved->size() == written.size()
+            && saved->read(0, written.size()) == written) {
+        fViewer->setDataSource(saved);
     } else {
-        fDoubleVal->setText(tr("N/A"));
+        fViewer->loadFromData(written);
+        fStatusBar->showMessage(tr("Showing unsaved changes to the object"));
     }
+    fViewer->setAnnotations(readFieldLayout(written, PrpShopMain::ResManager()->getVer()));
+    fLayoutSize = written.size();
+    updateEditActions();
+}
+
+void QHexViewer::applyEdits()
+{
+    QSharedPointer<QHexEditBuffer> edit = fViewer->editBuffer();
+    hsKeyedObject* oldObj = hsKeyedObject::Convert(fCreatable, false);
+    if (!edit || !edit->isModified() || oldObj == NULL)
+        return;
 
-    QPair<int, int> selection = fViewer->selection();
+    plResManager* mgr = PrpShopMain::ResManager();
+    QByteArray data = edit->read(0, edit->size());
+    hsRAMStream S;
+    S.setVer(mgr->getVer());
+    S.write(data.size(), data.data());
+    S.rewind();
+
+    QString error;
+    try {
+        // Parse into a scratch manager first, so a bad edit is caught
+        // before it can touch anything that's loaded
+        plResManager scratch(mgr->getVer());
+        std::unique_ptr<plCreatable> parsed(scratch.ReadCreatable(&S));
+        hsKeyedObject* check = hsKeyedObject::Convert(parsed.get(), false);
+        if (check == NULL || check->ClassIndex() != oldObj->ClassIndex())
+            error = tr("The class index no longer matches %1").arg(oldObj->ClassName());
+        else if (check->getKey()->getUoid() != oldObj->getKey()->getUoid())
+            error = tr("The object's key no longer matches %1")
+                    .arg(st2qstr(oldObj->getKey()->getName()));
+        else if (S.pos() != S.size())
+            error = tr("%1 bytes at the end were not read").arg(S.size() - S.pos());
+    } catch (std::exception& ex) {
+        error = ex.what();
+    }
+    if (!error.isEmpty()) {
+        QMessageBox::critical(this, tr("Error Applying Changes"),
+                              tr("Error: %1").arg(error), QMessageBox::Ok);
+        return;
+    }
+
+    // The edits are read into a fresh object, which only replaces the
+    // loaded one once it has been read in full.  libHSPlasma's readers
+    // don't clear what an object already holds, so reading into the
+    // loaded object could mix the old contents in.  Nothing outside of
+    // the open windows and the texture cache holds the object by pointer
+    // rather than by key.
+    plKey key = oldObj->getKey();
+    S.rewind();
+    S.readShort();      // Class index, checked above
+    std::unique_ptr<hsKeyedObject> newObj(
+            hsKeyedObject::Convert(plFactory::Create(oldObj->ClassIndex())));
+    try {
+        newObj->read(&S, mgr);
+    } catch (std::exception& ex) {
+        // Reading the key may already have bound it to the new copy
+        key->setObj(oldObj);
+        QMessageBox::critical(this, tr("Error Applying Changes"),
+                              tr("Error: %1").arg(ex.what()), QMessageBox::Ok);
+        return;
+    }
+
+    PrpShopMain::Instance()->closeWindows(oldObj, this);
+    QTextureCache::invalidateObject(oldObj);
+    key->setObj(newObj.get());
+    delete oldObj;
+    fCreatable = newObj.release();
+
+    edit->setClean();
+    reload();
+    fStatusBar->showMessage(tr("Changes applied to %1").arg(st2qstr(key->getName())));
+}
+
+void QHexViewer::dataEdited()
+{
+    // Field offsets are only meaningful while the size is unchanged
+    if (fViewer->dataSize() != fLayoutSize) {
+        fViewer->setAnnotations(QVector<QHexWidget::Annotation>());
+        fLayoutSize = -1;
+    }
+    fViewer->clearHighlights();
+    cursorChanged(fViewer->currentAddress());
+    updateEditActions();
+}
+
+void QHexViewer::editToggled(bool editing)
+{
+    fViewer->setReadOnly(!editing);
+    fModeLabel->setText(editing ? (fViewer->isOverwriteMode() ? tr("Overwrite") : tr("Insert"))
+                                : QString());
+    fViewer->setFocus();
+    updateEditActions();
+}
+
+void QHexViewer::updateEditActions()
+{
+    QSharedPointer<QHexEditBuffer> edit = fViewer->editBuffer();
+    fApplyAction->setEnabled(edit && edit->isModified());
+    fUndoAction->setEnabled(edit && edit->canUndo());
+    fRedoAction->setEnabled(edit && edit->canRedo());
+}
+
+void QHexViewer::closeEvent(QCloseEvent* event)
+{
+    QSharedPointer<QHexEditBuffer> edit = fViewer->editBuffer();
+    if (edit && edit->isModified()) {
+        QMessageBox::StandardButton confirm =
+                QMessageBox::question(this, tr("Confirmation"),
+                        tr("Apply your changes to the object before closing?"),
+                        QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
+        if (confirm == QMessageBox::Save) {
+            applyEdits();
+            if (edit->isModified())
+                event->ignore();
+        } else if (confirm == QMessageBox::Cancel) {
+            event->ignore();
+        }
+    }
+}
+
+void QHexViewer::cursorChanged(qint64 address)
+{
+    // Every decoder works from the same span, read once per cursor move
+    QByteArray span;
+    if (address < fViewer->dataSize())
+        span = fViewer->dataSource()->read(address, QHexDecoders::maxSpan());
+
+    QHexDecoder::Context context;
+    context.fSigned = fSigned->isChecked();
+    context.fVer = PrpShopMain::ResManager()->getVer();
+    const QVector<QHexDecoder>& decoders = QHexDecoders::all();
+    for (int i = 0; i < decoders.size() && i < fDecoderList->topLevelItemCount(); ++i) {
+        QString value;
+        if (span.size() >= decoders[i].fMinSize) {
+            value = decoders[i].fDecode((const uchar*)span.constData(),
+                                        qMin(span.size(), decoders[i].fMaxSize),
+                                        context);
+        }
+        fDecoderList->topLevelItem(i)->setText(1, value.isEmpty() ? tr("N/A") : value);
+    }
+
+    QPair<qint64, qint64> selection = fViewer->selection();
     if (selection.first >= 0 && selection.second >= 0) {
-        QByteArray sdata;
-        sdata.reserve(selection.second - selection.first + 1);
-        for (int i = selection.first; i <= selection.second; ++i)
-            sdata.append(~fViewer->byteAt(i));
+        // Don't try to decode a whole multi-gigabyte selection
+        qint64 length = qMin(selection.second - selection.first + 1, Q_INT64_C(4096));
+        QByteArray sdata = fViewer->dataSource()->read(selection.first, length);
+        for (int i = 0; i < sdata.size(); ++i)
+            sdata[i] = ~sdata[i];
 
         fStringVal->setText(QString::fromLatin1(sdata));
     } else {
@@ -170,12 +455,20 @@ void QHexViewer::cursorChanged(int address)
     QString addrText;
     if (selection.first >= 0 && selection.second >= 0) {
         fStatusBar->showMessage(tr("Selection: %1 - %2 (%3 bytes)")
-                        .arg((unsigned int)selection.first, 8, 16, QChar('0'))
-                        .arg((unsigned int)selection.second, 8, 16, QChar('0'))
+                        .arg(selection.first, 8, 16, QChar('0'))
+                        .arg(selection.second, 8, 16, QChar('0'))
                         .arg(selection.second - selection.first + 1));
     } else {
-        fStatusBar->showMessage(tr("Cursor Address: %1")
-                        .arg((unsigned int)address, 8, 16, QChar('0')));
+        const QHexWidget::Annotation* field = fViewer->annotationAt(address);
+        if (field) {
+            fStatusBar->showMessage(tr("Cursor Address: %1    %2 at %3")
+                            .arg(address, 8, 16, QChar('0'))
+                            .arg(field->fLabel)
+                            .arg(field->fStart, 8, 16, QChar('0')));
+        } else {
+            fStatusBar->showMessage(tr("Cursor Address: %1")
+                            .arg(address, 8, 16, QChar('0')));
+        }
     }
 }
 
@@ -183,3 +476,77 @@ void QHexViewer::signedChanged(bool)
 {
     cursorChanged(fViewer->currentAddress());
 }
+
+void QHexViewer::findNext()
+{
+    startSearch(false);
+}
+
+void QHexViewer::findAll()
+{
+    startSearch(true);
+}
+
+void QHexViewer::startSearch(bool all)
+{
+    QHexSearch::Mode mode = (QHexSearch::Mode)fSearchMode->currentData().toInt();
+    QByteArray pattern = QHexSearch::makePattern(fSearchText->text(), mode);
+    if (pattern.isEmpty()) {
+        fStatusBar->showMessage(tr("Invalid search for %1").arg(fSearchMode->currentText()));
+        return;
+    }
+
+    cancelSearch();
+    fSearchPending = true;
+    fSearchAll = all;
+    fSearchLength = pattern.size();
+    fStatusBar->showMessage(tr("Searching..."));
+
+    // The worker holds its own reference, so the data stays valid even if
+    // another object gets loaded before it finishes
+    QSharedPointer<QHexDataSource> data = fViewer->dataSource();
+    qint64 address = fViewer->currentAddress();
+    const QAtomicInt* cancel = &fSearchCancel;
+    fSearchWatcher.setFuture(QtConcurrent::run([data, pattern, address, all, cancel] {
+        if (all)
+            return QHexSearch::findAll(data.data(), pattern, 0, data->size(),
+                                       MAX_SEARCH_HITS, cancel);
+
+        QVector<qint64> hits;
+        qint64 hit = QHexSearch::findNext(data.data(), pattern, address, cancel);
+        if (hit >= 0)
+            hits.append(hit);
+        return hits;
+    }));
+}
+
+void QHexViewer::cancelSearch()
+{
+    fSearchCancel.storeRelease(1);
+    fSearchWatcher.waitForFinished();
+    fSearchCancel.storeRelease(0);
+    fSearchPending = false;
+}
+
+void QHexViewer::searchFinished()
+{
+    if (!fSearchPending)
+        return;
+    fSearchPending = false;
+
+    QVector<qint64> hits = fSearchWatcher.result();
+    if (hits.isEmpty()) {
+        fViewer->clearHighlights();
+        fStatusBar->showMessage(tr("Not found"));
+        return;
+    }
+
+    if (fSearchAll)
+        fViewer->setHighlights(hits, fSearchLength);
+    fViewer->setSelection(hits.first(), hits.first() + fSearchLength - 1);
+    if (fSearchAll) {
+        fStatusBar->showMessage((hits.size() >= MAX_SEARCH_HITS)
+                                ? tr("Found %1 or more matches").arg(hits.size())
+                                : tr("Found %1 matches").arg(hits.size()));
+    }
+}
@@ -18,11 +18,17 @@
 #define _QHEXVIEWER_H
 
 #include "PRP/QCreatable.h"
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include <QAction>
 
 class QHexWidget;
 class QLabel;
 class QCheckBox;
+class QComboBox;
+class QLineEdit;
 class QStatusBar;
+class QTreeWidget;
 
 class QHexViewer : public QCreatable
 {
@@ -30,23 +36,54 @@ class QHexViewer : public QCreatable
 
 protected:
     QHexWidget* fViewer;
-    QLabel* fI32Val;
-    QLabel* fI16Val;
-    QLabel* fI8Val;
-    QLabel* fFloatVal;
-    QLabel* fDoubleVal;
+    QTreeWidget* fDecoderList;
     QLabel* fStringVal;
     QCheckBox* fSigned;
     QStatusBar* fStatusBar;
+    QLabel* fModeLabel;
+
+    QAction* fEditAction;
+    QAction* fApplyAction;
+    QAction* fUndoAction;
+    QAction* fRedoAction;
+    QString fFilename;
+    uint32_t fFileOffset, fFileSize;
+    qint64 fLayoutSize;
+
+    QLineEdit* fSearchText;
+    QComboBox* fSearchMode;
+    QFutureWatcher<QVector<qint64>> fSearchWatcher;
+    QAtomicInt fSearchCancel;
+    bool fSearchPending;
+    bool fSearchAll;
+    int fSearchLength;
 
 public:
     QHexViewer(plCreatable* pCre, QWidget* parent = Q_NULLPTR);
+    ~QHexViewer();
 
     void loadObject(const QString& filename, uint32_t offset, uint32_t size);
 
+public slots:
+    void applyEdits();
+
 private slots:
-    void cursorChanged(int address);
+    void cursorChanged(qint64 address);
     void signedChanged(bool);
+    void findNext();
+    void findAll();
+    void searchFinished();
+    void dataEdited();
+    void editToggled(bool editing);
+
+protected:
+    void closeEvent(QCloseEvent* event) Q_DECL_OVERRIDE;
+
+private:
+    void reload();
+    void updateEditActions();
+    void startSearch(bool all);
+    void cancelSearch();
 };
 
 #endif
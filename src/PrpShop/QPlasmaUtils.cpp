@@ -631,3 +631,9 @@ bool pqHasTargets(plCreatable* c)
 {
     return c->ClassInstance(kModifier);
 }
+
+QMutex& pqJPEGDecoderMutex()
+{
+    static QMutex s_jpegMutex;
+    return s_jpegMutex;
+}
@@ -18,6 +18,7 @@
 #define _PLASMAWIDGETS_H
 
 #include <QIcon>
+#include <QMutex>
 #include <vector>
 #include <ResManager/pdUnifiedTypeMap.h>
 #include <PRP/plCreatable.h>
@@ -49,4 +50,8 @@ std::vector<short> pqGetValidKOTypes();
 bool pqCanPreviewType(plCreatable* pCre);
 bool pqHasTargets(plCreatable* c);
 
+// libHSPlasma decodes every JPEG mipmap through a single shared decoder,
+// so DecompressImage() on a JPEG texture must be called with this held
+QMutex& pqJPEGDecoderMutex();
+
 #endif
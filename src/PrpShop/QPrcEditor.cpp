@@ -25,15 +25,31 @@
 #include <QSettings>
 #include <QMessageBox>
 #include <QCloseEvent>
+#include <QTextBlock>
+#include <QTimer>
+#include <QRegularExpression>
+#include <QCryptographicHash>
 #include <ResManager/plResManager.h>
 #include <Stream/hsRAMStream.h>
 #include <PRP/KeyedObject/hsKeyedObject.h>
 #include "QPlasma.h"
+#include "QPrcHighlighter.h"
+#include "QTextureCache.h"
 #include "Main.h"
 
+// Documents larger than this (in bytes of PRC source) skip the full syntax
+// highlighter and are loaded a chunk at a time
+#define LARGE_DOCUMENT_SIZE (1024 * 1024)
+#define FIRST_CHUNK_SIZE    (64 * 1024)
+#define LOAD_CHUNK_SIZE     (512 * 1024)
+
+// Shorter hex payloads are left unfolded
+#define MIN_FOLD_LINES      8
+
 QPrcEditor::QPrcEditor(plCreatable* pCre, QWidget* parent)
     : QCreatable(pCre, kPRC_Type | pCre->ClassIndex(), parent),
-      fLexersInited(false)
+      fDirty(false), fLexersInited(false), fLargeDocument(false),
+      fLargeHighlighter(Q_NULLPTR), fPendingPos(0)
 {
     fEditor = new QPlasmaTextEdit(this);
     fEditor->setIndentationMode(SyntaxTextEdit::IndentTabs);
@@ -42,6 +58,15 @@ QPrcEditor::QPrcEditor(plCreatable* pCre, QWidget* parent)
     tbar->setToolButtonStyle(Qt::ToolButtonTextBesideIcon);
     fSaveAction = tbar->addAction(qStdIcon("document-save"),
             tr("Compile and &Save"), this, &QPrcEditor::compilePrc);
+    fFoldAction = tbar->addAction(tr("Fold &Binary Data"));
+    fFoldAction->setCheckable(true);
+    fFoldAction->setChecked(true);
+    fFoldAction->setVisible(false);
+    connect(fFoldAction, &QAction::toggled, this, &QPrcEditor::foldPayloads);
+
+    fLoadTimer = new QTimer(this);
+    fLoadTimer->setInterval(0);
+    connect(fLoadTimer, &QTimer::timeout, this, &QPrcEditor::loadNextChunk);
 
     fStatusBar = new QStatusBar(this);
     fStatusBar->setSizeGripEnabled(true);
@@ -84,19 +109,332 @@ QSize QPrcEditor::sizeHint() const
 
 void QPrcEditor::loadPrcData()
 {
-    hsRAMStream* S = new hsRAMStream();
-    pfPrcHelper* prc = new pfPrcHelper(S);
-    fCreatable->prcWrite(prc);
+    hsRAMStream S;
+    pfPrcHelper prc(&S);
+    fCreatable->prcWrite(&prc);
+
+    QByteArray data(S.size(), Qt::Uninitialized);
+    S.rewind();
+    S.read(data.size(), data.data());
+
+    fLoadTimer->stop();
+    bool large = data.size() > LARGE_DOCUMENT_SIZE;
+    if (large != fLargeDocument) {
+        fLargeDocument = large;
+        fFoldAction->setVisible(large);
+        delete fLargeHighlighter;
+        fLargeHighlighter = Q_NULLPTR;
+        updateSettings();
+    }
+
+    QString text = QString::fromUtf8(data);
+    recordElements(text);
+    if (!fLargeDocument) {
+        fEditor->document()->setUndoRedoEnabled(true);
+        fEditor->setReadOnly(false);
+        fEditor->setPlainText(text);
+        return;
+    }
+
+    // Show the first screenful right away, and append the rest from the
+    // event loop so the window doesn't block while the document is built
+    fPendingText = text;
+    fPendingPos = 0;
+    fEditor->document()->setUndoRedoEnabled(false);
+    fEditor->setReadOnly(true);
+    fEditor->setPlainText(nextChunk(FIRST_CHUNK_SIZE));
+    if (fLargeHighlighter == Q_NULLPTR)
+        fLargeHighlighter = new QPrcHighlighter(fEditor);
+    fSaveAction->setEnabled(false);
+    fLoadTimer->start();
+}
+
+bool QPrcEditor::isLoading() const
+{
+    return fLoadTimer->isActive();
+}
+
+QString QPrcEditor::nextChunk(int size)
+{
+    // End each chunk on a line break, so lines are never split across inserts
+    int end = fPendingPos + size;
+    if (end >= fPendingText.size()) {
+        end = fPendingText.size();
+    } else {
+        int lineEnd = fPendingText.indexOf('\n', end);
+        end = (lineEnd < 0) ? fPendingText.size() : lineEnd + 1;
+    }
+    QString chunk = fPendingText.mid(fPendingPos, end - fPendingPos);
+    fPendingPos = end;
+    return chunk;
+}
+
+void QPrcEditor::loadNextChunk()
+{
+    QTextCursor cursor(fEditor->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(nextChunk(LOAD_CHUNK_SIZE));
+
+    if (fPendingPos < fPendingText.size()) {
+        fStatusBar->showMessage(tr("Loading... %1%")
+                                .arg((qint64)fPendingPos * 100 / fPendingText.size()));
+        return;
+    }
+
+    fLoadTimer->stop();
+    fPendingText.clear();
+    fPendingPos = 0;
+    fEditor->document()->setUndoRedoEnabled(true);
+    fEditor->setReadOnly(false);
+    fEditor->document()->setModified(false);
+    fStatusBar->showMessage(tr("Large document: only the visible lines are highlighted"));
+    foldPayloads(fFoldAction->isChecked());
+}
+
+// Hex dumps from pfPrcHelper are lines of whitespace-separated byte pairs
+static bool isPayloadLine(const QString& text)
+{
+    int digits = 0;
+    bool any = false;
+    for (QChar ch : text) {
+        if (ch.isSpace()) {
+            if (digits != 0 && digits != 2)
+                return false;
+            digits = 0;
+        } else if ((ch >= '0' && ch <= '9') || (ch >= 'A' && ch <= 'F')
+                   || (ch >= 'a' && ch <= 'f')) {
+            if (++digits > 2)
+                return false;
+            any = true;
+        } else {
+            return false;
+        }
+    }
+    return any && (digits == 0 || digits == 2);
+}
+
+void QPrcEditor::foldPayloads(bool fold)
+{
+    // Applied once the document finishes loading
+    if (!fLargeDocument || isLoading())
+        return;
+
+    QTextDocument* doc = fEditor->document();
+    int hidden = 0;
+    QTextBlock block = doc->begin();
+    while (block.isValid()) {
+        block.setVisible(true);
+        if (!isPayloadLine(block.text())) {
+            block = block.next();
+            continue;
+        }
+
+        // The first line of each payload stays visible to stand in for it
+        QTextBlock first = block.next();
+        int count = 0;
+        for (block = first; block.isValid() && isPayloadLine(block.text()); block = block.next())
+            ++count;
+        bool hide = fold && count >= MIN_FOLD_LINES;
+        for (QTextBlock line = first; line != block; line = line.next())
+            line.setVisible(!hide);
+        if (hide)
+            hidden += count;
+    }
+    doc->markContentsDirty(0, doc->characterCount());
+    fLargeHighlighter->rehighlight();
+
+    QTextCursor cursor = fEditor->textCursor();
+    if (!cursor.block().isVisible()) {
+        QTextBlock visible = cursor.block();
+        while (!visible.isVisible())
+            visible = visible.previous();
+        cursor.setPosition(visible.position());
+        fEditor->setTextCursor(cursor);
+    }
+    fEditor->viewport()->update();
+
+    if (hidden > 0)
+        fStatusBar->showMessage(tr("%1 lines of binary data folded").arg(hidden));
+}
+
+struct PrcElements
+{
+    QString fRootName;
+    int fRootEnd;                       // End of the root's start tag
+    QVector<QPair<int, int>> fRanges;   // Start and length of each element
+};
+
+struct PrcError
+{
+    QString fMessage;
+    int fPosition, fLength;
+};
 
-    S->rewind();
-    size_t dataSize = S->size() - S->pos();
-    unsigned char* buf = new unsigned char[dataSize];
-    S->read(dataSize, buf);
+// Finds the elements directly below the document's root, with a cheap scan
+// of the tags rather than a full parse.  The scan also checks that the tags
+// nest properly, since pfPrcParser doesn't say where it failed; if they
+// don't, the problem is described in error.
+static bool scanElements(const QString& text, PrcElements& elements,
+                         PrcError* error = Q_NULLPTR)
+{
+    auto fail = [error](const QString& message, int position, int length) {
+        if (error) {
+            error->fMessage = message;
+            error->fPosition = position;
+            error->fLength = length;
+        }
+        return false;
+    };
+
+    const int size = text.size();
+    QVector<QPair<QString, int>> open;
+    int pos = 0;
+    elements.fRootEnd = -1;
+    elements.fRanges.clear();
+    while ((pos = text.indexOf('<', pos)) >= 0) {
+        if (text.midRef(pos, 4) == QLatin1String("<!--")) {
+            int end = text.indexOf(QLatin1String("-->"), pos + 4);
+            if (end < 0)
+                return fail(QObject::tr("Unterminated comment"), pos, 4);
+            pos = end + 3;
+            continue;
+        }
+
+        int end = pos + 1;
+        bool quoted = false;
+        while (end < size && (quoted || text[end] != '>')) {
+            if (text[end] == '"')
+                quoted = !quoted;
+            ++end;
+        }
+        if (end >= size)
+            return fail(QObject::tr("Unterminated tag"), pos, 1);
+
+        const int tagLength = end + 1 - pos;
+        const bool closing = (text[pos + 1] == '/');
+        int nameEnd = closing ? pos + 2 : pos + 1;
+        while (nameEnd < end && !text[nameEnd].isSpace() && text[nameEnd] != '/')
+            ++nameEnd;
+        const int nameStart = closing ? pos + 2 : pos + 1;
+        const QString name = text.mid(nameStart, nameEnd - nameStart);
+
+        if (text[pos + 1] == '?') {
+            // Processing instructions aren't elements
+        } else if (closing) {
+            if (open.isEmpty())
+                return fail(QObject::tr("Unexpected closing tag </%1>").arg(name), pos, tagLength);
+            if (open.last().first != name) {
+                return fail(QObject::tr("Expected </%1> but found </%2>")
+                            .arg(open.last().first).arg(name), pos, tagLength);
+            }
+            int start = open.takeLast().second;
+            if (open.size() == 1)
+                elements.fRanges.append(qMakePair(start, end + 1 - start));
+        } else {
+            if (open.isEmpty()) {
+                if (elements.fRootEnd >= 0)
+                    return fail(QObject::tr("Unexpected second root element <%1>").arg(name), pos, tagLength);
+                elements.fRootName = name;
+                elements.fRootEnd = end + 1;
+            }
+            if (text[end - 1] == '/') {
+                if (open.size() == 1)
+                    elements.fRanges.append(qMakePair(pos, tagLength));
+            } else {
+                open.append(qMakePair(name, pos));
+            }
+        }
+        pos = end + 1;
+    }
+
+    if (!open.isEmpty()) {
+        return fail(QObject::tr("Element <%1> is never closed").arg(open.last().first),
+                    open.last().second, open.last().first.size() + 1);
+    }
+    if (elements.fRootEnd < 0)
+        return fail(QObject::tr("No root element"), 0, 0);
+    return true;
+}
+
+// pfPrcParser and prcParse exceptions don't carry a source position, so
+// narrow down where in the failed element the error is from the message:
+// either a line number from the parser, or the name of a tag
+static void locateError(const QString& text, const QPair<int, int>& range,
+                        int lineOffset, PrcError& error)
+{
+    const QStringRef element = text.midRef(range.first, range.second);
+    error.fPosition = range.first;
+
+    QRegularExpressionMatch lineMatch =
+            QRegularExpression("line (\\d+)", QRegularExpression::CaseInsensitiveOption)
+            .match(error.fMessage);
+    int line = lineMatch.hasMatch() ? lineMatch.captured(1).toInt() - lineOffset : -1;
+    if (line >= 0) {
+        int offset = 0;
+        while (line-- > 0 && offset >= 0) {
+            offset = element.indexOf('\n', offset);
+            if (offset >= 0)
+                ++offset;
+        }
+        if (offset >= 0) {
+            while (offset < element.size() && element.at(offset).isSpace())
+                ++offset;
+            error.fPosition = range.first + offset;
+        }
+    } else {
+        QRegularExpressionMatchIterator words =
+                QRegularExpression("[A-Za-z_][A-Za-z0-9_]*").globalMatch(error.fMessage);
+        bool found = false;
+        while (words.hasNext() && !found) {
+            QString tag = "<" + words.next().captured();
+            for (int offset = element.indexOf(tag); offset >= 0 && !found;
+                 offset = element.indexOf(tag, offset + 1)) {
+                int after = offset + tag.size();
+                if (after < element.size() && (element.at(after).isSpace()
+                        || element.at(after) == '>' || element.at(after) == '/')) {
+                    error.fPosition = range.first + offset;
+                    found = true;
+                }
+            }
+        }
+    }
 
-    QString data = QString::fromUtf8((const char*)buf, dataSize);
-    delete[] buf;
+    // Mark the start tag at that position
+    int tagEnd = text.indexOf('>', error.fPosition);
+    int lineEnd = text.indexOf('\n', error.fPosition);
+    if (tagEnd < 0)
+        tagEnd = text.size() - 1;
+    if (lineEnd >= 0 && lineEnd < tagEnd)
+        tagEnd = lineEnd - 1;
+    error.fLength = tagEnd + 1 - error.fPosition;
+}
 
-    fEditor->setPlainText(data);
+static QByteArray textHash(const QStringRef& text)
+{
+    return QCryptographicHash::hash(QByteArray::fromRawData((const char*)text.unicode(),
+                                                            text.size() * sizeof(QChar)),
+                                    QCryptographicHash::Sha1);
+}
+
+void QPrcEditor::recordElements(const QString& text, int count)
+{
+    // With a count, only the first count elements have been applied, so
+    // the rest keep their previous text
+    PrcElements elements;
+    if (!scanElements(text, elements)) {
+        fRootHash.clear();
+        fElementHashes.clear();
+        return;
+    }
+
+    fRootHash = textHash(text.leftRef(elements.fRootEnd));
+    if (count < 0) {
+        count = elements.fRanges.size();
+        fElementHashes.resize(count);
+    }
+    for (int i = 0; i < count; ++i)
+        fElementHashes[i] = textHash(text.midRef(elements.fRanges[i].first,
+                                                 elements.fRanges[i].second));
 }
 
 void QPrcEditor::updateSettings()
@@ -108,14 +446,14 @@ void QPrcEditor::updateSettings()
                    settings.value("SciFontItalic", false).toBool());
 
     fEditor->setFont(textFont);
-    fEditor->setSyntax("XML");
+    fEditor->setSyntax(fLargeDocument ? QString() : QStringLiteral("XML"));
     fEditor->setWordWrapMode(QTextOption::NoWrap);
 
     fEditor->setTabWidth(settings.value("SciTabWidth", 4).toInt());
     fEditor->setAutoIndent(settings.value("SciAutoIndent", true).toBool());
 
     fEditor->setShowLineNumbers(settings.value("SciLineNumberMargin", true).toBool());
-    fEditor->setShowFolding(settings.value("SciFoldMargin", false).toBool());
+    fEditor->setShowFolding(!fLargeDocument && settings.value("SciFoldMargin", false).toBool());
 }
 
 void QPrcEditor::showCursorPosition()
@@ -128,30 +466,114 @@ void QPrcEditor::showCursorPosition()
 
 void QPrcEditor::onModificationChanged(bool changed)
 {
+    // Appending chunks of a large document isn't a modification
+    if (isLoading())
+        return;
+
     fDirty = changed;
     fSaveAction->setEnabled(fDirty);
 }
 
 void QPrcEditor::compilePrc()
 {
-    pfPrcParser parser;
-    hsRAMStream S;
-    QByteArray data = fEditor->toPlainText().toUtf8();
-    S.write(data.size(), data.data());
-    S.rewind();
+    if (isLoading())
+        return;
 
-    try {
-        parser.read(&S);
-        fCreatable->prcParse(parser.getRoot(), PrpShopMain::ResManager());
-    } catch (hsException& e) {
-        // TODO: Get file and line from PRC source where the exception occurred
-        QMessageBox::critical(this, tr("Compile Error"),
-                QString("Error: %1").arg(e.what()));
+    QString text = fEditor->toPlainText();
+    PrcElements elements;
+    PrcError error;
+    if (!scanElements(text, elements, &error)) {
+        showCompileError(error.fPosition, error.fLength, error.fMessage);
         return;
     }
 
-    // If we succeeded, replace the editor contents with the compiled source
-    loadPrcData();
+    // plCreatable::prcParse applies each child of the root in order, so
+    // they're compiled one at a time, which tells us where a failure is.
+    // A child can depend on state set by the ones before it (such as the
+    // metrics ahead of a texture's image data), and libHSPlasma doesn't
+    // say which ones do.  So if the document still has the same shape,
+    // only the unchanged elements ahead of the first edit are skipped, and
+    // everything from there on is applied again.  Otherwise the whole
+    // document is.  Edits near the end of a large object are cheap; an
+    // edit to its first element still costs a full compile.
+    bool incremental = !fRootHash.isEmpty()
+            && elements.fRanges.size() == fElementHashes.size()
+            && textHash(text.leftRef(elements.fRootEnd)) == fRootHash;
+    int first = 0;
+    if (incremental) {
+        while (first < elements.fRanges.size()
+                && textHash(text.midRef(elements.fRanges[first].first,
+                                        elements.fRanges[first].second))
+                   == fElementHashes[first])
+            ++first;
+    }
+
+    const QString rootTag = text.left(elements.fRootEnd) + '\n';
+    const QString rootClose = QString("\n</%1>\n").arg(elements.fRootName);
+    const int rootLines = rootTag.count('\n');
+    int changed = 0;
+    for (int i = first; i < elements.fRanges.size(); ++i) {
+        QStringRef element = text.midRef(elements.fRanges[i].first,
+                                         elements.fRanges[i].second);
+
+        pfPrcParser parser;
+        hsRAMStream S;
+        QString source = rootTag;
+        source += element;
+        source += rootClose;
+        QByteArray data = source.toUtf8();
+        S.write(data.size(), data.data());
+        S.rewind();
+
+        try {
+            parser.read(&S);
+            fCreatable->prcParse(parser.getRoot(), PrpShopMain::ResManager());
+        } catch (hsException& e) {
+            // Elements before this one have already been applied
+            QTextureCache::invalidateObject(fCreatable);
+            if (incremental) {
+                recordElements(text, i);
+            } else {
+                fRootHash.clear();
+                fElementHashes.clear();
+            }
+            error.fMessage = e.what();
+            locateError(text, elements.fRanges[i], rootLines + 1, error);
+            showCompileError(error.fPosition, error.fLength, error.fMessage);
+            return;
+        }
+        ++changed;
+    }
+    QTextureCache::invalidateObject(fCreatable);
+
+    fEditor->clearErrorMarker();
+    if (incremental) {
+        // The rest of the document is already up to date, so keep the
+        // text as written instead of regenerating all of it
+        recordElements(text);
+        fEditor->document()->setModified(false);
+        fStatusBar->showMessage(tr("Compiled %1 of %2 elements")
+                                .arg(changed).arg(elements.fRanges.size()));
+    } else {
+        // If we succeeded, replace the editor contents with the compiled source
+        loadPrcData();
+    }
+}
+
+void QPrcEditor::showCompileError(int position, int length, const QString& message)
+{
+    QTextCursor cursor(fEditor->document());
+    cursor.setPosition(qMin(position, fEditor->document()->characterCount() - 1));
+    if (!cursor.block().isVisible())
+        fFoldAction->setChecked(false);
+    fEditor->setTextCursor(cursor);
+    fEditor->centerCursor();
+    fEditor->setErrorMarker(position, length);
+
+    QMessageBox::critical(this, tr("Compile Error"),
+            tr("Error at line %1, column %2:\n%3")
+            .arg(cursor.blockNumber() + 1).arg(cursor.positionInBlock() + 1)
+            .arg(message));
 }
 
 void QPrcEditor::closeEvent(QCloseEvent* event)
@@ -23,6 +23,8 @@
 #include "QPlasmaUtils.h"
 
 class QStatusBar;
+class QTimer;
+class QPrcHighlighter;
 
 class QPrcEditor : public QCreatable
 {
@@ -31,11 +33,25 @@ class QPrcEditor : public QCreatable
 protected:
     QPlasmaTextEdit* fEditor;
     QAction* fSaveAction;
+    QAction* fFoldAction;
     QStatusBar *fStatusBar;
     bool fDirty;
     bool fLexersInited;
     bool fDoLineNumbers;
 
+    // Large documents are loaded in chunks and use a lighter highlighter
+    bool fLargeDocument;
+    QPrcHighlighter* fLargeHighlighter;
+    QTimer* fLoadTimer;
+    QString fPendingText;
+    int fPendingPos;
+
+    // SHA-1 of the root tag and of each element directly below it, as of
+    // the last load or compile, so a compile can skip what hasn't changed
+    // without keeping a second copy of the document
+    QByteArray fRootHash;
+    QVector<QByteArray> fElementHashes;
+
 public:
     explicit QPrcEditor(plCreatable* pCre, QWidget* parent = Q_NULLPTR);
 
@@ -67,10 +83,16 @@ signals:
 private slots:
     void showCursorPosition();
     void onModificationChanged(bool changed);
+    void loadNextChunk();
+    void foldPayloads(bool fold);
 
 protected:
     void closeEvent(QCloseEvent* event) Q_DECL_OVERRIDE;
     void loadPrcData();
+    bool isLoading() const;
+    QString nextChunk(int size);
+    void recordElements(const QString& text, int count = -1);
+    void showCompileError(int position, int length, const QString& message);
 };
 
 #endif
@@ -0,0 +1,150 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "QPrcHighlighter.h"
+#include <QPlainTextEdit>
+#include <QTextBlock>
+#include <QTimer>
+
+enum { kUnformatted = -1, kFormatted = 1 };
+
+QPrcHighlighter::QPrcHighlighter(QPlainTextEdit* editor)
+    : QObject(editor), fEditor(editor), fPending()
+{
+    fTagFormat.setForeground(QColor(0x00, 0x00, 0xA0));
+    fAttrFormat.setForeground(QColor(0x80, 0x00, 0x80));
+    fValueFormat.setForeground(QColor(0xB0, 0x20, 0x20));
+    fCommentFormat.setForeground(QColor(0x80, 0x80, 0x80));
+    fCommentFormat.setFontItalic(true);
+    fFoldFormat.setBackground(QColor(0xE8, 0xE8, 0xE8));
+    fFoldFormat.setFontUnderline(true);
+
+    connect(fEditor, &QPlainTextEdit::updateRequest,
+            this, &QPrcHighlighter::scheduleUpdate);
+    connect(fEditor->document(), &QTextDocument::contentsChange,
+            this, &QPrcHighlighter::contentsChange);
+    scheduleUpdate();
+}
+
+void QPrcHighlighter::rehighlight()
+{
+    for (QTextBlock block = fEditor->document()->begin(); block.isValid(); block = block.next())
+        block.setUserState(kUnformatted);
+    scheduleUpdate();
+}
+
+void QPrcHighlighter::scheduleUpdate()
+{
+    // Formatting marks the blocks dirty, which requests another update;
+    // deferring it keeps that from recursing
+    if (!fPending) {
+        fPending = true;
+        QTimer::singleShot(0, this, &QPrcHighlighter::highlightVisible);
+    }
+}
+
+void QPrcHighlighter::highlightVisible()
+{
+    fPending = false;
+
+    QTextDocument* doc = fEditor->document();
+    QTextBlock block = fEditor->cursorForPosition(QPoint(0, 0)).block();
+    QTextBlock last = fEditor->cursorForPosition(QPoint(0, fEditor->viewport()->height())).block();
+    for ( ; block.isValid(); block = block.next()) {
+        if (block.isVisible() && block.userState() != kFormatted) {
+            bool folded = block.next().isValid() && !block.next().isVisible();
+            block.layout()->setFormats(formatLine(block.text(), folded));
+            block.setUserState(kFormatted);
+            doc->markContentsDirty(block.position(), block.length());
+        }
+        if (block == last)
+            break;
+    }
+}
+
+void QPrcHighlighter::contentsChange(int position, int, int added)
+{
+    QTextDocument* doc = fEditor->document();
+    QTextBlock block = doc->findBlock(position);
+    QTextBlock last = doc->findBlock(position + added);
+    for ( ; block.isValid(); block = block.next()) {
+        block.setUserState(kUnformatted);
+        if (block == last)
+            break;
+    }
+    scheduleUpdate();
+}
+
+QVector<QTextLayout::FormatRange> QPrcHighlighter::formatLine(const QString& text,
+                                                               bool folded) const
+{
+    QVector<QTextLayout::FormatRange> ranges;
+    auto add = [&ranges](int start, int length, const QTextCharFormat& format) {
+        QTextLayout::FormatRange range;
+        range.start = start;
+        range.length = length;
+        range.format = format;
+        ranges.append(range);
+    };
+
+    // The first line of a folded payload is marked so it's clear there's
+    // more data hidden below it
+    if (folded)
+        add(0, text.size(), fFoldFormat);
+
+    const int size = text.size();
+    int pos = 0;
+    while (pos < size) {
+        if (text.midRef(pos, 4) == QLatin1String("<!--")) {
+            int end = text.indexOf(QLatin1String("-->"), pos + 4);
+            end = (end < 0) ? size : end + 3;
+            add(pos, end - pos, fCommentFormat);
+            pos = end;
+        } else if (text[pos] == '<') {
+            int start = pos++;
+            while (pos < size && !text[pos].isSpace() && text[pos] != '>'
+                   && (text[pos] != '/' || pos == start + 1))
+                ++pos;
+            add(start, pos - start, fTagFormat);
+
+            while (pos < size && text[pos] != '>') {
+                if (text[pos] == '"') {
+                    int end = text.indexOf('"', pos + 1);
+                    end = (end < 0) ? size : end + 1;
+                    add(pos, end - pos, fValueFormat);
+                    pos = end;
+                } else if (text[pos].isLetter()) {
+                    int start = pos;
+                    while (pos < size && (text[pos].isLetterOrNumber() || text[pos] == '_'
+                                          || text[pos] == ':' || text[pos] == '-'))
+                        ++pos;
+                    add(start, pos - start, fAttrFormat);
+                } else if (text[pos] == '/' || text[pos] == '?') {
+                    add(pos++, 1, fTagFormat);
+                } else {
+                    ++pos;
+                }
+            }
+            if (pos < size)
+                add(pos++, 1, fTagFormat);
+        } else {
+            int next = text.indexOf('<', pos);
+            pos = (next < 0) ? size : next;
+        }
+    }
+    return ranges;
+}
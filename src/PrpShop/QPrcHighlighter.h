@@ -0,0 +1,55 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _QPRCHIGHLIGHTER_H
+#define _QPRCHIGHLIGHTER_H
+
+#include <QObject>
+#include <QTextCharFormat>
+#include <QTextLayout>
+
+class QPlainTextEdit;
+
+/* A minimal PRC (XML) highlighter for documents too large for the full
+ * syntax highlighter.  Only the blocks currently on screen are formatted;
+ * the rest are formatted when they are scrolled into view.  PRC is written
+ * one element per line, so each line is highlighted on its own. */
+class QPrcHighlighter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QPrcHighlighter(QPlainTextEdit* editor);
+
+    // Discard all formatting, e.g. after blocks were shown or hidden
+    void rehighlight();
+
+private slots:
+    void scheduleUpdate();
+    void highlightVisible();
+    void contentsChange(int position, int removed, int added);
+
+private:
+    QPlainTextEdit* fEditor;
+    QTextCharFormat fTagFormat, fAttrFormat, fValueFormat, fCommentFormat;
+    QTextCharFormat fFoldFormat;
+    bool fPending;
+
+    QVector<QTextLayout::FormatRange> formatLine(const QString& text, bool folded) const;
+};
+
+#endif
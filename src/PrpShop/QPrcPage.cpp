@@ -0,0 +1,165 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "QPrcPage.h"
+#include <QFile>
+#include <set>
+#include <Debug/hsExceptions.hpp>
+#include <Stream/hsStream.h>
+#include <Stream/pfPrcHelper.h>
+#include <Stream/pfPrcParser.h>
+#include <ResManager/plFactory.h>
+#include <PRP/KeyedObject/hsKeyedObject.h>
+#include "QPlasma.h"
+#include "QTextureCache.h"
+
+// Objects are written straight to the file one at a time, so memory use
+// doesn't grow with the page.  This can't be spread over worker threads:
+// prcWrite copies plKeys, whose reference counts are not atomic, and
+// objects in a page share many of the same keys.
+static void writeObject(pfPrcHelper& prc, const plKey& key)
+{
+    try {
+        prc.startTag("Object");
+        prc.writeParam("Type", plFactory::ClassName(key->getType()));
+        prc.writeParam("Name", key->getName());
+        prc.endTag();
+        key->getObj()->prcWrite(&prc);
+        prc.closeTag();
+    } catch (std::exception& ex) {
+        QString error = QString("%1: %2").arg(st2qstr(key->getName())).arg(ex.what());
+        throw hsBadParamException(__FILE__, __LINE__, error.toUtf8().constData());
+    }
+}
+
+static QList<plKey> pageObjects(plResManager* mgr, const plLocation& loc)
+{
+    QList<plKey> keys;
+    for (short type : mgr->getTypes(loc, true)) {
+        for (const plKey& key : mgr->getKeys(loc, type, true)) {
+            if (key.isLoaded())
+                keys.append(key);
+        }
+    }
+    return keys;
+}
+
+bool pqExportPagePrc(plResManager* mgr, plPageInfo* page,
+                     const QString& filename, const PrcPageProgress& progress)
+{
+    QList<plKey> keys = pageObjects(mgr, page->getLocation());
+
+    bool cancelled = false;
+    try {
+        hsFileStream S((int)mgr->getVer());
+        if (!S.open(qstr2st(filename), fmCreate))
+            throw hsFileWriteException(__FILE__, __LINE__, filename.toUtf8().constData());
+
+        pfPrcHelper prc(&S);
+        prc.startTag("PlasmaPage");
+        prc.writeParam("Age", page->getAge());
+        prc.writeParam("Page", page->getPage());
+        prc.endTag();
+
+        for (int i = 0; i < keys.size(); ++i) {
+            if (!progress(i, keys.size())) {
+                cancelled = true;
+                break;
+            }
+            writeObject(prc, keys[i]);
+        }
+
+        prc.closeTag();
+    } catch (...) {
+        QFile::remove(filename);
+        throw;
+    }
+
+    if (cancelled) {
+        QFile::remove(filename);
+        return false;
+    }
+    progress(keys.size(), keys.size());
+    return true;
+}
+
+QStringList pqImportPagePrc(plResManager* mgr, plPageInfo* page,
+                            const QString& filename, const PrcPageProgress& progress)
+{
+    // pfPrcParser builds the whole tag tree in memory before anything is
+    // compiled, so a malformed document is rejected before any object in
+    // the page is touched
+    pfPrcParser parser;
+    {
+        hsFileStream S;
+        if (!S.open(qstr2st(filename), fmRead))
+            throw hsFileReadException(__FILE__, __LINE__, filename.toUtf8().constData());
+        parser.read(&S);
+    }
+
+    const pfPrcTag* root = parser.getRoot();
+    if (root == NULL || root->getName() != "PlasmaPage")
+        throw hsBadParamException(__FILE__, __LINE__, "Not a PlasmaPage PRC document");
+
+    size_t total = 0;
+    for (const pfPrcTag* tag = root->getFirstChild(); tag != NULL; tag = tag->getNextSibling())
+        ++total;
+
+    // Objects are matched by type and name.  Names aren't guaranteed to be
+    // unique, so repeated names match the page's objects in order.
+    const plLocation& loc = page->getLocation();
+    std::set<plKey> used;
+    QStringList errors;
+    size_t done = 0;
+    for (const pfPrcTag* tag = root->getFirstChild(); tag != NULL; tag = tag->getNextSibling()) {
+        if (!progress(done++, total))
+            break;
+
+        QString name = st2qstr(tag->getParam("Name", ""));
+        if (tag->getName() != "Object" || !tag->hasChildren()) {
+            errors << QObject::tr("Unexpected <%1> element").arg(st2qstr(tag->getName()));
+            continue;
+        }
+        short type = plFactory::ClassIndex(tag->getParam("Type", "").c_str());
+        plKey key;
+        if (type >= 0) {
+            for (const plKey& k : mgr->getKeys(loc, type, true)) {
+                if (k.isLoaded() && st2qstr(k->getName()) == name && used.count(k) == 0) {
+                    key = k;
+                    break;
+                }
+            }
+        }
+        if (!key.Exists()) {
+            errors << QObject::tr("%1 [%2]: No such object in the page")
+                      .arg(name).arg(st2qstr(tag->getParam("Type", "")));
+            continue;
+        }
+        used.insert(key);
+
+        try {
+            key->getObj()->prcParse(tag->getFirstChild(), mgr);
+        } catch (std::exception& ex) {
+            errors << QString("%1 [%2]: %3").arg(name)
+                      .arg(plFactory::ClassName(type)).arg(ex.what());
+        }
+        QTextureCache::invalidateObject(key->getObj());
+    }
+    progress(total, total);
+
+    return errors;
+}
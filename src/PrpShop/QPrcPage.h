@@ -0,0 +1,43 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _QPRCPAGE_H
+#define _QPRCPAGE_H
+
+#include <QString>
+#include <QStringList>
+#include <ResManager/plResManager.h>
+#include <functional>
+
+/* Whole-page PRC documents: every object in a page, each wrapped in an
+ * <Object Type="..." Name="..."> element under a single <PlasmaPage> root.
+ *
+ * The progress function is called with the number of objects processed so
+ * far, and returning false from it cancels the operation. */
+typedef std::function<bool(size_t done, size_t total)> PrcPageProgress;
+
+// Returns false if the export was cancelled.  Throws on write errors; in
+// either case the partial file is removed.
+bool pqExportPagePrc(plResManager* mgr, plPageInfo* page,
+                     const QString& filename, const PrcPageProgress& progress);
+
+// Compiles each object in the document back into the matching object of
+// the page, and returns a description of each object that failed
+QStringList pqImportPagePrc(plResManager* mgr, plPageInfo* page,
+                            const QString& filename, const PrcPageProgress& progress);
+
+#endif
@@ -0,0 +1,339 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QTextureAudit.h"
+
+#include <QLabel>
+#include <QPushButton>
+#include <QDialogButtonBox>
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QSplitter>
+#include <QSettings>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QCryptographicHash>
+#include <QTextStream>
+#include <PRP/Surface/plCubicEnvironmap.h>
+#include "PRP/Surface/QMipmap.h"
+#include "QPlasmaUtils.h"
+#include "Main.h"
+
+enum
+{
+    kColAge, kColPage, kColName, kColType, kColSize, kColLevels, kColFormat,
+    kColBytes, kColIssues, kNumColumns
+};
+
+static bool isPow2(unsigned int value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static unsigned int expectedLevels(unsigned int width, unsigned int height,
+                                   bool blockCompressed)
+{
+    // DXT data is stored in 4x4 blocks, so don't require levels smaller
+    // than a single block
+    const unsigned int minSize = blockCompressed ? 4 : 1;
+    unsigned int levels = 1;
+    while (width > minSize || height > minSize) {
+        width = (width > 1) ? (width >> 1) : 1;
+        height = (height > 1) ? (height >> 1) : 1;
+        ++levels;
+    }
+    return levels;
+}
+
+static QString csvQuote(QString field)
+{
+    if (field.contains(',') || field.contains('"') || field.contains('\n'))
+        field = '"' + field.replace("\"", "\"\"") + '"';
+    return field;
+}
+
+QByteArray pqTextureHash(const plMipmap* tex)
+{
+    const uint32_t header[] = {
+        tex->getWidth(), tex->getHeight(), (uint32_t)tex->getNumLevels(),
+        (uint32_t)tex->getCompressionType(),
+        (uint32_t)(tex->getCompressionType() == plBitmap::kDirectXCompression
+                   ? tex->getDXCompression() : tex->getARGBType()),
+    };
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData((const char*)header, sizeof(header));
+    hash.addData((const char*)tex->getImageData(), tex->getTotalSize());
+    return hash.result();
+}
+
+
+/* QTextureAudit */
+QTextureAudit::QTextureAudit(plResManager* mgr, QWidget* parent)
+    : QDialog(parent), fResMgr(mgr)
+{
+    setWindowTitle(tr("Texture Audit"));
+
+    QSettings settings("PlasmaShop", "PrpShop");
+    fMaxSize = new QSpinBox(this);
+    fMaxSize->setRange(1, 0x10000);
+    fMaxSize->setValue(settings.value("AuditMaxSize", 1024).toInt());
+
+    fSummary = new QTreeWidget(this);
+    fSummary->setUniformRowHeights(true);
+    fSummary->setHeaderLabels(QStringList{tr("Age / Format"), tr("Textures"),
+                                          tr("Bytes")});
+
+    fDetails = new QTableWidget(this);
+    fDetails->setColumnCount(kNumColumns);
+    fDetails->setHorizontalHeaderLabels(QStringList{
+            tr("Age"), tr("Page"), tr("Name"), tr("Type"), tr("Size"),
+            tr("Levels"), tr("Format"), tr("Bytes"), tr("Issues")});
+    fDetails->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    fDetails->setSelectionBehavior(QAbstractItemView::SelectRows);
+    fDetails->verticalHeader()->hide();
+    fDetails->horizontalHeader()->setStretchLastSection(true);
+
+    QSplitter* splitter = new QSplitter(Qt::Vertical, this);
+    splitter->addWidget(fSummary);
+    splitter->addWidget(fDetails);
+    splitter->setStretchFactor(1, 1);
+
+    QPushButton* refreshButton = new QPushButton(tr("&Refresh"), this);
+    QDialogButtonBox* buttonBox = new QDialogButtonBox(Qt::Horizontal, this);
+    QPushButton* exportButton = buttonBox->addButton(tr("&Export CSV..."),
+                                                     QDialogButtonBox::ActionRole);
+    buttonBox->addButton(QDialogButtonBox::Close);
+
+    QGridLayout* layout = new QGridLayout(this);
+    layout->setHorizontalSpacing(8);
+    layout->setVerticalSpacing(8);
+    layout->addWidget(new QLabel(tr("Maximum size:"), this), 0, 0);
+    layout->addWidget(fMaxSize, 0, 1);
+    layout->addWidget(refreshButton, 0, 2);
+    layout->addItem(new QSpacerItem(0, 0, QSizePolicy::Expanding), 0, 3);
+    layout->addWidget(splitter, 1, 0, 1, 4);
+    layout->addWidget(buttonBox, 2, 0, 1, 4);
+    resize(800, 600);
+
+    connect(refreshButton, &QPushButton::clicked, this, &QTextureAudit::refresh);
+    connect(exportButton, &QPushButton::clicked, this, &QTextureAudit::exportCsv);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    connect(fDetails, &QTableWidget::cellActivated, this, &QTextureAudit::itemActivated);
+
+    refresh();
+}
+
+void QTextureAudit::scan()
+{
+    fEntries.clear();
+
+    std::vector<plKey> keys;
+    for (const plLocation& loc : fResMgr->getLocations()) {
+        for (short type : { kMipmap, kCubicEnvironmap }) {
+            std::vector<plKey> typeKeys = fResMgr->getKeys(loc, type, true);
+            keys.insert(keys.end(), typeKeys.begin(), typeKeys.end());
+        }
+    }
+
+    QProgressDialog progress(tr("Auditing textures..."), tr("Cancel"),
+                             0, keys.size(), this);
+    progress.setWindowModality(Qt::WindowModal);
+
+    const unsigned int maxSize = fMaxSize->value();
+    QHash<QByteArray, size_t> hashes;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        progress.setValue(i);
+        if (progress.wasCanceled())
+            break;
+        if (!keys[i].isLoaded())
+            continue;
+
+        Entry ent;
+        ent.fKey = keys[i];
+        plPageInfo* page = fResMgr->FindPage(ent.fKey->getLocation());
+        if (page != NULL) {
+            ent.fAge = st2qstr(page->getAge());
+            ent.fPage = st2qstr(page->getPage());
+        }
+
+        // Cube maps are reported as a whole, using the first face for the
+        // dimensions and format (all faces must match anyway)
+        plMipmap* tex = NULL;
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        plCreatable* obj = ent.fKey->getObj();
+        if (plCubicEnvironmap* envMap = plCubicEnvironmap::Convert(obj, false)) {
+            tex = envMap->getFace(0);
+            for (size_t face = 0; face < plCubicEnvironmap::kNumFaces; ++face) {
+                ent.fBytes += envMap->getFace(face)->getTotalSize();
+                hash.addData(pqTextureHash(envMap->getFace(face)));
+            }
+        } else if (plMipmap* mipmap = plMipmap::Convert(obj, false)) {
+            tex = mipmap;
+            ent.fBytes = mipmap->getTotalSize();
+            hash.addData(pqTextureHash(mipmap));
+        }
+        if (tex == NULL)
+            continue;
+
+        ent.fHash = hash.result();
+        ent.fWidth = tex->getWidth();
+        ent.fHeight = tex->getHeight();
+        ent.fLevels = tex->getNumLevels();
+        ent.fFormat = getCompressionText(tex);
+
+        if (!isPow2(ent.fWidth) || !isPow2(ent.fHeight))
+            ent.fIssues << tr("Non-power-of-two");
+        if (ent.fWidth > maxSize || ent.fHeight > maxSize)
+            ent.fIssues << tr("Oversized");
+        if (tex->getCompressionType() != plBitmap::kJPEGCompression
+                && (tex->getFlags() & plBitmap::kForceOneMipLevel) == 0) {
+            unsigned int expected = expectedLevels(ent.fWidth, ent.fHeight,
+                    tex->getCompressionType() == plBitmap::kDirectXCompression);
+            if (ent.fLevels < expected) {
+                ent.fIssues << tr("Missing mip levels (%1 of %2)")
+                               .arg(ent.fLevels).arg(expected);
+            }
+        }
+
+        auto dup = hashes.constFind(ent.fHash);
+        if (dup != hashes.constEnd()) {
+            const Entry& orig = fEntries[dup.value()];
+            ent.fIssues << tr("Duplicate of %1 (%2)")
+                           .arg(st2qstr(orig.fKey->getName())).arg(orig.fPage);
+        } else {
+            hashes.insert(ent.fHash, fEntries.size());
+        }
+        fEntries.push_back(ent);
+    }
+    progress.setValue(keys.size());
+}
+
+void QTextureAudit::populate()
+{
+    fSummary->clear();
+    fDetails->setSortingEnabled(false);
+    fDetails->setRowCount(fEntries.size());
+
+    struct Totals
+    {
+        size_t fCount, fBytes;
+        Totals() : fCount(), fBytes() { }
+    };
+    QMap<QString, QMap<QString, Totals>> ageTotals;
+
+    for (size_t i = 0; i < fEntries.size(); ++i) {
+        const Entry& ent = fEntries[i];
+        Totals& formatTotal = ageTotals[ent.fAge][ent.fFormat];
+        ++formatTotal.fCount;
+        formatTotal.fBytes += ent.fBytes;
+
+        QTableWidgetItem* ageItem = new QTableWidgetItem(ent.fAge);
+        ageItem->setData(Qt::UserRole, (int)i);
+        fDetails->setItem(i, kColAge, ageItem);
+        fDetails->setItem(i, kColPage, new QTableWidgetItem(ent.fPage));
+        fDetails->setItem(i, kColName, new QTableWidgetItem(st2qstr(ent.fKey->getName())));
+        fDetails->setItem(i, kColType, new QTableWidgetItem(
+                pqGetFriendlyClassName(ent.fKey->getType())));
+        fDetails->setItem(i, kColSize, new QTableWidgetItem(
+                QString("%1x%2").arg(ent.fWidth).arg(ent.fHeight)));
+        QTableWidgetItem* levelsItem = new QTableWidgetItem;
+        levelsItem->setData(Qt::DisplayRole, ent.fLevels);
+        fDetails->setItem(i, kColLevels, levelsItem);
+        fDetails->setItem(i, kColFormat, new QTableWidgetItem(ent.fFormat));
+        QTableWidgetItem* bytesItem = new QTableWidgetItem;
+        bytesItem->setData(Qt::DisplayRole, (qulonglong)ent.fBytes);
+        fDetails->setItem(i, kColBytes, bytesItem);
+        fDetails->setItem(i, kColIssues, new QTableWidgetItem(ent.fIssues.join("; ")));
+    }
+    fDetails->setSortingEnabled(true);
+    fDetails->resizeColumnsToContents();
+
+    for (auto age = ageTotals.constBegin(); age != ageTotals.constEnd(); ++age) {
+        QTreeWidgetItem* ageItem = new QTreeWidgetItem(fSummary);
+        ageItem->setText(0, age.key());
+        Totals ageTotal;
+        for (auto fmt = age.value().constBegin(); fmt != age.value().constEnd(); ++fmt) {
+            QTreeWidgetItem* fmtItem = new QTreeWidgetItem(ageItem);
+            fmtItem->setText(0, fmt.key());
+            fmtItem->setText(1, QString::number(fmt.value().fCount));
+            fmtItem->setText(2, QString("%L1").arg((qulonglong)fmt.value().fBytes));
+            ageTotal.fCount += fmt.value().fCount;
+            ageTotal.fBytes += fmt.value().fBytes;
+        }
+        ageItem->setText(1, QString::number(ageTotal.fCount));
+        ageItem->setText(2, QString("%L1").arg((qulonglong)ageTotal.fBytes));
+    }
+    fSummary->expandAll();
+    for (int i = 0; i < fSummary->columnCount(); ++i)
+        fSummary->resizeColumnToContents(i);
+}
+
+void QTextureAudit::refresh()
+{
+    QSettings settings("PlasmaShop", "PrpShop");
+    settings.setValue("AuditMaxSize", fMaxSize->value());
+
+    scan();
+    populate();
+}
+
+void QTextureAudit::exportCsv()
+{
+    QSettings settings("PlasmaShop", "PrpShop");
+    QString filename = QFileDialog::getSaveFileName(this, tr("Export CSV"),
+                            settings.value("DialogDir").toString(),
+                            "CSV Files (*.csv)");
+    if (filename.isEmpty())
+        return;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QMessageBox::critical(this, tr("Error exporting CSV"),
+                              tr("Error: Could not open file %1 for writing").arg(filename),
+                              QMessageBox::Ok);
+        return;
+    }
+
+    QTextStream out(&file);
+    out << "Age,Page,Name,Type,Width,Height,Levels,Format,Bytes,Hash,Issues\n";
+    for (const Entry& ent : fEntries) {
+        out << csvQuote(ent.fAge) << ','
+            << csvQuote(ent.fPage) << ','
+            << csvQuote(st2qstr(ent.fKey->getName())) << ','
+            << csvQuote(pqGetFriendlyClassName(ent.fKey->getType())) << ','
+            << ent.fWidth << ',' << ent.fHeight << ',' << ent.fLevels << ','
+            << csvQuote(ent.fFormat) << ','
+            << (qulonglong)ent.fBytes << ','
+            << ent.fHash.toHex() << ','
+            << csvQuote(ent.fIssues.join("; ")) << '\n';
+    }
+}
+
+void QTextureAudit::itemActivated(int row, int)
+{
+    QTableWidgetItem* item = fDetails->item(row, kColAge);
+    if (item == NULL)
+        return;
+
+    const Entry& ent = fEntries[item->data(Qt::UserRole).toInt()];
+    if (!ent.fKey.isLoaded())
+        return;
+
+    accept();
+    PrpShopMain::Instance()->editCreatable(ent.fKey->getObj());
+}
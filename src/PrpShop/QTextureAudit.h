@@ -0,0 +1,69 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QTEXTUREAUDIT_H
+#define _QTEXTUREAUDIT_H
+
+#include <QDialog>
+#include <QSpinBox>
+#include <QTreeWidget>
+#include <QTableWidget>
+#include <ResManager/plResManager.h>
+#include <PRP/Surface/plMipmap.h>
+#include <vector>
+
+class QTextureAudit : public QDialog
+{
+    Q_OBJECT
+
+public:
+    struct Entry
+    {
+        plKey fKey;
+        QString fAge, fPage, fFormat;
+        unsigned int fWidth, fHeight, fLevels;
+        size_t fBytes;
+        QByteArray fHash;
+        QStringList fIssues;
+
+        Entry() : fWidth(), fHeight(), fLevels(), fBytes() { }
+    };
+
+protected:
+    plResManager* fResMgr;
+    QSpinBox* fMaxSize;
+    QTreeWidget* fSummary;
+    QTableWidget* fDetails;
+    std::vector<Entry> fEntries;
+
+public:
+    QTextureAudit(plResManager* mgr, QWidget* parent = NULL);
+
+protected:
+    void scan();
+    void populate();
+
+protected slots:
+    void refresh();
+    void exportCsv();
+    void itemActivated(int row, int column);
+};
+
+// Hash of the stored image data, including the format and dimensions so
+// that identical bytes in different formats are not reported as duplicates
+QByteArray pqTextureHash(const plMipmap* tex);
+
+#endif
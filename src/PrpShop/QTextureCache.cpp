@@ -0,0 +1,116 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QTextureCache.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QSettings>
+#include <PRP/Surface/plCubicEnvironmap.h>
+#include "PRP/Surface/QMipmap.h"
+
+namespace
+{
+    // Cube map faces don't have keys of their own, so entries are keyed
+    // by the object and its image buffer.  Hashing the image data itself
+    // would make every lookup as slow as a decode, so objects that are
+    // edited, deleted or unloaded must be dropped with invalidate(),
+    // invalidateObject() or clear().
+    struct CacheKey
+    {
+        const plMipmap* fTexture;
+        const void* fData;
+        size_t fSize;
+        int fLevel;
+
+        bool operator==(const CacheKey& other) const
+        {
+            return fTexture == other.fTexture && fData == other.fData
+                && fSize == other.fSize && fLevel == other.fLevel;
+        }
+    };
+
+    uint qHash(const CacheKey& key, uint seed = 0)
+    {
+        return ::qHash(key.fTexture, seed) ^ ::qHash(key.fData, seed)
+             ^ ::qHash((quint64)key.fSize, seed) ^ (::qHash(key.fLevel, seed) << 1);
+    }
+
+    struct TextureCache
+    {
+        QMutex fMutex;
+        QCache<CacheKey, QImage> fImages;
+
+        TextureCache()
+        {
+            QSettings settings("PlasmaShop", "PrpShop");
+            fImages.setMaxCost(settings.value("TextureCacheSize", 256).toInt() * 1024);
+        }
+    };
+
+    TextureCache& cache()
+    {
+        static TextureCache s_cache;
+        return s_cache;
+    }
+}
+
+QImage QTextureCache::decode(plMipmap* tex, int level)
+{
+    if (tex == NULL || level < 0 || level >= (int)tex->getNumLevels())
+        return QImage();
+
+    CacheKey key { tex, tex->getImageData(), tex->getTotalSize(), level };
+    {
+        QMutexLocker lock(&cache().fMutex);
+        if (QImage* img = cache().fImages.object(key))
+            return *img;
+    }
+
+    // Decode without holding the lock, so several textures can be
+    // decoded at once from worker threads
+    QImage img = decodeMipmapLevel(tex, level);
+    if (!img.isNull()) {
+        QMutexLocker lock(&cache().fMutex);
+        cache().fImages.insert(key, new QImage(img), std::max(1, img.bytesPerLine() * img.height() / 1024));
+    }
+    return img;
+}
+
+void QTextureCache::invalidate(const plMipmap* tex)
+{
+    QMutexLocker lock(&cache().fMutex);
+    for (const CacheKey& key : cache().fImages.keys()) {
+        if (key.fTexture == tex)
+            cache().fImages.remove(key);
+    }
+}
+
+void QTextureCache::invalidateObject(plCreatable* obj)
+{
+    if (plCubicEnvironmap* envMap = plCubicEnvironmap::Convert(obj, false)) {
+        for (size_t face = 0; face < plCubicEnvironmap::kNumFaces; ++face)
+            invalidate(envMap->getFace(face));
+    } else if (plMipmap* tex = plMipmap::Convert(obj, false)) {
+        invalidate(tex);
+    }
+}
+
+void QTextureCache::clear()
+{
+    QMutexLocker lock(&cache().fMutex);
+    cache().fImages.clear();
+}
@@ -0,0 +1,45 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QTEXTURECACHE_H
+#define _QTEXTURECACHE_H
+
+#include <QImage>
+#include <PRP/Surface/plMipmap.h>
+
+/* Process-wide cache of decoded mipmap levels, shared by the texture
+ * previews, the 3D preview and the image exporters.  Entries are evicted
+ * least-recently-used first once the "TextureCacheSize" setting (in MB)
+ * is exceeded.  Safe to use from worker threads. */
+class QTextureCache
+{
+public:
+    // Returns the level as an ARGB32 image, or a null image if it
+    // can't be decoded
+    static QImage decode(plMipmap* tex, int level);
+
+    // Drop every cached level of tex; call after replacing its contents
+    static void invalidate(const plMipmap* tex);
+
+    // Drop the levels of a mipmap or of every face of a cube map; call
+    // before the object is deleted
+    static void invalidateObject(plCreatable* obj);
+
+    // Drop everything; call before a page is unloaded
+    static void clear();
+};
+
+#endif
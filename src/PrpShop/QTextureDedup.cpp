@@ -0,0 +1,318 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QTextureDedup.h"
+
+#include <QLabel>
+#include <QPushButton>
+#include <QDialogButtonBox>
+#include <QGridLayout>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QCryptographicHash>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <PRP/Surface/plMipmap.h>
+#include <PRP/Surface/plCubicEnvironmap.h>
+#include <PRP/Surface/plLayerInterface.h>
+#include <algorithm>
+#include <set>
+#include "QPlasmaUtils.h"
+
+enum
+{
+    kColName, kColPage, kColBytes, kColLayers, kNumColumns
+};
+
+static void hashDecodedLevels(plMipmap* tex, QCryptographicHash& hash)
+{
+    // JPEG mipmaps only ever decode the top level
+    const size_t levels = (tex->getCompressionType() == plBitmap::kJPEGCompression)
+                        ? 1 : tex->getNumLevels();
+    const uint32_t header[] = {
+        tex->getWidth(), tex->getHeight(), (uint32_t)levels
+    };
+    hash.addData((const char*)header, sizeof(header));
+
+    QMutexLocker lock((tex->getCompressionType() == plBitmap::kJPEGCompression)
+                      ? &pqJPEGDecoderMutex() : Q_NULLPTR);
+    std::vector<unsigned char> buffer;
+    for (size_t level = 0; level < levels; ++level) {
+        size_t size = tex->GetUncompressedSize(level);
+        buffer.resize(size);
+        tex->DecompressImage(level, buffer.data(), size);
+        hash.addData((const char*)buffer.data(), size);
+    }
+}
+
+static QByteArray decodedHash(const plKey& key)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    try {
+        plCreatable* obj = key->getObj();
+        if (plCubicEnvironmap* envMap = plCubicEnvironmap::Convert(obj, false)) {
+            for (size_t face = 0; face < plCubicEnvironmap::kNumFaces; ++face)
+                hashDecodedLevels(envMap->getFace(face), hash);
+        } else if (plMipmap* tex = plMipmap::Convert(obj, false)) {
+            hashDecodedLevels(tex, hash);
+        } else {
+            return QByteArray();
+        }
+    } catch (const hsException&) {
+        // Undecodable textures are never grouped with anything
+        return QByteArray();
+    }
+    return hash.result();
+}
+
+static size_t textureBytes(const plKey& key)
+{
+    plCreatable* obj = key->getObj();
+    if (plCubicEnvironmap* envMap = plCubicEnvironmap::Convert(obj, false)) {
+        size_t bytes = 0;
+        for (size_t face = 0; face < plCubicEnvironmap::kNumFaces; ++face)
+            bytes += envMap->getFace(face)->getTotalSize();
+        return bytes;
+    } else if (plMipmap* tex = plMipmap::Convert(obj, false)) {
+        return tex->getTotalSize();
+    }
+    return 0;
+}
+
+
+/* QTextureDedup */
+QTextureDedup::QTextureDedup(plResManager* mgr, QWidget* parent)
+    : QDialog(parent), fResMgr(mgr)
+{
+    setWindowTitle(tr("Duplicate Textures"));
+
+    fGroupList = new QTreeWidget(this);
+    fGroupList->setUniformRowHeights(true);
+    fGroupList->setHeaderLabels(QStringList{tr("Texture"), tr("Page"),
+                                            tr("Bytes"), tr("Layers")});
+
+    QDialogButtonBox* buttonBox = new QDialogButtonBox(Qt::Horizontal, this);
+    QPushButton* rewriteButton = buttonBox->addButton(tr("&Rewrite Layer References"),
+                                                      QDialogButtonBox::ActionRole);
+    buttonBox->addButton(QDialogButtonBox::Close);
+
+    QGridLayout* layout = new QGridLayout(this);
+    layout->setVerticalSpacing(8);
+    layout->addWidget(new QLabel(tr("Checked groups will have all of their layers "
+                                    "pointed at the bold texture.  Double-click a "
+                                    "texture to share it instead."), this), 0, 0);
+    layout->addWidget(fGroupList, 1, 0);
+    layout->addWidget(buttonBox, 2, 0);
+    resize(700, 500);
+
+    connect(rewriteButton, &QPushButton::clicked, this, &QTextureDedup::rewriteReferences);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    connect(fGroupList, &QTreeWidget::itemActivated, this, &QTextureDedup::itemActivated);
+
+    if (scan())
+        populate();
+}
+
+bool QTextureDedup::scan()
+{
+    fTextures.clear();
+    fGroups.clear();
+    fLayerRefs.clear();
+
+    std::vector<plKey> keys;
+    for (const plLocation& loc : fResMgr->getLocations()) {
+        for (short type : fResMgr->getTypes(loc, true)) {
+            for (const plKey& key : fResMgr->getKeys(loc, type, true)) {
+                if (!key.isLoaded())
+                    continue;
+                if (type == kMipmap || type == kCubicEnvironmap) {
+                    keys.push_back(key);
+                    continue;
+                }
+                plLayerInterface* layer = plLayerInterface::Convert(key->getObj(), false);
+                if (layer != NULL && layer->getTexture().Exists())
+                    fLayerRefs[layer->getTexture()].push_back(key);
+            }
+        }
+    }
+
+    // Decoding is by far the slowest part, so spread it over all cores.
+    // JPEG textures still decode one at a time, since libHSPlasma only has
+    // one JPEG decoder.  The keys are passed by iterator so that no
+    // plKey copies (whose reference counts are not atomic) are made or
+    // destroyed on the workers.
+    QProgressDialog progress(tr("Hashing textures..."), tr("Cancel"), 0, 0, this);
+    progress.setWindowModality(Qt::WindowModal);
+    QFutureWatcher<QByteArray> watcher;
+    connect(&watcher, &QFutureWatcher<QByteArray>::progressRangeChanged,
+            &progress, &QProgressDialog::setRange);
+    connect(&watcher, &QFutureWatcher<QByteArray>::progressValueChanged,
+            &progress, &QProgressDialog::setValue);
+    connect(&watcher, &QFutureWatcher<QByteArray>::finished,
+            &progress, &QProgressDialog::reset);
+    connect(&progress, &QProgressDialog::canceled,
+            &watcher, &QFutureWatcher<QByteArray>::cancel);
+    watcher.setFuture(QtConcurrent::mapped(keys.cbegin(), keys.cend(), decodedHash));
+    progress.exec();
+    watcher.waitForFinished();
+    if (watcher.isCanceled())
+        return false;
+
+    QHash<QByteArray, size_t> groupIndex;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        Texture tex;
+        tex.fKey = keys[i];
+        tex.fHash = watcher.resultAt(i);
+        tex.fBytes = textureBytes(keys[i]);
+        fTextures.push_back(tex);
+        if (tex.fHash.isEmpty())
+            continue;
+
+        auto found = groupIndex.constFind(tex.fHash);
+        if (found == groupIndex.constEnd()) {
+            groupIndex.insert(tex.fHash, fGroups.size());
+            fGroups.emplace_back();
+            found = groupIndex.constFind(tex.fHash);
+        }
+        fGroups[found.value()].fTextures.push_back(i);
+    }
+
+    // Drop the unique textures, and pick a default shared texture for each
+    // group: prefer one from a Textures page, then the smallest encoding
+    auto unique = std::remove_if(fGroups.begin(), fGroups.end(), [](const Group& group) {
+        return group.fTextures.size() < 2;
+    });
+    fGroups.erase(unique, fGroups.end());
+    for (Group& group : fGroups) {
+        auto preferred = [this](size_t left, size_t right) {
+            bool leftTex = fTextures[left].fKey->getLocation().getPageNum() == -1;
+            bool rightTex = fTextures[right].fKey->getLocation().getPageNum() == -1;
+            if (leftTex != rightTex)
+                return leftTex;
+            return fTextures[left].fBytes < fTextures[right].fBytes;
+        };
+        group.fShared = *std::min_element(group.fTextures.begin(),
+                                          group.fTextures.end(), preferred);
+    }
+    return true;
+}
+
+void QTextureDedup::populate()
+{
+    fGroupList->clear();
+
+    size_t wasted = 0;
+    for (size_t g = 0; g < fGroups.size(); ++g) {
+        const Group& group = fGroups[g];
+        QTreeWidgetItem* groupItem = new QTreeWidgetItem(fGroupList);
+        groupItem->setText(kColName, tr("%1 copies").arg(group.fTextures.size()));
+        groupItem->setData(kColName, Qt::UserRole, (int)g);
+        groupItem->setCheckState(kColName, Qt::Checked);
+
+        size_t groupBytes = 0;
+        for (size_t idx : group.fTextures) {
+            const Texture& tex = fTextures[idx];
+            plPageInfo* page = fResMgr->FindPage(tex.fKey->getLocation());
+            auto refs = fLayerRefs.find(tex.fKey);
+
+            QTreeWidgetItem* texItem = new QTreeWidgetItem(groupItem);
+            texItem->setText(kColName, st2qstr(tex.fKey->getName()));
+            texItem->setIcon(kColName, pqGetTypeIcon(tex.fKey->getType()));
+            texItem->setData(kColName, Qt::UserRole, (int)idx);
+            if (page != NULL) {
+                texItem->setText(kColPage, QString("%1 / %2").arg(st2qstr(page->getAge()))
+                                                           .arg(st2qstr(page->getPage())));
+            }
+            texItem->setText(kColBytes, QString("%L1").arg((qulonglong)tex.fBytes));
+            texItem->setText(kColLayers, QString::number(
+                    (refs != fLayerRefs.end()) ? refs->second.size() : 0));
+            if (idx != group.fShared)
+                groupBytes += tex.fBytes;
+        }
+        groupItem->setText(kColBytes, tr("%L1 redundant").arg((qulonglong)groupBytes));
+        wasted += groupBytes;
+        setShared(groupItem, group.fShared);
+    }
+
+    if (fGroups.empty()) {
+        QTreeWidgetItem* item = new QTreeWidgetItem(fGroupList);
+        item->setText(kColName, tr("No duplicate textures found"));
+        item->setFlags(Qt::NoItemFlags);
+    } else {
+        setWindowTitle(tr("Duplicate Textures (%L1 redundant bytes)").arg((qulonglong)wasted));
+    }
+    fGroupList->expandAll();
+    for (int i = 0; i < kNumColumns; ++i)
+        fGroupList->resizeColumnToContents(i);
+}
+
+void QTextureDedup::setShared(QTreeWidgetItem* groupItem, size_t shared)
+{
+    for (int i = 0; i < groupItem->childCount(); ++i) {
+        QTreeWidgetItem* texItem = groupItem->child(i);
+        QFont font = texItem->font(kColName);
+        font.setBold((size_t)texItem->data(kColName, Qt::UserRole).toInt() == shared);
+        texItem->setFont(kColName, font);
+    }
+}
+
+void QTextureDedup::itemActivated(QTreeWidgetItem* item, int)
+{
+    QTreeWidgetItem* groupItem = item->parent();
+    if (groupItem == NULL)
+        return;
+
+    Group& group = fGroups[groupItem->data(kColName, Qt::UserRole).toInt()];
+    group.fShared = item->data(kColName, Qt::UserRole).toInt();
+    setShared(groupItem, group.fShared);
+}
+
+void QTextureDedup::rewriteReferences()
+{
+    size_t layerCount = 0;
+    std::set<plLocation> locations;
+    for (int i = 0; i < fGroupList->topLevelItemCount(); ++i) {
+        QTreeWidgetItem* groupItem = fGroupList->topLevelItem(i);
+        if (groupItem->checkState(kColName) != Qt::Checked)
+            continue;
+
+        const Group& group = fGroups[groupItem->data(kColName, Qt::UserRole).toInt()];
+        const plKey& shared = fTextures[group.fShared].fKey;
+        for (size_t idx : group.fTextures) {
+            if (idx == group.fShared)
+                continue;
+
+            auto refs = fLayerRefs.find(fTextures[idx].fKey);
+            if (refs == fLayerRefs.end())
+                continue;
+            for (const plKey& layerKey : refs->second) {
+                plLayerInterface* layer = plLayerInterface::Convert(layerKey->getObj());
+                layer->setTexture(shared);
+                locations.insert(layerKey->getLocation());
+                ++layerCount;
+            }
+            fLayerRefs[shared].insert(fLayerRefs[shared].end(),
+                                      refs->second.begin(), refs->second.end());
+            fLayerRefs.erase(refs);
+        }
+    }
+
+    populate();
+    QMessageBox::information(this, tr("Duplicate Textures"),
+            tr("Updated %1 layer(s) in %2 page(s).  Save the affected pages to "
+               "keep the changes; textures that are no longer referenced can "
+               "then be deleted.").arg(layerCount).arg(locations.size()));
+}
@@ -0,0 +1,67 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QTEXTUREDEDUP_H
+#define _QTEXTUREDEDUP_H
+
+#include <QDialog>
+#include <QTreeWidget>
+#include <ResManager/plResManager.h>
+#include <map>
+#include <vector>
+
+class QTextureDedup : public QDialog
+{
+    Q_OBJECT
+
+protected:
+    struct Texture
+    {
+        plKey fKey;
+        QByteArray fHash;
+        size_t fBytes;
+
+        Texture() : fBytes() { }
+    };
+
+    struct Group
+    {
+        std::vector<size_t> fTextures;
+        size_t fShared;
+
+        Group() : fShared() { }
+    };
+
+    plResManager* fResMgr;
+    QTreeWidget* fGroupList;
+    std::vector<Texture> fTextures;
+    std::vector<Group> fGroups;
+    std::map<plKey, std::vector<plKey>> fLayerRefs;
+
+public:
+    QTextureDedup(plResManager* mgr, QWidget* parent = NULL);
+
+protected:
+    bool scan();
+    void populate();
+    void setShared(QTreeWidgetItem* groupItem, size_t shared);
+
+protected slots:
+    void itemActivated(QTreeWidgetItem* item, int column);
+    void rewriteReferences();
+};
+
+#endif
@@ -0,0 +1,110 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QHexDataSource.h"
+
+#include <cstring>
+
+// Size of each mapped view.  Small enough to always find address space
+// for, even in 32-bit builds.
+#define MAP_WINDOW_SIZE  (Q_INT64_C(16) * 1024 * 1024)
+
+QByteArray QHexDataSource::read(qint64 address, qint64 count) const
+{
+    if (address < 0 || address >= size())
+        return QByteArray();
+    count = qMin(count, size() - address);
+
+    QByteArray result;
+    result.resize((int)count);
+    result.resize((int)read(address, reinterpret_cast<uchar*>(result.data()), count));
+    return result;
+}
+
+
+/* QHexByteArraySource */
+qint64 QHexByteArraySource::read(qint64 address, uchar* out, qint64 count) const
+{
+    if (address < 0 || address >= fData.size())
+        return 0;
+    count = qMin(count, fData.size() - address);
+    memcpy(out, fData.constData() + address, count);
+    return count;
+}
+
+
+/* QHexFileSource */
+QHexFileSource::QHexFileSource(const QString& fileName, qint64 offset, qint64 size)
+    : fFile(fileName), fOffset(offset), fSize(), fWindow(),
+      fWindowStart(), fWindowSize()
+{
+    if (!fFile.open(QIODevice::ReadOnly))
+        return;
+
+    qint64 available = qMax(Q_INT64_C(0), fFile.size() - offset);
+    fSize = (size < 0) ? available : qMin(size, available);
+}
+
+QHexFileSource::~QHexFileSource()
+{
+    if (fWindow)
+        fFile.unmap(fWindow);
+}
+
+qint64 QHexFileSource::read(qint64 address, uchar* out, qint64 count) const
+{
+    if (address < 0 || address >= fSize)
+        return 0;
+    count = qMin(count, fSize - address);
+
+    QMutexLocker lock(&fMutex);
+    qint64 copied = 0;
+    while (copied < count) {
+        qint64 pos = address + copied;
+        if (!mapWindow(pos)) {
+            // Not mappable (e.g. a pipe or a full address space); fall
+            // back to plain reads
+            if (!fFile.seek(fOffset + pos))
+                break;
+            qint64 got = fFile.read(reinterpret_cast<char*>(out + copied), count - copied);
+            if (got <= 0)
+                break;
+            copied += got;
+            continue;
+        }
+
+        qint64 chunk = qMin(count - copied, fWindowStart + fWindowSize - pos);
+        memcpy(out + copied, fWindow + (pos - fWindowStart), chunk);
+        copied += chunk;
+    }
+    return copied;
+}
+
+bool QHexFileSource::mapWindow(qint64 address) const
+{
+    if (fWindow && address >= fWindowStart && address < fWindowStart + fWindowSize)
+        return true;
+
+    if (fWindow) {
+        fFile.unmap(fWindow);
+        fWindow = Q_NULLPTR;
+    }
+
+    fWindowStart = (address / MAP_WINDOW_SIZE) * MAP_WINDOW_SIZE;
+    fWindowSize = qMin(MAP_WINDOW_SIZE, fSize - fWindowStart);
+    fWindow = fFile.map(fOffset + fWindowStart, fWindowSize);
+    return fWindow != Q_NULLPTR;
+}
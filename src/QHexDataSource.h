@@ -0,0 +1,77 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QHEXDATASOURCE_H
+#define _QHEXDATASOURCE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+
+/* Random-access byte storage for QHexWidget.  Implementations must allow
+ * read() to be called from worker threads. */
+class QHexDataSource
+{
+public:
+    virtual ~QHexDataSource() { }
+
+    virtual qint64 size() const = 0;
+
+    // Copies up to count bytes starting at address into out, returning
+    // the number of bytes actually copied
+    virtual qint64 read(qint64 address, uchar* out, qint64 count) const = 0;
+
+    QByteArray read(qint64 address, qint64 count) const;
+};
+
+class QHexByteArraySource : public QHexDataSource
+{
+public:
+    explicit QHexByteArraySource(const QByteArray& data) : fData(data) { }
+
+    qint64 size() const Q_DECL_OVERRIDE { return fData.size(); }
+    qint64 read(qint64 address, uchar* out, qint64 count) const Q_DECL_OVERRIDE;
+
+private:
+    QByteArray fData;
+};
+
+/* Memory-maps a range of a file a window at a time, so only the parts
+ * that are actually looked at are paged in, and files larger than the
+ * address space can still be viewed. */
+class QHexFileSource : public QHexDataSource
+{
+public:
+    QHexFileSource(const QString& fileName, qint64 offset = 0, qint64 size = -1);
+    ~QHexFileSource();
+
+    bool isOpen() const { return fFile.isOpen(); }
+
+    qint64 size() const Q_DECL_OVERRIDE { return fSize; }
+    qint64 read(qint64 address, uchar* out, qint64 count) const Q_DECL_OVERRIDE;
+
+private:
+    mutable QMutex fMutex;
+    mutable QFile fFile;
+    qint64 fOffset, fSize;
+
+    mutable uchar* fWindow;
+    mutable qint64 fWindowStart, fWindowSize;
+
+    bool mapWindow(qint64 address) const;
+};
+
+#endif
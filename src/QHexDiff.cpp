@@ -0,0 +1,460 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QHexDiff.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#define DIFF_BLOCK_SIZE     (1024 * 1024)
+
+// Content-defined chunks average about 320 bytes.  Boundaries depend only
+// on the bytes just before them, so an insertion only disturbs the chunks
+// around it and both sides chunk identically everywhere else.
+#define CHUNK_MIN_SIZE      (64)
+#define CHUNK_MAX_SIZE      (4096)
+#define CHUNK_BOUNDARY_MASK (Q_UINT64_C(0xFF) << 56)
+
+// Limits on the quadratic parts, beyond which a region is simply
+// reported as one changed hunk
+#define MAX_MYERS_ITEMS     (16384)
+#define MAX_MYERS_EDITS     (1024)
+
+// Hunks separated by fewer equal bytes than this are merged
+#define MIN_EQUAL_RUN       (8)
+
+#define FNV_OFFSET          Q_UINT64_C(0xCBF29CE484222325)
+#define FNV_PRIME           Q_UINT64_C(0x100000001B3)
+
+namespace
+{
+    struct Chunk
+    {
+        qint64 fStart;
+        int fLength;
+        quint64 fHash;
+
+        bool operator==(const Chunk& other) const
+        {
+            return fHash == other.fHash && fLength == other.fLength;
+        }
+    };
+
+    // Equal runs, in bytes or in chunks depending on context
+    struct Match
+    {
+        qint64 fLeft, fRight, fLength;
+    };
+
+    struct GearTable
+    {
+        quint64 fValues[256];
+
+        GearTable()
+        {
+            // splitmix64, so the table is the same on every run
+            quint64 seed = 0;
+            for (quint64& value : fValues) {
+                quint64 z = (seed += Q_UINT64_C(0x9E3779B97F4A7C15));
+                z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+                z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+                value = z ^ (z >> 31);
+            }
+        }
+    };
+    const GearTable sGear;
+}
+
+static bool _cancelled(const QAtomicInt* cancel)
+{
+    return cancel && cancel->loadAcquire();
+}
+
+static void _appendMatch(std::vector<Match>& matches, const Match& match)
+{
+    if (!matches.empty()) {
+        Match& last = matches.back();
+        if (last.fLeft + last.fLength == match.fLeft
+                && last.fRight + last.fLength == match.fRight) {
+            last.fLength += match.fLength;
+            return;
+        }
+    }
+    matches.push_back(match);
+}
+
+static qint64 _commonPrefix(const QHexDataSource* left, qint64 leftStart,
+                            const QHexDataSource* right, qint64 rightStart,
+                            qint64 maxLength, const QAtomicInt* cancel)
+{
+    const qint64 blockSize = qMin<qint64>(DIFF_BLOCK_SIZE, maxLength);
+    std::vector<uchar> lbuf(blockSize), rbuf(blockSize);
+    qint64 length = 0;
+    while (length < maxLength && !_cancelled(cancel)) {
+        const qint64 count = qMin<qint64>(blockSize, maxLength - length);
+        if (left->read(leftStart + length, lbuf.data(), count) != count
+                || right->read(rightStart + length, rbuf.data(), count) != count)
+            break;
+        auto diff = std::mismatch(lbuf.begin(), lbuf.begin() + count, rbuf.begin());
+        length += diff.first - lbuf.begin();
+        if (diff.first != lbuf.begin() + count)
+            break;
+    }
+    return length;
+}
+
+static qint64 _commonSuffix(const QHexDataSource* left, qint64 leftEnd,
+                            const QHexDataSource* right, qint64 rightEnd,
+                            qint64 maxLength, const QAtomicInt* cancel)
+{
+    const qint64 blockSize = qMin<qint64>(DIFF_BLOCK_SIZE, maxLength);
+    std::vector<uchar> lbuf(blockSize), rbuf(blockSize);
+    qint64 length = 0;
+    while (length < maxLength && !_cancelled(cancel)) {
+        const qint64 count = qMin<qint64>(blockSize, maxLength - length);
+        if (left->read(leftEnd - length - count, lbuf.data(), count) != count
+                || right->read(rightEnd - length - count, rbuf.data(), count) != count)
+            break;
+        auto diff = std::mismatch(lbuf.rbegin() + (blockSize - count), lbuf.rend(),
+                                  rbuf.rbegin() + (blockSize - count));
+        length += diff.first - (lbuf.rbegin() + (blockSize - count));
+        if (diff.first != lbuf.rend())
+            break;
+    }
+    return length;
+}
+
+static bool _chunkRange(const QHexDataSource* data, qint64 from, qint64 to,
+                        std::vector<Chunk>& chunks, const QAtomicInt* cancel)
+{
+    std::vector<uchar> buffer(DIFF_BLOCK_SIZE);
+    Chunk chunk = { from, 0, FNV_OFFSET };
+    quint64 gear = 0;
+    for (qint64 block = from; block < to; block += DIFF_BLOCK_SIZE) {
+        if (_cancelled(cancel))
+            return false;
+        const int count = (int)data->read(block, buffer.data(),
+                                          qMin<qint64>(DIFF_BLOCK_SIZE, to - block));
+        for (int i = 0; i < count; ++i) {
+            const uchar ch = buffer[i];
+            gear = (gear << 1) + sGear.fValues[ch];
+            chunk.fHash = (chunk.fHash ^ ch) * FNV_PRIME;
+            if (++chunk.fLength >= CHUNK_MIN_SIZE
+                    && ((gear & CHUNK_BOUNDARY_MASK) == 0 || chunk.fLength >= CHUNK_MAX_SIZE)) {
+                chunks.push_back(chunk);
+                chunk.fStart += chunk.fLength;
+                chunk.fLength = 0;
+                chunk.fHash = FNV_OFFSET;
+            }
+        }
+        if (count < qMin<qint64>(DIFF_BLOCK_SIZE, to - block))
+            break;
+    }
+    if (chunk.fLength)
+        chunks.push_back(chunk);
+    return true;
+}
+
+/* Greedy O(ND) diff (Myers, 1986), keeping the frontier of each round so
+ * the edit path can be traced back.  Appends the equal runs in order, or
+ * returns false if more than maxEdits insertions and deletions are needed. */
+template <typename Equal>
+static bool _myers(int n, int m, int maxEdits, Equal equal, std::vector<Match>& matches)
+{
+    std::vector<std::vector<int>> trace;
+    std::vector<int> v(2 * (maxEdits + 1) + 1, 0);
+    const int offset = maxEdits + 1;
+    for (int d = 0; d <= maxEdits; ++d) {
+        trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                x = v[offset + k + 1];
+            else
+                x = v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && equal(x, y)) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x < n || y < m)
+                continue;
+
+            // Walk back from the end, collecting the snakes
+            std::vector<Match> snakes;
+            for (int step = d; step > 0; --step) {
+                const std::vector<int>& prev = trace[step];
+                const int pk = x - y;
+                const bool down = (pk == -step || (pk != step
+                                   && prev[pk - 1 + step] < prev[pk + 1 + step]));
+                const int prevK = down ? pk + 1 : pk - 1;
+                const int prevX = prev[prevK + step];
+                const int midX = down ? prevX : prevX + 1;
+                if (x > midX)
+                    snakes.push_back(Match { midX, midX - pk, x - midX });
+                x = prevX;
+                y = prevX - prevK;
+            }
+            if (x > 0)
+                snakes.push_back(Match { 0, 0, x });
+            matches.insert(matches.end(), snakes.rbegin(), snakes.rend());
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Chunks which occur exactly once on each side are almost certainly the
+ * same content; the longest run of them in the same order on both sides
+ * (patience diff) anchors the alignment without any quadratic search. */
+static std::vector<std::pair<int, int>> _uniqueAnchors(const std::vector<Chunk>& left,
+                                                       const std::vector<Chunk>& right)
+{
+    struct Count
+    {
+        int fLeft, fRight;
+        int fLeftIndex, fRightIndex;
+    };
+    std::unordered_map<quint64, Count> counts;
+    counts.reserve(left.size() + right.size());
+    for (size_t i = 0; i < left.size(); ++i) {
+        Count& count = counts.emplace(left[i].fHash, Count { 0, 0, 0, 0 }).first->second;
+        ++count.fLeft;
+        count.fLeftIndex = (int)i;
+    }
+    for (size_t i = 0; i < right.size(); ++i) {
+        auto it = counts.find(right[i].fHash);
+        if (it != counts.end()) {
+            ++it->second.fRight;
+            it->second.fRightIndex = (int)i;
+        }
+    }
+
+    std::vector<std::pair<int, int>> pairs;
+    for (const auto& it : counts) {
+        const Count& count = it.second;
+        if (count.fLeft == 1 && count.fRight == 1
+                && left[count.fLeftIndex] == right[count.fRightIndex])
+            pairs.emplace_back(count.fLeftIndex, count.fRightIndex);
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    // Longest increasing subsequence of the right indices
+    std::vector<int> tails, prev(pairs.size(), -1);
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        auto pos = std::lower_bound(tails.begin(), tails.end(), pairs[i].second,
+                [&pairs](int tail, int value) { return pairs[tail].second < value; });
+        if (pos != tails.begin())
+            prev[i] = *(pos - 1);
+        if (pos == tails.end())
+            tails.push_back((int)i);
+        else
+            *pos = (int)i;
+    }
+
+    std::vector<std::pair<int, int>> anchors;
+    for (int i = tails.empty() ? -1 : tails.back(); i >= 0; i = prev[i])
+        anchors.push_back(pairs[i]);
+    std::reverse(anchors.begin(), anchors.end());
+    return anchors;
+}
+
+// Align the chunks between two anchors, in chunk units
+static void _matchChunks(const std::vector<Chunk>& left, int l0, int l1,
+                         const std::vector<Chunk>& right, int r0, int r1,
+                         std::vector<Match>& matches)
+{
+    while (l0 < l1 && r0 < r1 && left[l0] == right[r0])
+        matches.push_back(Match { l0++, r0++, 1 });
+
+    std::vector<Match> tail;
+    while (l0 < l1 && r0 < r1 && left[l1 - 1] == right[r1 - 1])
+        tail.push_back(Match { --l1, --r1, 1 });
+
+    if (l0 < l1 && r0 < r1 && (l1 - l0) + (r1 - r0) <= MAX_MYERS_ITEMS) {
+        std::vector<Match> inner;
+        auto equal = [&](int x, int y) { return left[l0 + x] == right[r0 + y]; };
+        if (_myers(l1 - l0, r1 - r0, MAX_MYERS_EDITS, equal, inner)) {
+            for (const Match& match : inner)
+                matches.push_back(Match { l0 + match.fLeft, r0 + match.fRight, match.fLength });
+        }
+    }
+    matches.insert(matches.end(), tail.rbegin(), tail.rend());
+}
+
+// Find equal byte runs inside a region the chunk pass couldn't align
+static void _refine(const QHexDataSource* left, qint64 l0, qint64 l1,
+                    const QHexDataSource* right, qint64 r0, qint64 r1,
+                    std::vector<Match>& matches)
+{
+    const qint64 n = l1 - l0, m = r1 - r0;
+    if (n == 0 || m == 0)
+        return;
+
+    if (n == m) {
+        // Same size, so most likely values edited in place
+        const qint64 blockSize = qMin<qint64>(DIFF_BLOCK_SIZE, n);
+        std::vector<uchar> lbuf(blockSize), rbuf(blockSize);
+        qint64 runStart = -1;
+        for (qint64 block = 0; block < n; block += blockSize) {
+            const qint64 count = qMin<qint64>(blockSize, n - block);
+            left->read(l0 + block, lbuf.data(), count);
+            right->read(r0 + block, rbuf.data(), count);
+            for (qint64 i = 0; i < count; ++i) {
+                if (lbuf[i] == rbuf[i]) {
+                    if (runStart < 0)
+                        runStart = block + i;
+                } else if (runStart >= 0) {
+                    if (block + i - runStart >= MIN_EQUAL_RUN)
+                        matches.push_back(Match { l0 + runStart, r0 + runStart, block + i - runStart });
+                    runStart = -1;
+                }
+            }
+        }
+        if (runStart >= 0 && n - runStart >= MIN_EQUAL_RUN)
+            matches.push_back(Match { l0 + runStart, r0 + runStart, n - runStart });
+        return;
+    }
+
+    // Chunk boundaries rarely fall exactly on the change, so there are
+    // usually equal bytes to trim off both ends
+    const qint64 prefix = _commonPrefix(left, l0, right, r0, qMin(n, m), Q_NULLPTR);
+    const qint64 suffix = _commonSuffix(left, l1, right, r1, qMin(n, m) - prefix, Q_NULLPTR);
+    if (prefix)
+        matches.push_back(Match { l0, r0, prefix });
+    l0 += prefix;
+    r0 += prefix;
+    l1 -= suffix;
+    r1 -= suffix;
+
+    if (l1 > l0 && r1 > r0 && (l1 - l0) + (r1 - r0) <= MAX_MYERS_ITEMS) {
+        const QByteArray lbytes = left->read(l0, l1 - l0);
+        const QByteArray rbytes = right->read(r0, r1 - r0);
+        std::vector<Match> inner;
+        auto equal = [&](int x, int y) { return lbytes[x] == rbytes[y]; };
+        if (_myers(lbytes.size(), rbytes.size(), MAX_MYERS_EDITS, equal, inner)) {
+            for (const Match& match : inner) {
+                if (match.fLength >= MIN_EQUAL_RUN)
+                    matches.push_back(Match { l0 + match.fLeft, r0 + match.fRight, match.fLength });
+            }
+        }
+    }
+    if (suffix)
+        matches.push_back(Match { l1, r1, suffix });
+}
+
+static void _appendHunk(QVector<QHexDiffHunk>& hunks, const QHexDiffHunk& hunk)
+{
+    if (!hunks.isEmpty()) {
+        QHexDiffHunk& last = hunks.last();
+        if (hunk.fLeftStart - (last.fLeftStart + last.fLeftLength) < MIN_EQUAL_RUN) {
+            last.fLeftLength = hunk.fLeftStart + hunk.fLeftLength - last.fLeftStart;
+            last.fRightLength = hunk.fRightStart + hunk.fRightLength - last.fRightStart;
+            return;
+        }
+    }
+    hunks.append(hunk);
+}
+
+QVector<QHexDiffHunk> QHexDiff::compare(const QHexDataSource* left,
+                                        const QHexDataSource* right,
+                                        const QAtomicInt* cancel)
+{
+    const qint64 leftSize = left->size(), rightSize = right->size();
+    const qint64 prefix = _commonPrefix(left, 0, right, 0, qMin(leftSize, rightSize), cancel);
+    const qint64 suffix = _commonSuffix(left, leftSize, right, rightSize,
+                                        qMin(leftSize, rightSize) - prefix, cancel);
+    const qint64 leftEnd = leftSize - suffix, rightEnd = rightSize - suffix;
+
+    // Coarse alignment on chunk hashes
+    std::vector<Match> matches;
+    if (prefix)
+        matches.push_back(Match { 0, 0, prefix });
+    if (prefix < leftEnd && prefix < rightEnd) {
+        std::vector<Chunk> lchunks, rchunks;
+        if (!_chunkRange(left, prefix, leftEnd, lchunks, cancel)
+                || !_chunkRange(right, prefix, rightEnd, rchunks, cancel))
+            return QVector<QHexDiffHunk>();
+
+        std::vector<Match> chunkMatches;
+        int l0 = 0, r0 = 0;
+        for (const auto& anchor : _uniqueAnchors(lchunks, rchunks)) {
+            _matchChunks(lchunks, l0, anchor.first, rchunks, r0, anchor.second, chunkMatches);
+            chunkMatches.push_back(Match { anchor.first, anchor.second, 1 });
+            l0 = anchor.first + 1;
+            r0 = anchor.second + 1;
+        }
+        _matchChunks(lchunks, l0, (int)lchunks.size(), rchunks, r0, (int)rchunks.size(),
+                     chunkMatches);
+
+        for (const Match& match : chunkMatches) {
+            for (qint64 i = 0; i < match.fLength; ++i) {
+                const Chunk& chunk = lchunks[match.fLeft + i];
+                _appendMatch(matches, Match { chunk.fStart,
+                                              rchunks[match.fRight + i].fStart,
+                                              chunk.fLength });
+            }
+        }
+    }
+    if (suffix)
+        _appendMatch(matches, Match { leftEnd, rightEnd, suffix });
+    matches.push_back(Match { leftSize, rightSize, 0 });
+
+    // Fine alignment inside whatever is left over
+    std::vector<Match> refined;
+    qint64 l = 0, r = 0;
+    for (const Match& match : matches) {
+        if (_cancelled(cancel))
+            return QVector<QHexDiffHunk>();
+        _refine(left, l, match.fLeft, right, r, match.fRight, refined);
+        refined.push_back(match);
+        l = match.fLeft + match.fLength;
+        r = match.fRight + match.fLength;
+    }
+
+    QVector<QHexDiffHunk> hunks;
+    l = r = 0;
+    for (const Match& match : refined) {
+        if (match.fLeft > l || match.fRight > r)
+            _appendHunk(hunks, QHexDiffHunk { l, match.fLeft - l, r, match.fRight - r });
+        l = match.fLeft + match.fLength;
+        r = match.fRight + match.fLength;
+    }
+    return hunks;
+}
+
+qint64 QHexDiff::mapAddress(const QVector<QHexDiffHunk>& hunks, qint64 address,
+                            bool fromLeft)
+{
+    auto start = [fromLeft](const QHexDiffHunk& hunk) {
+        return fromLeft ? hunk.fLeftStart : hunk.fRightStart;
+    };
+    auto it = std::upper_bound(hunks.constBegin(), hunks.constEnd(), address,
+            [&start](qint64 addr, const QHexDiffHunk& hunk) { return addr < start(hunk); });
+    if (it == hunks.constBegin())
+        return address;
+
+    const QHexDiffHunk& hunk = *(it - 1);
+    const qint64 length = fromLeft ? hunk.fLeftLength : hunk.fRightLength;
+    const qint64 otherStart = fromLeft ? hunk.fRightStart : hunk.fLeftStart;
+    const qint64 otherLength = fromLeft ? hunk.fRightLength : hunk.fLeftLength;
+    const qint64 offset = address - start(hunk);
+    if (offset < length)
+        return otherStart + qMin(offset, qMax<qint64>(otherLength - 1, 0));
+    return otherStart + otherLength + (offset - length);
+}
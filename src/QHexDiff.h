@@ -0,0 +1,47 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QHEXDIFF_H
+#define _QHEXDIFF_H
+
+#include <QAtomicInt>
+#include <QVector>
+#include "QHexDataSource.h"
+
+/* A changed region: the left range was replaced by the right range.
+ * Either length may be zero for pure insertions and deletions. */
+struct QHexDiffHunk
+{
+    qint64 fLeftStart, fLeftLength;
+    qint64 fRightStart, fRightLength;
+};
+
+class QHexDiff
+{
+public:
+    // Align left against right and return the changed regions in order.
+    // Safe to run on a worker thread; returns an empty list once cancel
+    // is set.
+    static QVector<QHexDiffHunk> compare(const QHexDataSource* left,
+                                         const QHexDataSource* right,
+                                         const QAtomicInt* cancel = Q_NULLPTR);
+
+    // Find the address on the other side which lines up with address
+    static qint64 mapAddress(const QVector<QHexDiffHunk>& hunks, qint64 address,
+                             bool fromLeft);
+};
+
+#endif
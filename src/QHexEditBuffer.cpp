@@ -0,0 +1,164 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QHexEditBuffer.h"
+
+#include <cstring>
+#include <algorithm>
+
+QHexEditBuffer::QHexEditBuffer(const QSharedPointer<QHexDataSource>& original)
+    : fOriginal(original), fSize(original->size()), fUndoIndex(), fCleanIndex()
+{
+    if (fSize > 0) {
+        fPieces.append(Piece { false, 0, fSize });
+        fPieceStarts.append(0);
+    }
+}
+
+qint64 QHexEditBuffer::size() const
+{
+    QReadLocker lock(&fLock);
+    return fSize;
+}
+
+qint64 QHexEditBuffer::read(qint64 address, uchar* out, qint64 count) const
+{
+    QReadLocker lock(&fLock);
+    if (address < 0 || address >= fSize)
+        return 0;
+    count = qMin(count, fSize - address);
+
+    qint64 copied = 0;
+    for (int i = pieceAt(address); i < fPieces.size() && copied < count; ++i) {
+        const Piece& piece = fPieces[i];
+        const qint64 offset = address + copied - fPieceStarts[i];
+        const qint64 length = qMin(piece.fLength - offset, count - copied);
+        if (piece.fAdded) {
+            memcpy(out + copied, fAdded.constData() + piece.fStart + offset, length);
+        } else if (fOriginal->read(piece.fStart + offset, out + copied, length) != length) {
+            break;
+        }
+        copied += length;
+    }
+    return copied;
+}
+
+int QHexEditBuffer::pieceAt(qint64 address) const
+{
+    auto it = std::upper_bound(fPieceStarts.constBegin(), fPieceStarts.constEnd(), address);
+    return (int)(it - fPieceStarts.constBegin()) - 1;
+}
+
+void QHexEditBuffer::splice(int first, int count, const QVector<Piece>& pieces)
+{
+    fPieces = fPieces.mid(0, first) + pieces + fPieces.mid(first + count);
+
+    fPieceStarts.resize(fPieces.size());
+    qint64 start = (first > 0) ? fPieceStarts[first - 1] + fPieces[first - 1].fLength : 0;
+    for (int i = first; i < fPieces.size(); ++i) {
+        fPieceStarts[i] = start;
+        start += fPieces[i].fLength;
+    }
+    fSize = start;
+}
+
+void QHexEditBuffer::replace(qint64 address, qint64 count, const QByteArray& data, bool merge)
+{
+    QWriteLocker lock(&fLock);
+    address = qBound(Q_INT64_C(0), address, fSize);
+    count = qBound(Q_INT64_C(0), count, fSize - address);
+    if (count == 0 && data.isEmpty())
+        return;
+
+    // The pieces overlapping [address, address + count), plus the one
+    // being split if this is an insertion in the middle of a piece
+    const qint64 end = address + count;
+    int first = (address < fSize) ? pieceAt(address) : fPieces.size();
+    int last = (count > 0) ? pieceAt(end - 1) + 1 : first;
+    if (count == 0 && first < fPieces.size() && fPieceStarts[first] < address)
+        last = first + 1;
+
+    Edit edit;
+    edit.fFirst = first;
+    edit.fOld = fPieces.mid(first, last - first);
+    edit.fAddress = address;
+    edit.fEnd = address + data.size();
+    if (first < fPieces.size() && fPieceStarts[first] < address) {
+        const Piece& head = fPieces[first];
+        edit.fNew.append(Piece { head.fAdded, head.fStart, address - fPieceStarts[first] });
+    }
+    if (!data.isEmpty()) {
+        edit.fNew.append(Piece { true, fAdded.size(), data.size() });
+        fAdded.append(data);
+    }
+    if (last > first) {
+        const Piece& tail = fPieces[last - 1];
+        const qint64 tailEnd = fPieceStarts[last - 1] + tail.fLength;
+        if (tailEnd > end) {
+            edit.fNew.append(Piece { tail.fAdded, tail.fStart + (end - fPieceStarts[last - 1]),
+                                     tailEnd - end });
+        }
+    }
+    splice(edit.fFirst, edit.fOld.size(), edit.fNew);
+
+    // Anything that was undone can't be redone after a new edit
+    fEdits.resize(fUndoIndex);
+    if (fCleanIndex > fUndoIndex)
+        fCleanIndex = -1;
+
+    if (merge && !fEdits.isEmpty() && fCleanIndex != fUndoIndex) {
+        // Fold this edit into the last one if it stayed within the
+        // pieces that one produced
+        Edit& prev = fEdits.last();
+        const int offset = edit.fFirst - prev.fFirst;
+        if (offset >= 0 && offset + edit.fOld.size() <= prev.fNew.size()
+                && address >= prev.fAddress && end <= prev.fEnd) {
+            QVector<Piece> merged = prev.fNew.mid(0, offset);
+            merged += edit.fNew;
+            merged += prev.fNew.mid(offset + edit.fOld.size());
+            prev.fNew = merged;
+            prev.fEnd += data.size() - count;
+            return;
+        }
+    }
+    fEdits.append(edit);
+    ++fUndoIndex;
+}
+
+qint64 QHexEditBuffer::undo(qint64* length)
+{
+    QWriteLocker lock(&fLock);
+    if (fUndoIndex == 0)
+        return -1;
+    const Edit& edit = fEdits[--fUndoIndex];
+    const qint64 oldSize = fSize;
+    splice(edit.fFirst, edit.fNew.size(), edit.fOld);
+    if (length)
+        *length = edit.fEnd - edit.fAddress + (fSize - oldSize);
+    return edit.fAddress;
+}
+
+qint64 QHexEditBuffer::redo(qint64* length)
+{
+    QWriteLocker lock(&fLock);
+    if (fUndoIndex == fEdits.size())
+        return -1;
+    const Edit& edit = fEdits[fUndoIndex++];
+    splice(edit.fFirst, edit.fOld.size(), edit.fNew);
+    if (length)
+        *length = edit.fEnd - edit.fAddress;
+    return edit.fAddress;
+}
@@ -0,0 +1,90 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QHEXEDITBUFFER_H
+#define _QHEXEDITBUFFER_H
+
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QVector>
+#include "QHexDataSource.h"
+
+/* An editable view of another data source, kept as a piece table: the
+ * original bytes are never copied or modified, and every edit appends
+ * its new bytes to a separate buffer and splices a few pieces.  Undo and
+ * redo just swap pieces back, so they cost the same for a one-byte
+ * change as for a hundred megabytes. */
+class QHexEditBuffer : public QHexDataSource
+{
+public:
+    explicit QHexEditBuffer(const QSharedPointer<QHexDataSource>& original);
+
+    qint64 size() const Q_DECL_OVERRIDE;
+    qint64 read(qint64 address, uchar* out, qint64 count) const Q_DECL_OVERRIDE;
+
+    QSharedPointer<QHexDataSource> original() const { return fOriginal; }
+
+    // Replace count bytes at address with data, which may be a different
+    // size.  With merge set, the edit joins the last one on the undo stack
+    // if it only touches bytes that edit produced (e.g. typing the second
+    // nibble of a byte).
+    void replace(qint64 address, qint64 count, const QByteArray& data, bool merge = false);
+    void insert(qint64 address, const QByteArray& data) { replace(address, 0, data); }
+    void remove(qint64 address, qint64 count) { replace(address, count, QByteArray()); }
+
+    bool canUndo() const { return fUndoIndex > 0; }
+    bool canRedo() const { return fUndoIndex < fEdits.size(); }
+
+    // Each returns the address of the edit it reverted or reapplied, or -1.
+    // If length is given, it's set to how many bytes at that address now
+    // hold different contents.
+    qint64 undo(qint64* length = Q_NULLPTR);
+    qint64 redo(qint64* length = Q_NULLPTR);
+
+    bool isModified() const { return fUndoIndex != fCleanIndex; }
+    void setClean() { fCleanIndex = fUndoIndex; }
+
+private:
+    struct Piece
+    {
+        bool fAdded;        // In fAdded rather than fOriginal
+        qint64 fStart;
+        qint64 fLength;
+    };
+
+    // Pieces [fFirst, fFirst + fOld.size()) were replaced by fNew
+    struct Edit
+    {
+        int fFirst;
+        QVector<Piece> fOld, fNew;
+        qint64 fAddress, fEnd;
+    };
+
+    mutable QReadWriteLock fLock;
+    QSharedPointer<QHexDataSource> fOriginal;
+    QByteArray fAdded;
+    QVector<Piece> fPieces;
+    QVector<qint64> fPieceStarts;
+    qint64 fSize;
+
+    QVector<Edit> fEdits;
+    int fUndoIndex, fCleanIndex;
+
+    int pieceAt(qint64 address) const;
+    void splice(int first, int count, const QVector<Piece>& pieces);
+};
+
+#endif
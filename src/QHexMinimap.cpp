@@ -0,0 +1,336 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QHexMinimap.h"
+
+#include <QPainter>
+#include <QScrollBar>
+#include <QMouseEvent>
+#include <QToolTip>
+#include <QRunnable>
+#include <cmath>
+#include "QHexWidget.h"
+
+// Blocks are at least this big, and grow in powers of two so there are
+// never more than MAX_BLOCKS of them no matter how large the data is
+#define MIN_BLOCK_SIZE  (256)
+#define MAX_BLOCKS      (16384)
+
+static QHexMinimap::BlockStats blockStats(const uchar* data, qint64 size)
+{
+    QHexMinimap::BlockStats stats = { 0.0f, 0, 0, 0 };
+    if (size <= 0)
+        return stats;
+
+    quint32 counts[256] = { };
+    for (qint64 i = 0; i < size; ++i)
+        ++counts[data[i]];
+
+    double entropy = 0.0;
+    quint64 text = counts['\t'] + counts['\n'] + counts['\r'];
+    quint64 high = 0;
+    for (int ch = 0; ch < 256; ++ch) {
+        if (counts[ch]) {
+            const double p = (double)counts[ch] / size;
+            entropy -= p * std::log2(p);
+        }
+        if (ch >= 0x20 && ch < 0x7f)
+            text += counts[ch];
+        else if (ch >= 0x80)
+            high += counts[ch];
+    }
+    stats.fEntropy = (float)entropy;
+    stats.fZero = (quint8)((quint64)counts[0] * 255 / size);
+    stats.fText = (quint8)(text * 255 / size);
+    stats.fHigh = (quint8)(high * 255 / size);
+    return stats;
+}
+
+static QHexMinimap::BlockStats averageStats(const QHexMinimap::BlockStats* blocks, int count)
+{
+    float entropy = 0.0f;
+    int zero = 0, text = 0, high = 0;
+    for (int i = 0; i < count; ++i) {
+        entropy += blocks[i].fEntropy;
+        zero += blocks[i].fZero;
+        text += blocks[i].fText;
+        high += blocks[i].fHigh;
+    }
+    QHexMinimap::BlockStats stats = {
+        entropy / count, (quint8)(zero / count), (quint8)(text / count),
+        (quint8)(high / count)
+    };
+    return stats;
+}
+
+class BlockScanner : public QRunnable
+{
+public:
+    BlockScanner(const QSharedPointer<QHexDataSource>& data, qint64 blockSize,
+                 QHexMinimap::BlockStats* blocks, int first, int count,
+                 QAtomicInt* scanned, const QAtomicInt* cancel)
+        : fData(data), fBlockSize(blockSize), fBlocks(blocks), fFirst(first),
+          fCount(count), fScanned(scanned), fCancel(cancel) { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        std::vector<uchar> buffer(fBlockSize);
+        for (int i = fFirst; i < fCount && !fCancel->loadAcquire(); ++i) {
+            qint64 size = fData->read(i * fBlockSize, buffer.data(), fBlockSize);
+            fBlocks[i] = blockStats(buffer.data(), size);
+            fScanned->storeRelease(i + 1);
+        }
+    }
+
+private:
+    QSharedPointer<QHexDataSource> fData;
+    qint64 fBlockSize;
+    QHexMinimap::BlockStats* fBlocks;
+    int fFirst, fCount;
+    QAtomicInt* fScanned;
+    const QAtomicInt* fCancel;
+};
+
+QHexMinimap::QHexMinimap(QHexWidget* hexWidget, QWidget* parent)
+    : QWidget(parent), fHexWidget(hexWidget), fBlockSize(MIN_BLOCK_SIZE), fDataSize(),
+      fDirtyStart(-1), fDirtyEnd(), fDirtyMoved()
+{
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
+    setCursor(Qt::PointingHandCursor);
+    fPool.setMaxThreadCount(1);
+
+    fProgressTimer.setInterval(100);
+    connect(&fProgressTimer, &QTimer::timeout, this, [this] {
+        update();
+        if (fScanned.loadAcquire() >= (int)fBlocks.size())
+            fProgressTimer.stop();
+    });
+
+    // Edits are collected for a moment, so typing doesn't rescan the same
+    // block on every keystroke
+    fEditTimer.setSingleShot(true);
+    fEditTimer.setInterval(500);
+    connect(&fEditTimer, &QTimer::timeout, this, &QHexMinimap::rescanEdited);
+
+    connect(fHexWidget, &QHexWidget::dataSourceChanged, this, &QHexMinimap::refresh);
+    connect(fHexWidget, &QHexWidget::dataEdited, this, &QHexMinimap::dataEdited);
+    connect(fHexWidget->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, static_cast<void (QWidget::*)()>(&QWidget::update));
+
+    refresh();
+}
+
+QHexMinimap::~QHexMinimap()
+{
+    cancelScan();
+}
+
+QSize QHexMinimap::sizeHint() const
+{
+    return QSize(32, 100);
+}
+
+static qint64 blockSizeFor(qint64 size)
+{
+    qint64 blockSize = MIN_BLOCK_SIZE;
+    while (size / blockSize >= MAX_BLOCKS)
+        blockSize *= 2;
+    return blockSize;
+}
+
+void QHexMinimap::refresh()
+{
+    cancelScan();
+    fEditTimer.stop();
+    fDirtyStart = -1;
+
+    fData = fHexWidget->dataSource();
+    fDataSize = fData->size();
+    fBlockSize = blockSizeFor(fDataSize);
+    fBlocks.assign((size_t)((fDataSize + fBlockSize - 1) / fBlockSize), BlockStats());
+    startScan(0);
+    update();
+}
+
+void QHexMinimap::dataEdited(qint64 address, qint64 length)
+{
+    // An edit that changes the size moves everything after it, so those
+    // blocks all have to be scanned again
+    const qint64 size = fHexWidget->dataSize();
+    if (fDirtyStart < 0) {
+        fDirtyStart = address;
+        fDirtyEnd = address + length;
+    } else {
+        fDirtyStart = qMin(fDirtyStart, address);
+        fDirtyEnd = qMax(fDirtyEnd, address + length);
+    }
+    if (size != fDataSize)
+        fDirtyMoved = true;
+    fDataSize = size;
+    fEditTimer.start();
+}
+
+void QHexMinimap::rescanEdited()
+{
+    if (fDirtyStart < 0)
+        return;
+
+    // Editing swaps in an edit buffer without changing the data source
+    cancelScan();
+    fData = fHexWidget->dataSource();
+    const qint64 size = fData->size();
+    if (blockSizeFor(size) != fBlockSize) {
+        refresh();
+        return;
+    }
+
+    fBlocks.resize((size_t)((size + fBlockSize - 1) / fBlockSize));
+    const int first = (int)(fDirtyStart / fBlockSize);
+    int scanned = qMin(fScanned.loadAcquire(), (int)fBlocks.size());
+    if (fDirtyMoved) {
+        scanned = qMin(scanned, first);
+    } else {
+        // Only the blocks the edits touched are read again; any that the
+        // scan hadn't reached yet are left to it
+        const int last = qMin((int)((qMin(fDirtyEnd, size) - 1) / fBlockSize) + 1, scanned);
+        std::vector<uchar> buffer(fBlockSize);
+        for (int i = first; i < last; ++i) {
+            qint64 got = fData->read(i * fBlockSize, buffer.data(), fBlockSize);
+            fBlocks[i] = blockStats(buffer.data(), got);
+        }
+    }
+    fDirtyStart = -1;
+    fDirtyMoved = false;
+
+    startScan(scanned);
+    update();
+}
+
+void QHexMinimap::startScan(int first)
+{
+    fScanned.storeRelease(first);
+    if (first < (int)fBlocks.size()) {
+        fPool.start(new BlockScanner(fData, fBlockSize, fBlocks.data(), first,
+                                     (int)fBlocks.size(), &fScanned, &fCancel));
+        fProgressTimer.start();
+    }
+}
+
+void QHexMinimap::cancelScan()
+{
+    fCancel.storeRelease(1);
+    fPool.waitForDone();
+    fCancel.storeRelease(0);
+    fProgressTimer.stop();
+}
+
+bool QHexMinimap::rowBlocks(int y, int& first, int& last) const
+{
+    const qint64 count = (qint64)fBlocks.size();
+    if (count == 0 || y < 0 || y >= height())
+        return false;
+    first = (int)(y * count / height());
+    last = qMax(first + 1, (int)((y + 1) * count / height()));
+    return true;
+}
+
+QColor QHexMinimap::blockColor(const BlockStats& stats)
+{
+    if (stats.fZero >= 242)
+        return QColor(24, 24, 24);
+    if (stats.fText >= 204)
+        return QColor(70, 130, 220);
+    if (stats.fEntropy >= 7.2f)
+        return QColor(215, 50, 45);
+
+    // Everything else shades from green (sparse, structured) to yellow
+    // (packed) as the entropy goes up
+    const qreal t = stats.fEntropy / 7.2f;
+    return QColor::fromRgbF(0.30 + 0.62 * t, 0.65 + 0.15 * t, 0.30 - 0.10 * t);
+}
+
+bool QHexMinimap::event(QEvent* event)
+{
+    if (event->type() == QEvent::ToolTip) {
+        QHelpEvent* help = static_cast<QHelpEvent*>(event);
+        int first, last;
+        if (rowBlocks(help->y(), first, last)) {
+            QString text = tr("%1 - %2").arg(first * fBlockSize, 8, 16, QChar('0'))
+                           .arg(qMin(last * fBlockSize, fData->size()) - 1, 8, 16, QChar('0'));
+            const int scanned = fScanned.loadAcquire();
+            if (first < scanned) {
+                BlockStats stats = averageStats(&fBlocks[first], qMin(last, scanned) - first);
+                text += tr("\nEntropy: %1 bits/byte\nZero: %2%  Text: %3%  High: %4%")
+                        .arg(stats.fEntropy, 0, 'f', 2)
+                        .arg(stats.fZero * 100 / 255).arg(stats.fText * 100 / 255)
+                        .arg(stats.fHigh * 100 / 255);
+            } else {
+                text += tr("\nScanning...");
+            }
+            QToolTip::showText(help->globalPos(), text, this);
+        } else {
+            QToolTip::hideText();
+            event->ignore();
+        }
+        return true;
+    }
+    return QWidget::event(event);
+}
+
+void QHexMinimap::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().color(QPalette::Window));
+
+    // Each row averages however many blocks land on it
+    const int scanned = fScanned.loadAcquire();
+    int first, last;
+    for (int y = 0; rowBlocks(y, first, last) && first < scanned; ++y) {
+        BlockStats stats = averageStats(&fBlocks[first], qMin(last, scanned) - first);
+        painter.fillRect(0, y, width(), 1, blockColor(stats));
+    }
+
+    // Outline the part the hex view is showing
+    const qint64 size = fData->size();
+    if (size > 0) {
+        const int y0 = (int)(fHexWidget->firstVisibleAddress() * height() / size);
+        const int y1 = (int)(qMin(fHexWidget->lastVisibleAddress(), size) * height() / size);
+        painter.setPen(palette().color(QPalette::Highlight));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(0, y0, width() - 1, qMax(y1 - y0, 2));
+    }
+}
+
+void QHexMinimap::jumpTo(int y)
+{
+    const qint64 size = fData->size();
+    if (size <= 0 || height() <= 0)
+        return;
+    y = qBound(0, y, height() - 1);
+    fHexWidget->setCurrentAddress((qint64)y * size / height());
+}
+
+void QHexMinimap::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() == Qt::LeftButton)
+        jumpTo(event->y());
+}
+
+void QHexMinimap::mouseMoveEvent(QMouseEvent* event)
+{
+    if (event->buttons() & Qt::LeftButton)
+        jumpTo(event->y());
+}
@@ -0,0 +1,88 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QHEXMINIMAP_H
+#define _QHEXMINIMAP_H
+
+#include <QWidget>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QTimer>
+#include <QSharedPointer>
+#include <vector>
+#include "QHexDataSource.h"
+
+class QHexWidget;
+
+/* A strip showing the whole of a QHexWidget's data at once, colored by
+ * the entropy and byte classes of each block: zero fill, text, packed
+ * structures and compressed data all look different.  The blocks are
+ * scanned in the background and painted as they come in, so it works
+ * on files far too large to read up front. */
+class QHexMinimap : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit QHexMinimap(QHexWidget* hexWidget, QWidget* parent = Q_NULLPTR);
+    ~QHexMinimap();
+
+    QSize sizeHint() const Q_DECL_OVERRIDE;
+
+public slots:
+    void refresh();
+
+private slots:
+    void dataEdited(qint64 address, qint64 length);
+    void rescanEdited();
+
+protected:
+    bool event(QEvent*) Q_DECL_OVERRIDE;
+    void paintEvent(QPaintEvent*) Q_DECL_OVERRIDE;
+    void mousePressEvent(QMouseEvent*) Q_DECL_OVERRIDE;
+    void mouseMoveEvent(QMouseEvent*) Q_DECL_OVERRIDE;
+
+public:
+    struct BlockStats
+    {
+        float fEntropy;                 // Bits per byte, 0 - 8
+        quint8 fZero, fText, fHigh;     // Fractions of the block, out of 255
+    };
+
+private:
+    QHexWidget* fHexWidget;
+    QSharedPointer<QHexDataSource> fData;
+    qint64 fBlockSize, fDataSize;
+    std::vector<BlockStats> fBlocks;
+
+    // The scan writes fBlocks in order and publishes how far it got in
+    // fScanned, so painting never has to wait for it
+    QThreadPool fPool;
+    QAtomicInt fScanned, fCancel;
+    QTimer fProgressTimer, fEditTimer;
+
+    // Byte range touched by edits since the last rescan, or a start of -1
+    qint64 fDirtyStart, fDirtyEnd;
+    bool fDirtyMoved;
+
+    void startScan(int first);
+    void cancelScan();
+    void jumpTo(int y);
+    bool rowBlocks(int y, int& first, int& last) const;
+    static QColor blockColor(const BlockStats& stats);
+};
+
+#endif
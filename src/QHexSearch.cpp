@@ -0,0 +1,145 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QHexSearch.h"
+
+#include <QRegExp>
+#include <QtEndian>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define SEARCH_CHUNK_SIZE  (4 * 1024 * 1024)
+
+QByteArray QHexSearch::makePattern(const QString& text, Mode mode)
+{
+    switch (mode) {
+    case kHexBytes:
+        {
+            QString hex = text;
+            hex.remove(QRegExp("\\s"));
+            if (!QRegExp("([0-9A-Fa-f]{2})+").exactMatch(hex))
+                return QByteArray();
+            return QByteArray::fromHex(hex.toLatin1());
+        }
+    case kAscii:
+        return text.toLatin1();
+    case kInvertedString:
+        {
+            QByteArray pattern = text.toLatin1();
+            for (int i = 0; i < pattern.size(); ++i)
+                pattern[i] = ~pattern[i];
+            return pattern;
+        }
+    case kInt32:
+        {
+            bool ok;
+            qlonglong value = text.trimmed().toLongLong(&ok, 0);
+            if (!ok || value < INT32_MIN || value > UINT32_MAX)
+                return QByteArray();
+            uchar bytes[4];
+            qToLittleEndian<quint32>((quint32)value, bytes);
+            return QByteArray((const char*)bytes, sizeof(bytes));
+        }
+    case kFloat:
+        {
+            bool ok;
+            float value = text.trimmed().toFloat(&ok);
+            if (!ok)
+                return QByteArray();
+            quint32 bits;
+            memcpy(&bits, &value, sizeof(bits));
+            uchar bytes[4];
+            qToLittleEndian<quint32>(bits, bytes);
+            return QByteArray((const char*)bytes, sizeof(bytes));
+        }
+    }
+    return QByteArray();
+}
+
+QVector<qint64> QHexSearch::findAll(const QHexDataSource* data, const QByteArray& pattern,
+                                    qint64 from, qint64 to, int maxHits,
+                                    const QAtomicInt* cancel)
+{
+    QVector<qint64> hits;
+    const int length = pattern.size();
+    const uchar* pat = reinterpret_cast<const uchar*>(pattern.constData());
+    const qint64 size = data->size();
+    to = qMin(to, size);
+    if (length == 0 || from < 0 || maxHits <= 0)
+        return hits;
+
+    // Horspool skip table for longer patterns
+    size_t skip[256];
+    for (size_t& s : skip)
+        s = length;
+    for (int i = 0; i < length - 1; ++i)
+        skip[pat[i]] = length - 1 - i;
+
+    // Chunks overlap by length - 1 bytes so matches straddling a chunk
+    // boundary are still found, but each start is only scanned once.
+    // Only the start has to be before to; a match may run past it.
+    std::vector<uchar> chunk(SEARCH_CHUNK_SIZE + length - 1);
+    for (qint64 base = from; base < to && base + length <= size; base += SEARCH_CHUNK_SIZE) {
+        if (cancel && cancel->loadAcquire())
+            break;
+
+        qint64 got = data->read(base, chunk.data(),
+                                qMin((qint64)chunk.size(), size - base));
+        if (got < length)
+            break;
+
+        const uchar* start = chunk.data();
+        const uchar* last = start + qMin(qMin(got - length, (qint64)SEARCH_CHUNK_SIZE - 1),
+                                         to - 1 - base);
+        const uchar* p = start;
+        if (length < 4) {
+            // Short patterns: memchr for the first byte is vectorized by
+            // every C library we care about, and beats Horspool here
+            while (p <= last) {
+                p = static_cast<const uchar*>(memchr(p, pat[0], last - p + 1));
+                if (p == Q_NULLPTR)
+                    break;
+                if (memcmp(p + 1, pat + 1, length - 1) == 0) {
+                    hits.append(base + (p - start));
+                    if (hits.size() >= maxHits)
+                        return hits;
+                }
+                ++p;
+            }
+        } else {
+            while (p <= last) {
+                uchar tail = p[length - 1];
+                if (tail == pat[length - 1] && memcmp(p, pat, length - 1) == 0) {
+                    hits.append(base + (p - start));
+                    if (hits.size() >= maxHits)
+                        return hits;
+                }
+                p += skip[tail];
+            }
+        }
+    }
+    return hits;
+}
+
+qint64 QHexSearch::findNext(const QHexDataSource* data, const QByteArray& pattern,
+                            qint64 address, const QAtomicInt* cancel)
+{
+    QVector<qint64> hits = findAll(data, pattern, address + 1, data->size(), 1, cancel);
+    if (hits.isEmpty())
+        hits = findAll(data, pattern, 0, address + 1, 1, cancel);
+    return hits.isEmpty() ? -1 : hits.first();
+}
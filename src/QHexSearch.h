@@ -0,0 +1,49 @@
+/* This file is part of PlasmaShop.
+ *
+ * PlasmaShop is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PlasmaShop is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PlasmaShop.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QHEXSEARCH_H
+#define _QHEXSEARCH_H
+
+#include <QAtomicInt>
+#include <QVector>
+#include "QHexDataSource.h"
+
+class QHexSearch
+{
+public:
+    enum Mode
+    {
+        kHexBytes, kAscii, kInvertedString, kInt32, kFloat
+    };
+
+    // Convert the user's search text into the byte pattern to look for.
+    // Returns an empty pattern if the text isn't valid for the mode.
+    static QByteArray makePattern(const QString& text, Mode mode);
+
+    // Find up to maxHits occurrences of pattern which start in [from, to).
+    // A match may extend past to, so a range can be searched in pieces.
+    // Safe to run on a worker thread; stops early once cancel is set.
+    static QVector<qint64> findAll(const QHexDataSource* data, const QByteArray& pattern,
+                                   qint64 from, qint64 to, int maxHits,
+                                   const QAtomicInt* cancel = Q_NULLPTR);
+
+    // Find the first occurrence after address, wrapping around to the
+    // start of the data.  Returns -1 if there are none.
+    static qint64 findNext(const QHexDataSource* data, const QByteArray& pattern,
+                           qint64 address, const QAtomicInt* cancel = Q_NULLPTR);
+};
+
+#endif
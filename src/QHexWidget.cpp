@@ -24,21 +24,26 @@
 #include <QScrollBar>
 #include <QMouseEvent>
 #include <QKeyEvent>
-#include <QFile>
+#include <QToolTip>
 #include <QMessageBox>
+#include <climits>
+#include <algorithm>
 
 #define HEX_PADDING     (2)
 #define BYTES_PER_LINE  (16)
 
 QHexWidget::QHexWidget(QWidget* parent)
-    : QAbstractScrollArea(parent), fCurrentAddress(), fViewportAddress(),
-      fSelectionStart(-1)
+    : QAbstractScrollArea(parent), fData(new QHexByteArraySource(QByteArray())),
+      fCurrentAddress(), fViewportAddress(), fSelectionStart(-1),
+      fHighlightLength(), fReadOnly(true), fOverwrite(true), fEditChars(),
+      fLowNibble()
 {
     // Should be enough to get a reasonable fixed-width font on all
     // supported platforms...
     QFont defaultFont("Monospace", 10);
     defaultFont.setStyleHint(QFont::TypeWriter);
     setFont(defaultFont);
+    updateMetrics();
 
     setFocusPolicy(Qt::StrongFocus);
 }
@@ -47,7 +52,7 @@ QSize QHexWidget::sizeHint() const
 {
     QFontMetrics fm(font());
     int byteOffset, charOffset, rightMargin;
-    getRenderMetrics(fm, 0x10000000, byteOffset, charOffset, rightMargin);
+    getRenderMetrics(0x10000000, byteOffset, charOffset, rightMargin);
     const int scrollWidth = style()->pixelMetric(QStyle::PM_ScrollBarExtent);
 
     // Full view width * 25 visible lines
@@ -55,16 +60,16 @@ QSize QHexWidget::sizeHint() const
                  (fm.height() * 25) + 5);
 }
 
-int QHexWidget::lastVisibleAddress() const
+qint64 QHexWidget::lastVisibleAddress() const
 {
     QFontMetrics fm(font());
     return fViewportAddress + (visibleLines(fm, viewport()->height()) * BYTES_PER_LINE);
 }
 
-QPair<int, int> QHexWidget::selection() const
+QPair<qint64, qint64> QHexWidget::selection() const
 {
-    int loSelect = fSelectionStart;
-    int hiSelect = loSelect >= 0 ? fCurrentAddress : -1;
+    qint64 loSelect = fSelectionStart;
+    qint64 hiSelect = loSelect >= 0 ? fCurrentAddress : -1;
     if (loSelect > hiSelect)
         qSwap(loSelect, hiSelect);
     return qMakePair(loSelect, hiSelect);
@@ -72,53 +77,162 @@ QPair<int, int> QHexWidget::selection() const
 
 void QHexWidget::loadFromData(const QByteArray& data)
 {
-    fData = data;
+    setDataSource(QSharedPointer<QHexDataSource>(new QHexByteArraySource(data)));
+}
+
+bool QHexWidget::loadFromFile(const QString& fileName, qint64 offset, qint64 size)
+{
+    QHexFileSource* source = new QHexFileSource(fileName, offset, size);
+    if (!source->isOpen()) {
+        delete source;
+        loadFromData(QByteArray());
+        return false;
+    }
+
+    setDataSource(QSharedPointer<QHexDataSource>(source));
+    return true;
+}
+
+void QHexWidget::setDataSource(const QSharedPointer<QHexDataSource>& source)
+{
+    fData = source;
+    fEdit.clear();
+    if (!fReadOnly) {
+        fEdit.reset(new QHexEditBuffer(source));
+        fData = fEdit;
+    }
+    fLowNibble = false;
     fViewportAddress = 0;
     fCurrentAddress = 0;
     fSelectionStart = -1;
+    fHighlights.clear();
+    fAnnotations.clear();
     resizeEvent(Q_NULLPTR);
+    verticalScrollBar()->setValue(0);
     viewport()->update();
     emit currentAddressChanged(fCurrentAddress);
+    emit dataSourceChanged();
 }
 
-bool QHexWidget::loadFromFile(const QString& fileName)
+uchar QHexWidget::byteAt(qint64 address) const
 {
-    QFile fin(fileName);
-    if (!fin.open(QIODevice::ReadOnly)) {
-        loadFromData(QByteArray());
-        return false;
+    uchar value = 0;
+    fData->read(address, &value, 1);
+    return value;
+}
+
+void QHexWidget::setReadOnly(bool readOnly)
+{
+    fReadOnly = readOnly;
+    if (!fReadOnly && !fEdit) {
+        fEdit.reset(new QHexEditBuffer(fData));
+        fData = fEdit;
     }
+    fLowNibble = false;
+    setCurrentAddress(fCurrentAddress);
+    viewport()->update();
+}
 
-    loadFromData(fin.readAll());
-    fin.close();
-    return true;
+void QHexWidget::undo()
+{
+    qint64 length = 0;
+    qint64 address = fEdit ? fEdit->undo(&length) : -1;
+    if (address >= 0) {
+        fSelectionStart = -1;
+        dataResized();
+        setCurrentAddress(address);
+        emit dataEdited(address, length);
+    }
+}
+
+void QHexWidget::redo()
+{
+    qint64 length = 0;
+    qint64 address = fEdit ? fEdit->redo(&length) : -1;
+    if (address >= 0) {
+        fSelectionStart = -1;
+        dataResized();
+        setCurrentAddress(address);
+        emit dataEdited(address, length);
+    }
+}
+
+void QHexWidget::setHighlights(const QVector<qint64>& addresses, int length)
+{
+    fHighlights = addresses;
+    fHighlightLength = length;
+    viewport()->update();
+}
+
+void QHexWidget::setAnnotations(const QVector<Annotation>& annotations)
+{
+    fAnnotations = annotations;
+    viewport()->update();
+}
+
+static bool _annotationBefore(const QHexWidget::Annotation& ann, qint64 address)
+{
+    return ann.fStart + ann.fLength <= address;
+}
+
+const QHexWidget::Annotation* QHexWidget::annotationAt(qint64 address) const
+{
+    auto it = std::lower_bound(fAnnotations.constBegin(), fAnnotations.constEnd(),
+                               address, _annotationBefore);
+    if (it == fAnnotations.constEnd() || it->fStart > address)
+        return Q_NULLPTR;
+    return &(*it);
 }
 
-void QHexWidget::setCurrentAddress(int address)
+void QHexWidget::setSelection(qint64 start, qint64 end)
 {
+    setCurrentAddress(end);
+    fSelectionStart = (start != end) ? start : -1;
+    viewport()->update();
+    emit currentAddressChanged(fCurrentAddress);
+}
+
+void QHexWidget::setCurrentAddress(qint64 address)
+{
+    // When editing, the cursor can sit just past the end to append
+    const qint64 lastAddress = fReadOnly ? qMax(Q_INT64_C(0), fData->size() - 1)
+                                         : fData->size();
+    if (address < 0)
+        address = 0;
+    else if (address > lastAddress)
+        address = lastAddress;
     if (address == fCurrentAddress)
         return;
 
-    if (address < 0)
-        fCurrentAddress = 0;
-    else if (address >= fData.size())
-        fCurrentAddress = fData.size() - 1;
-    else
-        fCurrentAddress = address;
+    fCurrentAddress = address;
+    fLowNibble = false;
 
     QFontMetrics fm(font());
     const int lines = visibleLines(fm, viewport()->height());
     if (    fCurrentAddress < fViewportAddress
          || fCurrentAddress >= fViewportAddress + (lines * BYTES_PER_LINE)) {
-        int line = fCurrentAddress / BYTES_PER_LINE;
+        qint64 line = fCurrentAddress / BYTES_PER_LINE;
         line -= lines / 2;
-        verticalScrollBar()->setValue(line);
+        verticalScrollBar()->setValue((int)qBound(Q_INT64_C(0), line, (qint64)INT_MAX));
     }
 
     viewport()->update();
     emit currentAddressChanged(fCurrentAddress);
 }
 
+void QHexWidget::changeEvent(QEvent* event)
+{
+    if (event->type() == QEvent::FontChange) {
+        updateMetrics();
+        resizeEvent(Q_NULLPTR);
+    } else if (event->type() == QEvent::PaletteChange
+            || event->type() == QEvent::StyleChange) {
+        for (QPixmap& atlas : fGlyphAtlas)
+            atlas = QPixmap();
+    }
+    QAbstractScrollArea::changeEvent(event);
+}
+
 void QHexWidget::paintEvent(QPaintEvent*)
 {
     QPainter painter(viewport());
@@ -130,8 +244,10 @@ void QHexWidget::resizeEvent(QResizeEvent* event)
     if (event)
         QAbstractScrollArea::resizeEvent(event);
 
+    // The scroll bar counts lines, which keeps its int range good for
+    // files up to 32 GB
     QFontMetrics fm(font());
-    int lines = fData.size();
+    qint64 lines = fData->size();
     lines = (lines + (BYTES_PER_LINE - 1)) / BYTES_PER_LINE;
     lines -= visibleLines(fm, viewport()->height());
 
@@ -139,16 +255,21 @@ void QHexWidget::resizeEvent(QResizeEvent* event)
         verticalScrollBar()->setMaximum(0);
         return;
     }
-    verticalScrollBar()->setMaximum(lines);
+    verticalScrollBar()->setMaximum((int)qMin(lines, (qint64)INT_MAX));
 }
 
 void QHexWidget::mousePressEvent(QMouseEvent* event)
 {
-    int clickAddr = addressAt(event->x(), event->y());
+    qint64 clickAddr = addressAt(event->x(), event->y());
     if (clickAddr >= 0) {
         if (event->button() == Qt::LeftButton)
             fSelectionStart = -1;
 
+        int byteOffset, charOffset, rightMargin;
+        getRenderMetrics(fData->size(), byteOffset, charOffset, rightMargin);
+        fEditChars = (event->x() >= charOffset);
+        fLowNibble = false;
+
         if (fCurrentAddress != clickAddr) {
             fCurrentAddress = clickAddr;
             viewport()->update();
@@ -159,7 +280,7 @@ void QHexWidget::mousePressEvent(QMouseEvent* event)
 
 void QHexWidget::mouseMoveEvent(QMouseEvent* event)
 {
-    int clickAddr = addressAt(event->x(), event->y());
+    qint64 clickAddr = addressAt(event->x(), event->y());
     if (clickAddr >= 0) {
         if (event->buttons() & Qt::LeftButton) {
             if (fSelectionStart < 0 && clickAddr != fCurrentAddress)
@@ -181,7 +302,10 @@ void QHexWidget::mouseReleaseEvent(QMouseEvent*)
 
 void QHexWidget::keyPressEvent(QKeyEvent* event)
 {
-    int addr = fCurrentAddress;
+    if (!fReadOnly && editKey(event))
+        return;
+
+    qint64 addr = fCurrentAddress;
     QFontMetrics fm(font());
     const int lines = visibleLines(fm, viewport()->height());
 
@@ -224,43 +348,137 @@ void QHexWidget::keyPressEvent(QKeyEvent* event)
     }
 }
 
-void QHexWidget::scrollContentsBy(int, int dy)
+bool QHexWidget::editKey(QKeyEvent* event)
 {
-    fViewportAddress -= (dy * BYTES_PER_LINE);
-    if (fViewportAddress < 0)
-        fViewportAddress = 0;
-    viewport()->update();
+    if (event->matches(QKeySequence::Undo)) {
+        undo();
+        return true;
+    } else if (event->matches(QKeySequence::Redo)) {
+        redo();
+        return true;
+    }
+
+    const QPair<qint64, qint64> select = selection();
+    if (event->modifiers() == Qt::NoModifier) {
+        switch (event->key()) {
+        case Qt::Key_Insert:
+            fOverwrite = !fOverwrite;
+            fLowNibble = false;
+            viewport()->update();
+            emit overwriteModeChanged(fOverwrite);
+            return true;
+        case Qt::Key_Delete:
+            if (select.first >= 0)
+                removeBytes(select.first, select.second - select.first + 1);
+            else if (fCurrentAddress < fData->size())
+                removeBytes(fCurrentAddress, 1);
+            return true;
+        case Qt::Key_Backspace:
+            if (select.first >= 0)
+                removeBytes(select.first, select.second - select.first + 1);
+            else if (fCurrentAddress > 0)
+                removeBytes(fCurrentAddress - 1, 1);
+            return true;
+        default:
+            break;
+        }
+    }
+
+    if (event->modifiers() & ~(Qt::ShiftModifier | Qt::KeypadModifier))
+        return false;
+    const QString text = event->text();
+    if (text.size() != 1)
+        return false;
+    const ushort ch = text[0].unicode();
+
+    const bool append = (fCurrentAddress >= fData->size());
+    if (fEditChars) {
+        if (ch < 0x20 || ch > 0x7e)
+            return false;
+        writeByte((uchar)ch, !fOverwrite || append, false);
+        setCurrentAddress(fCurrentAddress + 1);
+        return true;
+    }
+
+    int digit;
+    if (ch >= '0' && ch <= '9')
+        digit = ch - '0';
+    else if (ch >= 'a' && ch <= 'f')
+        digit = ch - 'a' + 10;
+    else if (ch >= 'A' && ch <= 'F')
+        digit = ch - 'A' + 10;
+    else
+        return false;
+
+    if (!fLowNibble) {
+        const uchar old = (!fOverwrite || append) ? 0 : byteAt(fCurrentAddress);
+        writeByte((uchar)((digit << 4) | (old & 0x0F)), !fOverwrite || append, false);
+        fLowNibble = true;
+        viewport()->update();
+    } else {
+        // Both nibbles of a byte are undone together
+        writeByte((uchar)((byteAt(fCurrentAddress) & 0xF0) | digit), false, true);
+        setCurrentAddress(fCurrentAddress + 1);
+    }
+    return true;
 }
 
-int QHexWidget::visibleLines(const QFontMetrics& fm, int viewportHeight) const
+void QHexWidget::writeByte(uchar value, bool insert, bool merge)
 {
-    return viewportHeight / fm.height();
+    fSelectionStart = -1;
+    const qint64 address = fCurrentAddress;
+    fEdit->replace(address, insert ? 0 : 1, QByteArray(1, (char)value), merge);
+    dataResized();
+    emit dataEdited(address, 1);
 }
 
-void QHexWidget::getRenderMetrics(const QFontMetrics& fm, int maxAddress,
-                                  int& byteOffset, int& charOffset,
-                                  int& rightMargin) const
+void QHexWidget::removeBytes(qint64 address, qint64 count)
 {
-    if (maxAddress >= 0x10000)
-        byteOffset = fm.boundingRect("0000 0000").width() + (HEX_PADDING * 2);
-    else
-        byteOffset = fm.boundingRect("0000").width() + (HEX_PADDING * 2);
+    fSelectionStart = -1;
+    fEdit->remove(address, count);
+    dataResized();
+    setCurrentAddress(address);
+    emit dataEdited(address, 0);
+}
 
-    const int bwidth = fm.boundingRect("00_").width();
-    const int swidth = fm.boundingRect(QChar('_')).width();
-    charOffset = byteOffset + HEX_PADDING + (bwidth * BYTES_PER_LINE)
-                            + (swidth * ((BYTES_PER_LINE / 4) + 1));
-    rightMargin = charOffset + (swidth * (BYTES_PER_LINE + 1));
+void QHexWidget::dataResized()
+{
+    resizeEvent(Q_NULLPTR);
+    if (fCurrentAddress > fData->size())
+        fCurrentAddress = fData->size();
+    viewport()->update();
 }
 
-static QString _formatAddress(int address, int maxAddress)
+bool QHexWidget::viewportEvent(QEvent* event)
 {
-    if (maxAddress > 0x10000) {
-        return QString("%1 %2").arg((address >> 16) & 0xFFFF, 4, 16, QChar('0'))
-                               .arg((address      ) & 0xFFFF, 4, 16, QChar('0'));
-    } else {
-        return QString("%1").arg(address & 0xFFFF, 4, 16, QChar('0'));
+    if (event->type() == QEvent::ToolTip) {
+        QHelpEvent* help = static_cast<QHelpEvent*>(event);
+        qint64 addr = addressAt(help->x(), help->y());
+        const Annotation* ann = (addr >= 0) ? annotationAt(addr) : Q_NULLPTR;
+        if (ann) {
+            QToolTip::showText(help->globalPos(),
+                    tr("%1\n%2 - %3 (%4 bytes)").arg(ann->fLabel)
+                      .arg(ann->fStart, 8, 16, QChar('0'))
+                      .arg(ann->fStart + ann->fLength - 1, 8, 16, QChar('0'))
+                      .arg(ann->fLength), viewport());
+        } else {
+            QToolTip::hideText();
+            event->ignore();
+        }
+        return true;
     }
+    return QAbstractScrollArea::viewportEvent(event);
+}
+
+void QHexWidget::scrollContentsBy(int, int)
+{
+    fViewportAddress = (qint64)verticalScrollBar()->value() * BYTES_PER_LINE;
+    viewport()->update();
+}
+
+int QHexWidget::visibleLines(const QFontMetrics& fm, int viewportHeight) const
+{
+    return viewportHeight / fm.height();
 }
 
 static bool _isNonPrintable(uchar ch)
@@ -275,21 +493,97 @@ static QString _printableChar(uchar ch)
     return QString(QLatin1Char(ch));
 }
 
-int _fetchLine(const QByteArray& data, int address, uchar (&out)[BYTES_PER_LINE])
+void QHexWidget::updateMetrics()
 {
-    Q_ASSERT(address >= 0);
+    QFontMetrics fm(font());
+    fAddrWidth[0] = fm.boundingRect("0000").width();
+    fAddrWidth[1] = fm.boundingRect("0000 0000").width();
+    fAddrWidth[2] = fm.boundingRect("0000 0000 0000").width();
+    fByteWidth = fm.boundingRect("00_").width();
+    fCharWidth = fm.boundingRect(QChar('_')).width();
+    fLineHeight = fm.height();
+    fAscent = fm.ascent();
+    for (QPixmap& atlas : fGlyphAtlas)
+        atlas = QPixmap();
+}
+
+void QHexWidget::getRenderMetrics(qint64 maxAddress, int& byteOffset,
+                                  int& charOffset, int& rightMargin) const
+{
+    if (maxAddress > Q_INT64_C(0xFFFFFFFF))
+        byteOffset = fAddrWidth[2] + (HEX_PADDING * 2);
+    else if (maxAddress >= 0x10000)
+        byteOffset = fAddrWidth[1] + (HEX_PADDING * 2);
+    else
+        byteOffset = fAddrWidth[0] + (HEX_PADDING * 2);
+
+    charOffset = byteOffset + HEX_PADDING + (fByteWidth * BYTES_PER_LINE)
+                            + (fCharWidth * ((BYTES_PER_LINE / 4) + 1));
+    rightMargin = charOffset + (fCharWidth * (BYTES_PER_LINE + 1));
+}
 
-    int end = address + BYTES_PER_LINE;
-    if (end > data.size())
-        end = data.size();
+/* The glyph atlas holds all 256 hex pairs and all 256 printable
+ * characters, pre-rendered in one pen color, as two 16x16 grids:
+ *   [ hex pairs (fByteWidth wide) | chars (fCharWidth wide) ]
+ * Painting a byte is then two pixmap blits instead of formatting and
+ * shaping two strings. */
+const QPixmap& QHexWidget::glyphAtlas(GlyphPen pen, qreal dpr)
+{
+    // Rebuilt whenever the ratio changes, e.g. when the window is moved
+    // to a screen with a different scale factor
+    QPixmap& atlas = fGlyphAtlas[pen];
+    if (!atlas.isNull() && qFuzzyCompare(atlas.devicePixelRatio(), dpr))
+        return atlas;
+
+    atlas = QPixmap(QSize(16 * (fByteWidth + fCharWidth), 16 * fLineHeight) * dpr);
+    atlas.setDevicePixelRatio(dpr);
+    atlas.fill(Qt::transparent);
+
+    QPainter painter(&atlas);
+    painter.setFont(font());
+    switch (pen) {
+    case kPenText:
+        painter.setPen(palette().color(QPalette::Text));
+        break;
+    case kPenNonPrintable:
+        painter.setPen(QColor(115, 10, 125));
+        break;
+    case kPenHighlighted:
+        painter.setPen(palette().color(QPalette::HighlightedText));
+        break;
+    default:
+        break;
+    }
+    for (int ch = 0; ch < 256; ++ch) {
+        int y = (ch / 16) * fLineHeight + fAscent;
+        painter.drawText((ch % 16) * fByteWidth, y,
+                         QString("%1").arg(ch, 2, 16, QChar('0')));
+        painter.drawText(16 * fByteWidth + (ch % 16) * fCharWidth, y,
+                         _printableChar(ch));
+    }
+    painter.end();
+    return atlas;
+}
 
-    const char* cdata = data.constData() + address;
-    const char* cend = data.constData() + end;
-    char *cout = reinterpret_cast<char *>(&out[0]);
-    while (cdata < cend)
-        *cout++ = *cdata++;
+static QString _formatAddress(qint64 address, qint64 maxAddress)
+{
+    if (maxAddress > Q_INT64_C(0xFFFFFFFF)) {
+        return QString("%1 %2 %3").arg((address >> 32) & 0xFFFF, 4, 16, QChar('0'))
+                                  .arg((address >> 16) & 0xFFFF, 4, 16, QChar('0'))
+                                  .arg((address      ) & 0xFFFF, 4, 16, QChar('0'));
+    } else if (maxAddress > 0x10000) {
+        return QString("%1 %2").arg((address >> 16) & 0xFFFF, 4, 16, QChar('0'))
+                               .arg((address      ) & 0xFFFF, 4, 16, QChar('0'));
+    } else {
+        return QString("%1").arg(address & 0xFFFF, 4, 16, QChar('0'));
+    }
+}
 
-    return end - address;
+static int _fetchLine(const QHexDataSource* data, qint64 address,
+                      uchar (&out)[BYTES_PER_LINE])
+{
+    Q_ASSERT(address >= 0);
+    return (int)data->read(address, out, BYTES_PER_LINE);
 }
 
 void QHexWidget::render(QPainter* painter)
@@ -298,11 +592,12 @@ void QHexWidget::render(QPainter* painter)
     QFontMetrics fm(font());
     painter->setFont(font());
 
-    int maxAddress = fData.size();
+    qint64 maxAddress = fData->size();
     int byteOffset, charOffset, rightMargin;
-    getRenderMetrics(fm, maxAddress, byteOffset, charOffset, rightMargin);
-    const int bwidth = fm.boundingRect("00_").width();
-    const int swidth = fm.boundingRect(QChar('_')).width();
+    getRenderMetrics(maxAddress, byteOffset, charOffset, rightMargin);
+    const int bwidth = fByteWidth;
+    const int swidth = fCharWidth;
+    const qreal targetDpr = painter->device()->devicePixelRatioF();
 
     painter->fillRect(0, 0, byteOffset, viewport()->height(),
                       pal.color(QPalette::Window));
@@ -323,7 +618,7 @@ void QHexWidget::render(QPainter* painter)
     painter->setPen(pal.color(QPalette::Text));
     {
         int hy = HEX_PADDING + fm.ascent();
-        int baseAddr = fViewportAddress;
+        qint64 baseAddr = fViewportAddress;
         for (int i = 0; i < lines; ++i) {
             painter->drawText(HEX_PADDING, hy, _formatAddress(baseAddr, maxAddress));
             baseAddr += BYTES_PER_LINE;
@@ -334,18 +629,23 @@ void QHexWidget::render(QPainter* painter)
     }
 
     // Selection
-    int loSelect = fSelectionStart;
-    int hiSelect = loSelect >= 0 ? fCurrentAddress : -1;
+    qint64 loSelect = fSelectionStart;
+    qint64 hiSelect = loSelect >= 0 ? fCurrentAddress : -1;
     if (loSelect > hiSelect)
         qSwap(loSelect, hiSelect);
 
     // Hex values and chars
     int ly = HEX_PADDING + fm.ascent();
     int bytes, bx, cx;
-    int baseAddr = fViewportAddress;
+    qint64 baseAddr = fViewportAddress;
     uchar buffer[BYTES_PER_LINE];
+    auto highlight = std::lower_bound(fHighlights.constBegin(), fHighlights.constEnd(),
+                                      fViewportAddress - fHighlightLength + 1);
+    auto annotation = std::lower_bound(fAnnotations.constBegin(), fAnnotations.constEnd(),
+                                       fViewportAddress, _annotationBefore);
+    const QColor annotationColors[] = { QColor(220, 235, 255), QColor(225, 250, 215) };
     for (int i = 0; i < lines; ++i) {
-        bytes = _fetchLine(fData, baseAddr, buffer);
+        bytes = _fetchLine(fData.data(), baseAddr, buffer);
         if (!bytes)
             break;
 
@@ -366,19 +666,52 @@ void QHexWidget::render(QPainter* painter)
                                   pal.color(QPalette::Highlight));
                 painter->fillRect(cx, ly - fm.ascent(), swidth, fm.height(),
                                   pal.color(QPalette::Highlight));
-            }
-
-            uchar bvalue = buffer[b];
-            if (inSelect) {
-                painter->setPen(pal.color(QPalette::HighlightedText));
-            } else if (_isNonPrintable(bvalue)) {
-                painter->setPen(QColor(115, 10, 125));
             } else {
-                painter->setPen(pal.color(QPalette::Text));
+                while (highlight != fHighlights.constEnd()
+                        && *highlight + fHighlightLength <= baseAddr + b)
+                    ++highlight;
+                while (annotation != fAnnotations.constEnd()
+                        && annotation->fStart + annotation->fLength <= baseAddr + b)
+                    ++annotation;
+                if (highlight != fHighlights.constEnd() && *highlight <= baseAddr + b) {
+                    painter->fillRect(bx, ly - fm.ascent(), swidth * 2, fm.height(),
+                                      QColor(255, 225, 120));
+                    painter->fillRect(cx, ly - fm.ascent(), swidth, fm.height(),
+                                      QColor(255, 225, 120));
+                } else if (annotation != fAnnotations.constEnd()
+                           && annotation->fStart <= baseAddr + b) {
+                    // Alternate tints so neighbouring fields stay distinct,
+                    // and bridge the gap to the next byte of the same field
+                    const QColor& tint = annotation->fColor.isValid() ? annotation->fColor
+                                       : annotationColors[(annotation - fAnnotations.constBegin()) % 2];
+                    int hlBytes = 2;
+                    if (b < 15 && baseAddr + b + 1 < annotation->fStart + annotation->fLength) {
+                        hlBytes += 1;
+                        if ((b % 4) == 3)
+                            hlBytes += 1;
+                    }
+                    painter->fillRect(bx, ly - fm.ascent(), swidth * hlBytes, fm.height(), tint);
+                    painter->fillRect(cx, ly - fm.ascent(), swidth, fm.height(), tint);
+                }
             }
 
-            painter->drawText(bx, ly, QString("%1").arg(bvalue, 2, 16, QChar('0')));
-            painter->drawText(cx, ly, _printableChar(bvalue));
+            uchar bvalue = buffer[b];
+            GlyphPen pen = kPenText;
+            if (inSelect)
+                pen = kPenHighlighted;
+            else if (_isNonPrintable(bvalue))
+                pen = kPenNonPrintable;
+
+            // Source rects are in the atlas' own pixels
+            const QPixmap& atlas = glyphAtlas(pen, targetDpr);
+            const qreal dpr = atlas.devicePixelRatio();
+            const int gx = bvalue % 16, gy = (bvalue / 16) * fLineHeight;
+            painter->drawPixmap(QRectF(bx, ly - fAscent, bwidth, fLineHeight), atlas,
+                                QRectF(gx * bwidth * dpr, gy * dpr,
+                                       bwidth * dpr, fLineHeight * dpr));
+            painter->drawPixmap(QRectF(cx, ly - fAscent, swidth, fLineHeight), atlas,
+                                QRectF((16 * bwidth + gx * swidth) * dpr, gy * dpr,
+                                       swidth * dpr, fLineHeight * dpr));
 
             bx += bwidth;
             cx += swidth;
@@ -392,37 +725,47 @@ void QHexWidget::render(QPainter* painter)
 
     // Paint selection box last so it doesn't get overpainted by selection
     // highlight
-    int endAddr = baseAddr;
+    qint64 endAddr = baseAddr;
     if (fCurrentAddress >= fViewportAddress && fCurrentAddress < endAddr) {
         ly = HEX_PADDING + fm.ascent();
-        int relAddress = fCurrentAddress - fViewportAddress;
+        int relAddress = (int)(fCurrentAddress - fViewportAddress);
         ly += (relAddress / BYTES_PER_LINE) * fm.height();
         int bOffset = (relAddress % BYTES_PER_LINE);
         bx = byteOffset + HEX_PADDING + swidth;
         bx += bwidth * bOffset + ((bOffset / 4) * swidth);
         cx = charOffset + (swidth * bOffset);
         painter->setPen(QPalette::Shadow);
-        painter->drawRect(bx - 1, ly - fm.ascent() - 1,
-                          swidth * 2 + 1, fm.height() + 1);
+        if (!fReadOnly && !fOverwrite) {
+            // Insertion caret, in the column being typed into
+            const int caretX = fEditChars ? cx : bx + (fLowNibble ? swidth : 0);
+            painter->fillRect(caretX - 1, ly - fm.ascent(), 2, fm.height(),
+                              pal.color(QPalette::Text));
+        } else if (!fReadOnly && fLowNibble) {
+            painter->drawRect(bx + swidth - 1, ly - fm.ascent() - 1,
+                              swidth + 1, fm.height() + 1);
+        } else {
+            painter->drawRect(bx - 1, ly - fm.ascent() - 1,
+                              swidth * 2 + 1, fm.height() + 1);
+        }
         painter->drawRect(cx - 1, ly - fm.ascent() - 1,
                           swidth + 1, fm.height() + 1);
     }
 
 }
 
-int QHexWidget::addressAt(int x, int y) const
+qint64 QHexWidget::addressAt(int x, int y) const
 {
     QFontMetrics fm(font());
-    const int bwidth = fm.boundingRect("00_").width();
-    const int cwidth = fm.boundingRect(QChar('0')).width();
+    const int bwidth = fByteWidth;
+    const int cwidth = fCharWidth;
 
     int byteOffset, charOffset, rightMargin;
-    getRenderMetrics(fm, fData.size(), byteOffset, charOffset, rightMargin);
+    getRenderMetrics(fData->size(), byteOffset, charOffset, rightMargin);
     const int firstByteOffsetChar = byteOffset + HEX_PADDING;
 
-    int lineAddr = (y - fm.descent() + 1) / fm.height();
+    qint64 lineAddr = (y - fm.descent() + 1) / fm.height();
     lineAddr = lineAddr * BYTES_PER_LINE + fViewportAddress;
-    int addr = -1;
+    qint64 addr = -1;
 
     if (x < byteOffset) {
         // Address header clicked -- just get the address of the first byte
@@ -448,5 +791,5 @@ int QHexWidget::addressAt(int x, int y) const
         addr = lineAddr + (x - charOffset) / cwidth;
     }
 
-    return (addr < fData.size()) ? addr : -1;
+    return (addr < fData->size()) ? addr : -1;
 }
@@ -18,53 +18,116 @@
 #define _QHEXWIDGET_H
 
 #include <QAbstractScrollArea>
+#include <QColor>
+#include <QPixmap>
+#include <QSharedPointer>
+#include <QVector>
+#include "QHexEditBuffer.h"
 
 class QHexWidget : public QAbstractScrollArea
 {
     Q_OBJECT
 
 public:
+    struct Annotation
+    {
+        qint64 fStart;
+        qint64 fLength;
+        QString fLabel;
+        QColor fColor;      // Invalid to alternate the default tints
+    };
+
     explicit QHexWidget(QWidget* parent = 0);
 
     QSize sizeHint() const Q_DECL_OVERRIDE;
-    int currentAddress() const { return fCurrentAddress; }
-    int firstVisibleAddress() const { return fViewportAddress; }
-    int lastVisibleAddress() const;
-    QPair<int, int> selection() const;
+    qint64 currentAddress() const { return fCurrentAddress; }
+    qint64 firstVisibleAddress() const { return fViewportAddress; }
+    qint64 lastVisibleAddress() const;
+    QPair<qint64, qint64> selection() const;
 
     void loadFromData(const QByteArray& data);
-    bool loadFromFile(const QString& fileName);  // WARNING: Loads entire file into RAM
+    bool loadFromFile(const QString& fileName, qint64 offset = 0, qint64 size = -1);
+    void setDataSource(const QSharedPointer<QHexDataSource>& source);
+    QSharedPointer<QHexDataSource> dataSource() const { return fData; }
+
+    qint64 dataSize() const { return fData->size(); }
+    uchar byteAt(qint64 address) const;
+
+    // Editing wraps the data source in an edit buffer, which is kept
+    // (with its undo history) until another source is loaded
+    bool isReadOnly() const { return fReadOnly; }
+    void setReadOnly(bool readOnly);
+    QSharedPointer<QHexEditBuffer> editBuffer() const { return fEdit; }
+    bool isOverwriteMode() const { return fOverwrite; }
 
-    int dataSize() const { return fData.size(); }
-    uchar byteAt(int address) const { return (uchar)fData.at(address); }
+    // Mark ranges of length bytes starting at each (sorted) address
+    void setHighlights(const QVector<qint64>& addresses, int length);
+    void clearHighlights() { setHighlights(QVector<qint64>(), 0); }
+
+    // Tint and label (non-overlapping, sorted) field ranges
+    void setAnnotations(const QVector<Annotation>& annotations);
+    const Annotation* annotationAt(qint64 address) const;
 
 signals:
-    void currentAddressChanged(int address);
+    void currentAddressChanged(qint64 address);
+
+    // length bytes at address now hold new contents.  If the size of the
+    // data changed, everything after them has moved as well.
+    void dataEdited(qint64 address, qint64 length);
+    void dataSourceChanged();
+    void overwriteModeChanged(bool overwrite);
 
 public slots:
-    void setCurrentAddress(int address);
+    void setCurrentAddress(qint64 address);
+    void setSelection(qint64 start, qint64 end);
+    void undo();
+    void redo();
 
 protected:
+    void changeEvent(QEvent*) Q_DECL_OVERRIDE;
     void paintEvent(QPaintEvent*) Q_DECL_OVERRIDE;
     void resizeEvent(QResizeEvent*) Q_DECL_OVERRIDE;
     void mousePressEvent(QMouseEvent*) Q_DECL_OVERRIDE;
     void mouseMoveEvent(QMouseEvent*) Q_DECL_OVERRIDE;
     void mouseReleaseEvent(QMouseEvent*) Q_DECL_OVERRIDE;
     void keyPressEvent(QKeyEvent*) Q_DECL_OVERRIDE;
+    bool viewportEvent(QEvent*) Q_DECL_OVERRIDE;
     void scrollContentsBy(int dx, int dy) Q_DECL_OVERRIDE;
 
 private:
-    QByteArray fData;
-    int fCurrentAddress;
-    int fViewportAddress;
-    int fSelectionStart;
+    QSharedPointer<QHexDataSource> fData;
+    qint64 fCurrentAddress;
+    qint64 fViewportAddress;
+    qint64 fSelectionStart;
+    QVector<qint64> fHighlights;
+    int fHighlightLength;
+    QVector<Annotation> fAnnotations;
+
+    QSharedPointer<QHexEditBuffer> fEdit;
+    bool fReadOnly, fOverwrite;
+    bool fEditChars;        // Typing goes to the char column, not the hex one
+    bool fLowNibble;        // The high nibble of the current byte was just typed
+
+    // Font measurements, refreshed only when the font changes
+    int fAddrWidth[3];
+    int fByteWidth, fCharWidth, fLineHeight, fAscent;
+
+    enum GlyphPen { kPenText, kPenNonPrintable, kPenHighlighted, kNumPens };
+    QPixmap fGlyphAtlas[kNumPens];
 
     int visibleLines(const QFontMetrics& fm, int viewportHeight) const;
-    void getRenderMetrics(const QFontMetrics& fm, int maxAddress,
-                          int& byteOffset, int& charOffset, int& rightMargin) const;
+    void updateMetrics();
+    void getRenderMetrics(qint64 maxAddress, int& byteOffset, int& charOffset,
+                          int& rightMargin) const;
+    const QPixmap& glyphAtlas(GlyphPen pen, qreal dpr);
     void render(QPainter *painter);
 
-    int addressAt(int x, int y) const;
+    qint64 addressAt(int x, int y) const;
+
+    bool editKey(QKeyEvent* event);
+    void writeByte(uchar value, bool insert, bool merge);
+    void removeBytes(qint64 address, qint64 count);
+    void dataResized();
 };
 
 #endif
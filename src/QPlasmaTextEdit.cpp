@@ -19,6 +19,8 @@
 #include <KSyntaxHighlighting/Theme>
 #include <KSyntaxHighlighting/Definition>
 #include <KSyntaxHighlighting/Repository>
+#include <QTextBlock>
+#include <QPainter>
 
 KSyntaxHighlighting::Repository* QPlasmaTextEdit::SyntaxRepo()
 {
@@ -34,10 +36,13 @@ KSyntaxHighlighting::Repository* QPlasmaTextEdit::SyntaxRepo()
 }
 
 QPlasmaTextEdit::QPlasmaTextEdit(QWidget* parent)
-    : SyntaxTextEdit(parent)
+    : SyntaxTextEdit(parent), fErrorPos(), fErrorLength()
 {
     setTabWidth(8);
     setHighlightCurrentLine(true);
+
+    connect(document(), &QTextDocument::contentsChange,
+            this, &QPlasmaTextEdit::updateErrorMarker);
 }
 
 void QPlasmaTextEdit::setSyntax(const QString& name)
@@ -48,6 +53,73 @@ void QPlasmaTextEdit::setSyntax(const QString& name)
     SyntaxTextEdit::setSyntax(syntaxDef);
 }
 
+void QPlasmaTextEdit::setErrorMarker(int position, int length)
+{
+    fErrorPos = position;
+    fErrorLength = length;
+    fErrorText = markedText();
+    viewport()->update();
+}
+
+void QPlasmaTextEdit::clearErrorMarker()
+{
+    if (fErrorLength > 0) {
+        fErrorLength = 0;
+        viewport()->update();
+    }
+}
+
+QString QPlasmaTextEdit::markedText() const
+{
+    const int last = document()->characterCount() - 1;
+    QTextCursor cursor(document());
+    cursor.setPosition(qMin(fErrorPos, last));
+    cursor.setPosition(qMin(fErrorPos + fErrorLength, last), QTextCursor::KeepAnchor);
+    return cursor.selectedText();
+}
+
+void QPlasmaTextEdit::updateErrorMarker(int position, int removed, int added)
+{
+    if (fErrorLength <= 0 || position >= fErrorPos + fErrorLength)
+        return;
+
+    if (position + removed <= fErrorPos) {
+        // Keep the marker on the same text when something before it changes
+        fErrorPos += added - removed;
+        viewport()->update();
+    } else if (removed != added || markedText() != fErrorText) {
+        // Formatting changes report the same length removed and added, and
+        // leave the text alone; anything else touching the marked text
+        // makes the error stale
+        clearErrorMarker();
+    }
+}
+
+void QPlasmaTextEdit::paintEvent(QPaintEvent* e)
+{
+    SyntaxTextEdit::paintEvent(e);
+    if (fErrorLength <= 0)
+        return;
+
+    QTextCursor cursor(document());
+    cursor.setPosition(qMin(fErrorPos, document()->characterCount() - 1));
+    QTextBlock block = cursor.block();
+    if (!block.isVisible())
+        return;
+    QRect startRect = cursorRect(cursor);
+    cursor.setPosition(qMin(fErrorPos + fErrorLength, block.position() + block.length() - 1));
+    QRect endRect = cursorRect(cursor);
+
+    // A wavy underline, in the style of a spelling error
+    QPolygon wave;
+    const int right = qMax(endRect.left(), startRect.left() + 4);
+    for (int x = startRect.left(), up = 0; x <= right; x += 2, up ^= 1)
+        wave << QPoint(x, startRect.bottom() - (up ? 2 : 0));
+    QPainter painter(viewport());
+    painter.setPen(Qt::red);
+    painter.drawPolyline(wave);
+}
+
 void QPlasmaTextEdit::keyPressEvent(QKeyEvent* e)
 {
     switch (e->key()) {
@@ -31,8 +31,24 @@ public:
     // Override to provide a syntax by name
     void setSyntax(const QString& name);
 
+    // Underline the first line of a range of text, e.g. the location of a
+    // compile error.  Moves along with edits before it, and is cleared
+    // when the marked text itself is edited.
+    void setErrorMarker(int position, int length);
+    void clearErrorMarker();
+
 protected:
     void keyPressEvent(QKeyEvent* e) Q_DECL_OVERRIDE;
+    void paintEvent(QPaintEvent* e) Q_DECL_OVERRIDE;
+
+private slots:
+    void updateErrorMarker(int position, int removed, int added);
+
+private:
+    int fErrorPos, fErrorLength;
+    QString fErrorText;
+
+    QString markedText() const;
 };
 
 #endif